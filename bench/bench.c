@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <err.h>
+
+#include "bench.h"
+
+#include "../src/i8080/board/cpm_stub.h"
+
+static void
+bench_input(struct i8080_cpu *cpu, uint8_t device) {
+}
+
+static void
+bench_output(struct i8080_cpu *cpu, uint8_t device) {
+}
+
+const struct i8080_io bench_io = {
+	.input = bench_input, .output = bench_output,
+};
+
+double
+bench_now(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+const char *
+bench_basename(const char *path) {
+	return strrchr(path, '/') != NULL ? strrchr(path, '/') + 1 : path;
+}
+
+void
+bench_load(struct i8080_cpu *cpu, const char *filename) {
+	FILE * const filep = fopen(filename, "rb");
+
+	if(filep == NULL) {
+		err(EXIT_FAILURE, "fopen %s", filename);
+	}
+
+	memcpy(cpu->memory, cpm_stub, sizeof(cpm_stub));
+	fread(cpu->memory + 0x100, 1, sizeof(cpu->memory) - 0x100, filep);
+	fclose(filep);
+
+	cpu->pc = 0x100;
+}
+
+bool
+bench_same(const struct i8080_cpu *lhs, const struct i8080_cpu *rhs) {
+	return lhs->registers.pair.b == rhs->registers.pair.b
+		&& lhs->registers.pair.d == rhs->registers.pair.d
+		&& lhs->registers.pair.h == rhs->registers.pair.h
+		&& lhs->registers.pair.psw == rhs->registers.pair.psw
+		&& lhs->pc == rhs->pc && lhs->sp == rhs->sp
+		&& lhs->uptime_cycles == rhs->uptime_cycles
+		&& memcmp(lhs->memory, rhs->memory, sizeof(lhs->memory)) == 0;
+}
@@ -0,0 +1,29 @@
+#ifndef I8080_BENCH_H
+#define I8080_BENCH_H
+
+#include <stdbool.h>
+
+#include "i8080/cpu.h"
+
+/* Helpers shared by the benches */
+
+/* Io of the COM files run by the benches, console output is discarded */
+extern const struct i8080_io bench_io;
+
+/* Monotonic host time in seconds */
+double
+bench_now(void);
+
+const char *
+bench_basename(const char *path);
+
+/* Loads a CP/M COM file at 0x100 of an initialized cpu, behind the page zero of the CP/M board */
+void
+bench_load(struct i8080_cpu *cpu, const char *filename);
+
+/* Registers, cycles and memory are the same, as after running the same program on different engines */
+bool
+bench_same(const struct i8080_cpu *lhs, const struct i8080_cpu *rhs);
+
+/* I8080_BENCH_H */
+#endif
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "space_invaders_screen.h"
+
+/* Expands random video memory to display pixels, one full frame at a time as two halves like the board does,
+ * with the pixel by pixel reference and with the vectorized path, and reports the nanoseconds per frame.
+ * Both must produce the same pixels */
+
+#define BLIT_BENCH_FRAMES 20000
+
+#define BLIT_BENCH_VRAM_SIZE (SPACE_INVADERS_SCREEN_WIDTH / 8 * SPACE_INVADERS_SCREEN_HEIGHT)
+#define BLIT_BENCH_PITCH     (SPACE_INVADERS_DISPLAY_WIDTH + 32) /* Textures usually have padded rows */
+
+static const struct blit_bench_path {
+	const char *name;
+	void (*expand)(const uint8_t *, unsigned, unsigned, uint8_t *, size_t);
+} paths[] = {
+	{ "scalar", space_invaders_screen_expand_scalar },
+	{ "simd", space_invaders_screen_expand },
+};
+
+static uint8_t vram[BLIT_BENCH_VRAM_SIZE];
+static uint8_t pixels[sizeof(paths) / sizeof(*paths)][BLIT_BENCH_PITCH * SPACE_INVADERS_DISPLAY_HEIGHT];
+
+int
+main(int argc, char **argv) {
+	const unsigned half = SPACE_INVADERS_SCREEN_HEIGHT / 2;
+	double reference = 0.0;
+
+	srand(0x8080);
+	for(unsigned i = 0; i < sizeof(vram); i++) {
+		vram[i] = rand();
+	}
+
+	printf("%-10s %12s %8s\n", "path", "ns/frame", "speedup");
+
+	for(unsigned path = 0; path < sizeof(paths) / sizeof(*paths); path++) {
+		const double start = bench_now();
+		double elapsed;
+
+		for(unsigned frame = 0; frame < BLIT_BENCH_FRAMES; frame++) {
+			paths[path].expand(vram, 0, half, pixels[path], BLIT_BENCH_PITCH);
+			paths[path].expand(vram, half, half, pixels[path] + half, BLIT_BENCH_PITCH);
+		}
+		elapsed = (bench_now() - start) / BLIT_BENCH_FRAMES;
+
+		if(path == 0) {
+			reference = elapsed;
+		}
+
+		printf("%-10s %12.1f %7.2fx\n", paths[path].name, elapsed * 1e9, reference / elapsed);
+	}
+
+	for(unsigned path = 1; path < sizeof(paths) / sizeof(*paths); path++) {
+		for(unsigned y = 0; y < SPACE_INVADERS_DISPLAY_HEIGHT; y++) {
+			if(memcmp(pixels[0] + y * BLIT_BENCH_PITCH, pixels[path] + y * BLIT_BENCH_PITCH, SPACE_INVADERS_DISPLAY_WIDTH) != 0) {
+				fprintf(stderr, "%s: Pixels of path %s differ from the scalar reference on row %u\n", *argv, paths[path].name, y);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
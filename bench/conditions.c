@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+#include "conditions.h"
+
+/* Microbenchmark of conditions computation, each operation is evaluated over all its operands,
+ * once through the reference macros and once through the lookup tables used by the engines */
+
+#define CONDITIONS_BENCH_ROUNDS 200
+
+typedef double (*conditions_bench_fn)(unsigned *checksum);
+
+struct conditions_bench {
+	const char *name;
+	conditions_bench_fn reference, table;
+};
+
+/* Expands a timed loop around a computation, so the compiler sees it inlined as in the engines */
+#define CONDITIONS_BENCH(name) \
+static double \
+name##_run(unsigned *checksum) { \
+	const double start = bench_now(); \
+	unsigned sum = 0; \
+\
+	for(unsigned round = 0; round < CONDITIONS_BENCH_ROUNDS; round++) { \
+		for(unsigned operands = 0; operands < 0x20000; operands++) { \
+			sum += name(operands >> 9, operands >> 1, operands & 1); \
+		} \
+	} \
+\
+	*checksum = sum; \
+\
+	return (bench_now() - start) * 1e9 / (CONDITIONS_BENCH_ROUNDS * 0x20000); \
+}
+
+static uint8_t
+conditions_bench_reference_add(uint8_t lhs, uint8_t rhs, unsigned carry) {
+	const uint8_t propagated = rhs + carry;
+	const uint8_t res = lhs + propagated;
+
+	return I8080_CONDITION_SIGN(res)
+		| I8080_CONDITION_ZERO(res)
+		| I8080_CONDITION_AUXILIARY_CARRY(lhs, propagated, res)
+			^ I8080_CONDITION_AUXILIARY_CARRY(rhs, carry, propagated)
+		| I8080_CONDITION_PARITY(res)
+		| I8080_CONDITION_CARRY(lhs, propagated, res)
+			^ I8080_CONDITION_CARRY(rhs, (uint8_t)carry, propagated);
+}
+
+static uint8_t
+conditions_bench_table_add(uint8_t lhs, uint8_t rhs, unsigned carry) {
+	return i8080_conditions_add(lhs, rhs, carry);
+}
+
+static uint8_t
+conditions_bench_reference_sub(uint8_t lhs, uint8_t rhs, unsigned carry) {
+	const uint8_t propagated = rhs + carry;
+	const uint8_t res = lhs - propagated;
+
+	return I8080_CONDITION_SIGN(res)
+		| I8080_CONDITION_ZERO(res)
+		| I8080_CONDITION_AUXILIARY_BORROW(lhs, propagated, res)
+			^ I8080_CONDITION_AUXILIARY_CARRY(rhs, carry, propagated)
+		| I8080_CONDITION_PARITY(res)
+		| I8080_CONDITION_BORROW(lhs, propagated, res)
+			^ I8080_CONDITION_CARRY(rhs, (uint8_t)carry, propagated);
+}
+
+static uint8_t
+conditions_bench_table_sub(uint8_t lhs, uint8_t rhs, unsigned carry) {
+	return i8080_conditions_sub(lhs, rhs, carry);
+}
+
+static uint8_t
+conditions_bench_reference_ana(uint8_t lhs, uint8_t rhs, unsigned carry) {
+	const uint8_t res = lhs & rhs;
+
+	return I8080_CONDITION_SIGN(res)
+		| I8080_CONDITION_ZERO(res)
+		| I8080_CONDITION_AUXILIARY_CARRY(lhs, rhs, res)
+		| I8080_CONDITION_PARITY(res);
+}
+
+static uint8_t
+conditions_bench_table_ana(uint8_t lhs, uint8_t rhs, unsigned carry) {
+	return i8080_conditions_ana(lhs, rhs);
+}
+
+static uint8_t
+conditions_bench_reference_ora(uint8_t lhs, uint8_t rhs, unsigned carry) {
+	const uint8_t res = lhs | rhs;
+
+	return I8080_CONDITION_SIGN(res)
+		| I8080_CONDITION_ZERO(res)
+		| I8080_CONDITION_PARITY(res);
+}
+
+static uint8_t
+conditions_bench_table_ora(uint8_t lhs, uint8_t rhs, unsigned carry) {
+	return i8080_conditions_szp(lhs | rhs);
+}
+
+static uint8_t
+conditions_bench_reference_inr(uint8_t lhs, uint8_t rhs, unsigned carry) {
+	const uint8_t res = lhs + 1;
+
+	return I8080_CONDITION_SIGN(res)
+		| I8080_CONDITION_ZERO(res)
+		| I8080_CONDITION_AUXILIARY_CARRY(lhs, 1, res)
+		| I8080_CONDITION_PARITY(res);
+}
+
+static uint8_t
+conditions_bench_table_inr(uint8_t lhs, uint8_t rhs, unsigned carry) {
+	return i8080_conditions_inr(lhs);
+}
+
+static uint8_t
+conditions_bench_reference_dcr(uint8_t lhs, uint8_t rhs, unsigned carry) {
+	const uint8_t res = lhs - 1;
+
+	return I8080_CONDITION_SIGN(res)
+		| I8080_CONDITION_ZERO(res)
+		| I8080_CONDITION_AUXILIARY_BORROW(lhs, 1, res)
+		| I8080_CONDITION_PARITY(res);
+}
+
+static uint8_t
+conditions_bench_table_dcr(uint8_t lhs, uint8_t rhs, unsigned carry) {
+	return i8080_conditions_dcr(lhs);
+}
+
+CONDITIONS_BENCH(conditions_bench_reference_add)
+CONDITIONS_BENCH(conditions_bench_table_add)
+CONDITIONS_BENCH(conditions_bench_reference_sub)
+CONDITIONS_BENCH(conditions_bench_table_sub)
+CONDITIONS_BENCH(conditions_bench_reference_ana)
+CONDITIONS_BENCH(conditions_bench_table_ana)
+CONDITIONS_BENCH(conditions_bench_reference_ora)
+CONDITIONS_BENCH(conditions_bench_table_ora)
+CONDITIONS_BENCH(conditions_bench_reference_inr)
+CONDITIONS_BENCH(conditions_bench_table_inr)
+CONDITIONS_BENCH(conditions_bench_reference_dcr)
+CONDITIONS_BENCH(conditions_bench_table_dcr)
+
+static const struct conditions_bench benches[] = {
+	{ "ADD/ADC", conditions_bench_reference_add_run, conditions_bench_table_add_run },
+	{ "SUB/SBB/CMP", conditions_bench_reference_sub_run, conditions_bench_table_sub_run },
+	{ "ANA", conditions_bench_reference_ana_run, conditions_bench_table_ana_run },
+	{ "ORA/XRA", conditions_bench_reference_ora_run, conditions_bench_table_ora_run },
+	{ "INR", conditions_bench_reference_inr_run, conditions_bench_table_inr_run },
+	{ "DCR", conditions_bench_reference_dcr_run, conditions_bench_table_dcr_run },
+};
+
+int
+main(void) {
+	const struct conditions_bench *current = benches, *end = benches + sizeof(benches) / sizeof(*benches);
+	int status = EXIT_SUCCESS;
+
+	printf("%-12s %12s %12s\n", "operation", "reference", "table");
+
+	while(current != end) {
+		unsigned reference_checksum, table_checksum;
+		const double reference = current->reference(&reference_checksum),
+			table = current->table(&table_checksum);
+
+		printf("%-12s %9.2f ns %9.2f ns\n", current->name, reference, table);
+
+		if(reference_checksum != table_checksum) {
+			fprintf(stderr, "%s: Table conditions differ from reference\n", current->name);
+			status = EXIT_FAILURE;
+		}
+
+		current++;
+	}
+
+	return status;
+}
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+/* Runs CP/M COM files to completion on each available engine, reporting the emulated
+ * frequency and the speedup against the table engine. Console output is discarded,
+ * and the final state of every engine must be identical to the one of the table engine */
+
+int
+main(int argc, char **argv) {
+	static struct i8080_cpu reference, cpu;
+	int status = EXIT_SUCCESS;
+
+	if(argc < 2) {
+		fprintf(stderr, "usage: %s program...\n", *argv);
+		return EXIT_FAILURE;
+	}
+
+	printf("%-16s %-10s %10s %12s %8s\n", "program", "engine", "seconds", "MHz", "speedup");
+
+	for(char **program = argv + 1; program != argv + argc; program++) {
+		const char * const basename = bench_basename(*program);
+		double table = 0.0;
+
+		for(enum i8080_engine engine = I8080_ENGINE_TABLE; i8080_engine_name(engine) != NULL; engine++) {
+			double start, elapsed;
+
+			i8080_cpu_init(&cpu, &bench_io);
+			if(i8080_cpu_set_engine(&cpu, engine) != 0) {
+				printf("%-16s %-10s %10s\n", basename, i8080_engine_name(engine), "unavailable");
+				i8080_cpu_deinit(&cpu);
+				continue;
+			}
+			bench_load(&cpu, *program);
+
+			start = bench_now();
+			while(!cpu.stopped) {
+				i8080_cpu_run(&cpu, UINT64_MAX);
+			}
+			elapsed = bench_now() - start;
+
+			if(engine == I8080_ENGINE_TABLE) {
+				reference = cpu;
+				table = elapsed;
+			} else if(!bench_same(&reference, &cpu)) {
+				fprintf(stderr, "%s: Final state of the %s engine differs from the table engine\n", *program, i8080_engine_name(engine));
+				status = EXIT_FAILURE;
+			}
+
+			printf("%-16s %-10s %10.3f %12.2f %7.2fx\n", basename, i8080_engine_name(engine),
+				elapsed, cpu.uptime_cycles / elapsed / 1e6, table / elapsed);
+
+			i8080_cpu_deinit(&cpu);
+		}
+	}
+
+	return status;
+}
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+#include "bench.h"
+
+/* Host nanoseconds per emulated instruction, per class of instructions and per engine, stepping through i8080_cpu_next.
+ * Each class is a synthetic program: a prologue setting up registers, then a body repeating the same few instructions
+ * until jumping back to its start, so nearly every instruction stepped belongs to the class.
+ * The NOP class measures the cost of stepping itself, the other classes add the cost of their handlers */
+
+#define INSTRUCTIONS_BENCH_COUNT    10000000
+#define INSTRUCTIONS_BENCH_BODY     0x0100 /* Address of the body, the prologue runs before it */
+#define INSTRUCTIONS_BENCH_REPEATS  1024   /* Sequences of the class in the body */
+#define INSTRUCTIONS_BENCH_DATA     0xE000 /* Pointed to by HL, for memory operands */
+#define INSTRUCTIONS_BENCH_STACK    0xF000
+#define INSTRUCTIONS_BENCH_FUNCTION 0xF800 /* Called by the call class, only returns */
+
+struct instructions_bench_class {
+	const char *name;
+	uint8_t sequence[8];
+	size_t length; /* Of the sequence in bytes */
+	bool relative; /* The sequence ends with an absolute address to patch with the address following it */
+};
+
+/* Prologue: LXI SP, LXI H, MVI A 1, ORA A (clears zero), LXI B, LXI D */
+static const uint8_t instructions_bench_prologue[] = {
+	0x31, INSTRUCTIONS_BENCH_STACK & 0xFF, INSTRUCTIONS_BENCH_STACK >> 8,
+	0x21, INSTRUCTIONS_BENCH_DATA & 0xFF, INSTRUCTIONS_BENCH_DATA >> 8,
+	0x3E, 0x01,
+	0xB7,
+	0x01, 0x34, 0x12,
+	0x11, 0x78, 0x56,
+	0xC3, INSTRUCTIONS_BENCH_BODY & 0xFF, INSTRUCTIONS_BENCH_BODY >> 8,
+};
+
+static const struct instructions_bench_class classes[] = {
+	{ "NOP",          { 0x00 }, 1 },
+	{ "MOV r,r",      { 0x41, 0x4A, 0x53, 0x5C, 0x78, 0x47 }, 6 },
+	{ "ALU r",        { 0x80, 0x91, 0xA2, 0xAB, 0xB4, 0xBD, 0x88, 0x99 }, 8 },
+	{ "ALU M",        { 0x86, 0x96, 0xA6, 0xAE, 0xB6, 0xBE, 0x8E, 0x9E }, 8 },
+	{ "LXI/DAD",      { 0x21, 0x00, 0xE0, 0x09, 0x19 }, 5 },
+	{ "PUSH/POP",     { 0xC5, 0xD5, 0xE5, 0xE1, 0xD1, 0xC1 }, 6 },
+	{ "CALL/RET",     { 0xCD, INSTRUCTIONS_BENCH_FUNCTION & 0xFF, INSTRUCTIONS_BENCH_FUNCTION >> 8 }, 3 },
+	{ "Jcc taken",    { 0xC2 }, 3, true },  /* JNZ to the next instruction, zero is clear */
+	{ "Jcc not taken", { 0xCA }, 3, true }, /* JZ */
+	{ "IN/OUT",       { 0xDB, 0x00, 0xD3, 0x00 }, 4 },
+};
+
+static void
+instructions_bench_load(struct i8080_cpu *cpu, const struct instructions_bench_class *class) {
+	uint8_t *next = cpu->memory + INSTRUCTIONS_BENCH_BODY;
+
+	memcpy(cpu->memory, instructions_bench_prologue, sizeof(instructions_bench_prologue));
+
+	for(unsigned i = 0; i < INSTRUCTIONS_BENCH_REPEATS; i++) {
+		memcpy(next, class->sequence, class->length);
+		next += class->length;
+
+		if(class->relative) {
+			const uint16_t address = next - cpu->memory;
+
+			next[-2] = address & 0xFF;
+			next[-1] = address >> 8;
+		}
+	}
+
+	/* JMP back to the body */
+	next[0] = 0xC3;
+	next[1] = INSTRUCTIONS_BENCH_BODY & 0xFF;
+	next[2] = INSTRUCTIONS_BENCH_BODY >> 8;
+
+	cpu->memory[INSTRUCTIONS_BENCH_FUNCTION] = 0xC9; /* RET */
+}
+
+/* Nanoseconds per instruction, once the prologue ran */
+static double
+instructions_bench_measure(enum i8080_engine engine, const struct instructions_bench_class *class, uint64_t count) {
+	static struct i8080_cpu cpu;
+	double start, elapsed;
+
+	i8080_cpu_init(&cpu, &bench_io);
+	if(i8080_cpu_set_engine(&cpu, engine) != 0) {
+		return 0.0;
+	}
+
+	instructions_bench_load(&cpu, class);
+
+	while(cpu.pc != INSTRUCTIONS_BENCH_BODY) {
+		i8080_cpu_next(&cpu);
+	}
+
+	start = bench_now();
+	for(uint64_t i = 0; i < count; i++) {
+		i8080_cpu_next(&cpu);
+	}
+	elapsed = bench_now() - start;
+
+	if(cpu.stopped || cpu.pc < INSTRUCTIONS_BENCH_BODY) {
+		errx(EXIT_FAILURE, "%s: Left the body of the class at 0x%04X", class->name, cpu.pc);
+	}
+
+	i8080_cpu_deinit(&cpu);
+
+	return elapsed * 1e9 / count;
+}
+
+int
+main(int argc, char **argv) {
+	uint64_t count = INSTRUCTIONS_BENCH_COUNT;
+
+	if(argc > 2) {
+		fprintf(stderr, "usage: %s [instructions]\n", *argv);
+		return EXIT_FAILURE;
+	}
+
+	if(argc == 2) {
+		char *end;
+
+		count = strtoull(argv[1], &end, 0);
+		if(*argv[1] == '\0' || *end != '\0' || count == 0) {
+			fprintf(stderr, "%s: Invalid instruction count %s\n", *argv, argv[1]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("%-14s", "class");
+	for(enum i8080_engine engine = I8080_ENGINE_TABLE; i8080_engine_name(engine) != NULL; engine++) {
+		printf(" %12s", i8080_engine_name(engine));
+	}
+	putchar('\n');
+
+	for(const struct instructions_bench_class *class = classes; class != classes + sizeof(classes) / sizeof(*classes); class++) {
+		printf("%-14s", class->name);
+
+		for(enum i8080_engine engine = I8080_ENGINE_TABLE; i8080_engine_name(engine) != NULL; engine++) {
+			const double nanoseconds = instructions_bench_measure(engine, class, count);
+
+			if(nanoseconds != 0.0) {
+				printf(" %9.2f ns", nanoseconds);
+			} else {
+				printf(" %12s", "unavailable");
+			}
+		}
+		putchar('\n');
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+#include "bench.h"
+
+#include "../src/i8080/board/cpm_stub.h"
+
+/* Runs CP/M COM files to completion on many lanes, each lane starting with different registers.
+ * Lanes are first run one after the other on scalar engines, then all together with i8080_cpu_run_batch,
+ * reporting the lanes completed per second. The final state of each lane must be identical in every run */
+
+static const enum i8080_engine scalars[] = {
+	I8080_ENGINE_TABLE,
+	I8080_ENGINE_THREADED,
+};
+
+static void
+lockstep_bench_load(struct i8080_cpu *cpu, const uint8_t *program, size_t size, unsigned lane) {
+
+	i8080_cpu_init(cpu, &bench_io);
+
+	memcpy(cpu->memory, cpm_stub, sizeof(cpm_stub));
+	memcpy(cpu->memory + 0x100, program, size);
+
+	cpu->registers.pair.b = lane * 0x0101;
+	cpu->registers.pair.d = lane * 0x1111;
+	cpu->registers.pair.h = lane * 0x2323;
+	cpu->registers.a = lane;
+	cpu->pc = 0x100;
+}
+
+static bool
+lockstep_bench_stopped(struct i8080_cpu * const *cpus, unsigned lanes) {
+
+	for(unsigned lane = 0; lane < lanes; lane++) {
+		if(!cpus[lane]->stopped) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void
+lockstep_bench_report(const char *program, const char *mode, unsigned lanes,
+	uint64_t cycles, double elapsed, double reference) {
+	printf("%-16s %-10s %10.3f %12.2f %12.2f %7.2fx\n", program, mode,
+		elapsed, cycles / elapsed / 1e6, lanes / elapsed, reference / elapsed);
+}
+
+int
+main(int argc, char **argv) {
+	struct i8080_cpu **cpus, *lanecpus, *reference;
+	int status = EXIT_SUCCESS;
+	unsigned lanes;
+
+	if(argc < 3 || (lanes = strtoul(argv[1], NULL, 0)) == 0) {
+		fprintf(stderr, "usage: %s lanes program...\n", *argv);
+		return EXIT_FAILURE;
+	}
+
+	/* Cpus are allocated contiguously, separately allocated cpus would all start at the same offset
+	 * in their pages, and the registers and memory of the lanes would compete for the same cache sets */
+	cpus = calloc(lanes, sizeof(*cpus));
+	lanecpus = calloc(lanes, sizeof(*lanecpus));
+	reference = calloc(lanes, sizeof(*reference));
+	if(cpus == NULL || lanecpus == NULL || reference == NULL) {
+		err(EXIT_FAILURE, "calloc");
+	}
+
+	for(unsigned lane = 0; lane < lanes; lane++) {
+		cpus[lane] = lanecpus + lane;
+	}
+
+	printf("%-16s %-10s %10s %12s %12s %8s\n", "program", "mode", "seconds", "MHz", "lanes/s", "speedup");
+
+	for(char **program = argv + 2; program != argv + argc; program++) {
+		const char * const basename = bench_basename(*program);
+		static uint8_t code[I8080_MEMORY_SIZE - 0x100];
+		double start, elapsed, scalar = 0.0;
+		uint64_t cycles = 0;
+		FILE *filep;
+		size_t size;
+
+		if((filep = fopen(*program, "rb")) == NULL) {
+			err(EXIT_FAILURE, "fopen %s", *program);
+		}
+		size = fread(code, 1, sizeof(code), filep);
+		fclose(filep);
+
+		for(const enum i8080_engine *engine = scalars; engine != scalars + sizeof(scalars) / sizeof(*scalars); engine++) {
+			cycles = 0;
+			elapsed = 0.0;
+
+			for(unsigned lane = 0; lane < lanes; lane++) {
+				struct i8080_cpu * const cpu = cpus[lane];
+
+				lockstep_bench_load(cpu, code, size, lane);
+				i8080_cpu_set_engine(cpu, *engine);
+
+				start = bench_now();
+				while(!cpu->stopped) {
+					i8080_cpu_run(cpu, UINT64_MAX);
+				}
+				elapsed += bench_now() - start;
+
+				cycles += cpu->uptime_cycles;
+				if(engine == scalars) {
+					reference[lane] = *cpu;
+				}
+				i8080_cpu_deinit(cpu);
+			}
+
+			if(engine == scalars) {
+				scalar = elapsed;
+			}
+			lockstep_bench_report(basename, i8080_engine_name(*engine), lanes, cycles, elapsed, scalar);
+		}
+
+		for(unsigned lane = 0; lane < lanes; lane++) {
+			lockstep_bench_load(cpus[lane], code, size, lane);
+			i8080_cpu_set_engine(cpus[lane], I8080_ENGINE_THREADED);
+		}
+
+		cycles = 0;
+		start = bench_now();
+		while(!lockstep_bench_stopped(cpus, lanes)) {
+			cycles += i8080_cpu_run_batch(cpus, lanes, UINT64_MAX);
+		}
+		elapsed = bench_now() - start;
+
+		lockstep_bench_report(basename, "lockstep", lanes, cycles, elapsed, scalar);
+
+		for(unsigned lane = 0; lane < lanes; lane++) {
+			if(!bench_same(reference + lane, cpus[lane])) {
+				fprintf(stderr, "%s: Final state of lane %u differs from the table engine\n", *program, lane);
+				status = EXIT_FAILURE;
+			}
+			i8080_cpu_deinit(cpus[lane]);
+		}
+	}
+
+	free(reference);
+	free(lanecpus);
+	free(cpus);
+
+	return status;
+}
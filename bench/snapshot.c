@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <err.h>
+
+#include "bench.h"
+
+/* Resets a cpu running a CP/M COM file to its state after loading, either by initializing it
+ * and reading the file again, or by restoring a snapshot taken after loading. Each reset follows
+ * a short run of the program, and the state after a restore must be identical to the one after loading */
+
+#define SNAPSHOT_BENCH_ROUNDS 1000
+
+static void
+snapshot_bench_load(struct i8080_cpu *cpu, const char *filename) {
+
+	i8080_cpu_init(cpu, &bench_io);
+	bench_load(cpu, filename);
+}
+
+int
+main(int argc, char **argv) {
+	struct i8080_cpu *cpu, *reference;
+	struct i8080_snapshot *snapshot;
+	int status = EXIT_SUCCESS;
+	uint64_t cycles;
+
+	if(argc < 3) {
+		fprintf(stderr, "usage: %s cycles program...\n", *argv);
+		return EXIT_FAILURE;
+	}
+
+	cycles = strtoull(argv[1], NULL, 0);
+
+	cpu = malloc(sizeof(*cpu));
+	reference = malloc(sizeof(*reference));
+	snapshot = malloc(sizeof(*snapshot));
+	if(cpu == NULL || reference == NULL || snapshot == NULL) {
+		err(EXIT_FAILURE, "malloc");
+	}
+
+	printf("%-16s %12s %12s %12s %8s\n", "program", "dirty pages", "reload us", "restore us", "speedup");
+
+	for(char **program = argv + 2; program != argv + argc; program++) {
+		const char * const basename = bench_basename(*program);
+		double start, reload = 0.0, restore = 0.0;
+		unsigned dirty = 0;
+
+		snapshot_bench_load(reference, *program);
+
+		for(unsigned round = 0; round < SNAPSHOT_BENCH_ROUNDS; round++) {
+			snapshot_bench_load(cpu, *program);
+			i8080_cpu_run(cpu, cycles);
+
+			start = bench_now();
+			snapshot_bench_load(cpu, *program);
+			reload += bench_now() - start;
+		}
+
+		i8080_cpu_snapshot(cpu, snapshot);
+
+		for(unsigned round = 0; round < SNAPSHOT_BENCH_ROUNDS; round++) {
+			i8080_cpu_run(cpu, cycles);
+
+			dirty = 0;
+			for(unsigned page = 0; page < I8080_PAGE_COUNT; page++) {
+				dirty += cpu->dirty[page];
+			}
+
+			start = bench_now();
+			i8080_cpu_restore(cpu, snapshot);
+			restore += bench_now() - start;
+		}
+
+		printf("%-16s %12u %12.3f %12.3f %7.2fx\n", basename, dirty,
+			reload / SNAPSHOT_BENCH_ROUNDS * 1e6, restore / SNAPSHOT_BENCH_ROUNDS * 1e6, reload / restore);
+
+		if(!bench_same(reference, cpu)) {
+			fprintf(stderr, "%s: State after restore differs from the state after loading\n", *program);
+			status = EXIT_FAILURE;
+		}
+
+		i8080_cpu_deinit(cpu);
+		i8080_cpu_deinit(reference);
+	}
+
+	free(snapshot);
+	free(reference);
+	free(cpu);
+
+	return status;
+}
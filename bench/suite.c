@@ -0,0 +1,386 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <err.h>
+
+#include "bench.h"
+
+#include "space_invaders_machine.h"
+
+/* Throughput of an engine on fixed workloads: CP/M COM files run to completion, and headless Space Invaders
+ * for a number of frames, optionally replaying recorded inputs. Each workload is run several times in-process,
+ * and the wall time of the runs with its variance, the emulated MHz and the instructions per second are written as JSON.
+ * MHz and instructions per second are those of the best run. Instructions are counted once per workload
+ * by stepping it, unless the baseline already has them.
+ * Against a baseline, workloads whose best run is slower than the baseline's by more than the threshold fail the bench */
+
+#define SUITE_BENCH_RUNS      5
+#define SUITE_BENCH_FRAMES    3600
+#define SUITE_BENCH_THRESHOLD 10.0 /* Percent */
+
+struct suite_bench_args {
+	enum i8080_engine engine;
+	unsigned runs;
+	uint64_t frames;
+	const char *rom, *replay, *baseline;
+	double threshold;
+};
+
+struct suite_bench_workload {
+	const char *path;
+	char name[256]; /* Base name of the program, and of the inputs replayed if any */
+	bool invaders; /* Space Invaders ROM, else a CP/M COM file */
+	uint64_t cycles, instructions;
+	double mean, stddev, best, worst;
+	double baseline; /* Best run of the baseline, 0 without one */
+};
+
+static const struct option longopts[] = {
+	{ "engine", required_argument },
+	{ "runs", required_argument },
+	{ "frames", required_argument },
+	{ "rom", required_argument },
+	{ "replay", required_argument },
+	{ "baseline", required_argument },
+	{ "threshold", required_argument },
+	{ },
+};
+
+static void
+suite_bench_draw(const uint8_t *vram, bool vblank) {
+}
+
+static void
+suite_bench_usage(const char *progname) {
+	fprintf(stderr, "usage: %s [-engine <engine>] [-runs <count>] [-frames <count>] [-rom <space invaders rom>] [-replay <inputs>]"
+		" [-baseline <json>] [-threshold <percent>] program...\n", progname);
+	exit(EXIT_FAILURE);
+}
+
+static enum i8080_engine
+suite_bench_engine_find(const char *progname, const char *name) {
+	enum i8080_engine engine;
+
+	if(i8080_engine_find(name, &engine) != 0) {
+		fprintf(stderr, "%s: Invalid engine %s\n", progname, name);
+		suite_bench_usage(progname);
+	}
+
+	return engine;
+}
+
+static uint64_t
+suite_bench_parse_count(const char *progname, const char *what, const char *value) {
+	char *end;
+	const uint64_t count = strtoull(value, &end, 0);
+
+	if(*value == '\0' || *end != '\0' || count == 0) {
+		fprintf(stderr, "%s: Invalid %s %s\n", progname, what, value);
+		suite_bench_usage(progname);
+	}
+
+	return count;
+}
+
+static struct suite_bench_args
+suite_bench_parse_args(int argc, char **argv) {
+	struct suite_bench_args args = {
+		.engine = I8080_ENGINE_THREADED,
+		.runs = SUITE_BENCH_RUNS,
+		.frames = SUITE_BENCH_FRAMES,
+		.threshold = SUITE_BENCH_THRESHOLD,
+	};
+	int longindex, c;
+	char *end;
+
+	while(c = getopt_long_only(argc, argv, ":", longopts, &longindex), c != -1) {
+		switch(c) {
+		case 0:
+			switch(longindex) {
+			case 0:
+				args.engine = suite_bench_engine_find(*argv, optarg);
+				break;
+			case 1:
+				args.runs = suite_bench_parse_count(*argv, "run count", optarg);
+				break;
+			case 2:
+				args.frames = suite_bench_parse_count(*argv, "frame count", optarg);
+				break;
+			case 3:
+				args.rom = optarg;
+				break;
+			case 4:
+				args.replay = optarg;
+				break;
+			case 5:
+				args.baseline = optarg;
+				break;
+			case 6:
+				args.threshold = strtod(optarg, &end);
+				if(*optarg == '\0' || *end != '\0' || args.threshold < 0.0) {
+					fprintf(stderr, "%s: Invalid threshold %s\n", *argv, optarg);
+					suite_bench_usage(*argv);
+				}
+				break;
+			}
+			break;
+		case '?':
+			fprintf(stderr, "%s: Invalid option %s\n", *argv, argv[optind - 1]);
+			suite_bench_usage(*argv);
+		case ':':
+			fprintf(stderr, "%s: Missing option argument after -%s\n", *argv, longopts[longindex].name);
+			suite_bench_usage(*argv);
+		}
+	}
+
+	if(args.replay != NULL && args.rom == NULL) {
+		fprintf(stderr, "%s: Inputs can only be replayed on the Space Invaders ROM\n", *argv);
+		suite_bench_usage(*argv);
+	}
+
+	if(optind == argc && args.rom == NULL) {
+		fprintf(stderr, "%s: Expected at least one program or ROM\n", *argv);
+		suite_bench_usage(*argv);
+	}
+
+	return args;
+}
+
+/* Loads the workload on a fresh cpu, returns the cycles it runs for */
+static uint64_t
+suite_bench_setup(struct i8080_cpu *cpu, const struct suite_bench_args *args,
+	const struct suite_bench_workload *workload, enum i8080_engine engine, FILE **inputs) {
+
+	i8080_cpu_init(cpu, workload->invaders ? &space_invaders_machine_io : &bench_io);
+	if(i8080_cpu_set_engine(cpu, engine) != 0) {
+		errx(EXIT_FAILURE, "Engine %s unavailable", i8080_engine_name(engine));
+	}
+
+	*inputs = NULL;
+
+	if(workload->invaders) {
+		space_invaders_machine_setup(cpu, workload->path, suite_bench_draw);
+
+		if(args->replay != NULL) {
+			*inputs = fopen(args->replay, "r");
+			if(*inputs == NULL || space_invaders_machine_replay(cpu, *inputs) != 0) {
+				err(EXIT_FAILURE, "Unable to replay %s", args->replay);
+			}
+		}
+
+		return args->frames * SPACE_INVADERS_FRAME_CYCLES;
+	} else {
+		bench_load(cpu, workload->path);
+
+		return UINT64_MAX;
+	}
+}
+
+/* Without interrupts nor events to raise them, a halted cpu would never wake up again */
+static inline bool
+suite_bench_isonline(const struct i8080_cpu *cpu, uint64_t cycles) {
+	return (!cpu->stopped || (cpu->inte && cpu->event_count != 0)) && cpu->uptime_cycles < cycles;
+}
+
+static double
+suite_bench_run(const struct suite_bench_args *args, const struct suite_bench_workload *workload, uint64_t *cycles) {
+	static struct i8080_cpu cpu;
+	FILE *inputs;
+	const uint64_t limit = suite_bench_setup(&cpu, args, workload, args->engine, &inputs);
+	double start, elapsed;
+
+	start = bench_now();
+	while(suite_bench_isonline(&cpu, limit)) {
+		i8080_cpu_run(&cpu, limit - cpu.uptime_cycles);
+	}
+	elapsed = bench_now() - start;
+
+	*cycles = cpu.uptime_cycles;
+
+	i8080_cpu_deinit(&cpu);
+	if(inputs != NULL) {
+		fclose(inputs);
+	}
+
+	return elapsed;
+}
+
+/* Steps the workload on the table engine, every engine executes the same instructions */
+static uint64_t
+suite_bench_count(const struct suite_bench_args *args, const struct suite_bench_workload *workload) {
+	static struct i8080_cpu cpu;
+	FILE *inputs;
+	const uint64_t limit = suite_bench_setup(&cpu, args, workload, I8080_ENGINE_TABLE, &inputs);
+	uint64_t instructions = 0;
+
+	while(suite_bench_isonline(&cpu, limit)) {
+		instructions += !cpu.stopped;
+		i8080_cpu_next(&cpu);
+	}
+
+	i8080_cpu_deinit(&cpu);
+	if(inputs != NULL) {
+		fclose(inputs);
+	}
+
+	return instructions;
+}
+
+/* Reads the best time and instructions of a workload from a previous output of the bench,
+ * only if it ran the same number of cycles. Returns whether it was found */
+static bool
+suite_bench_baseline(const char *baseline, struct suite_bench_workload *workload) {
+	char key[1024];
+	const char *entry, *next, *field;
+	uint64_t cycles;
+
+	snprintf(key, sizeof(key), "\"name\": \"%s\"", workload->name);
+
+	entry = strstr(baseline, key);
+	if(entry == NULL) {
+		return false;
+	}
+
+	next = strstr(entry + strlen(key), "\"name\":");
+	if(next == NULL) {
+		next = entry + strlen(entry);
+	}
+
+	if(field = strstr(entry, "\"cycles\":"), field == NULL || field > next
+		|| (cycles = strtoull(field + sizeof("\"cycles\":") - 1, NULL, 10)) != workload->cycles) {
+		fprintf(stderr, "%s: Baseline ran a different number of cycles, ignored\n", workload->name);
+		return false;
+	}
+
+	if(field = strstr(entry, "\"best\":"), field != NULL && field < next) {
+		workload->baseline = strtod(field + sizeof("\"best\":") - 1, NULL);
+	}
+
+	if(field = strstr(entry, "\"instructions\":"), field != NULL && field < next) {
+		workload->instructions = strtoull(field + sizeof("\"instructions\":") - 1, NULL, 10);
+	}
+
+	return true;
+}
+
+static char *
+suite_bench_read(const char *path) {
+	FILE * const filep = fopen(path, "r");
+	char *contents;
+	long size;
+
+	if(filep == NULL || fseek(filep, 0, SEEK_END) != 0 || (size = ftell(filep)) < 0 || fseek(filep, 0, SEEK_SET) != 0) {
+		err(EXIT_FAILURE, "Unable to read baseline %s", path);
+	}
+
+	contents = malloc(size + 1);
+	if(contents == NULL) {
+		err(EXIT_FAILURE, "malloc");
+	}
+
+	contents[fread(contents, 1, size, filep)] = '\0';
+	fclose(filep);
+
+	return contents;
+}
+
+static void
+suite_bench_measure(const struct suite_bench_args *args, struct suite_bench_workload *workload, const char *baseline) {
+	double sum = 0.0, squares = 0.0;
+
+	workload->best = INFINITY;
+	workload->worst = 0.0;
+
+	for(unsigned run = 0; run < args->runs; run++) {
+		uint64_t cycles;
+		const double elapsed = suite_bench_run(args, workload, &cycles);
+
+		if(run != 0 && cycles != workload->cycles) {
+			errx(EXIT_FAILURE, "%s: Run %u ran %" PRIu64 " cycles instead of %" PRIu64, workload->name, run, cycles, workload->cycles);
+		}
+		workload->cycles = cycles;
+
+		sum += elapsed;
+		squares += elapsed * elapsed;
+		if(elapsed < workload->best) {
+			workload->best = elapsed;
+		}
+		if(elapsed > workload->worst) {
+			workload->worst = elapsed;
+		}
+	}
+
+	workload->mean = sum / args->runs;
+	workload->stddev = args->runs > 1 ? sqrt(fmax(0.0, (squares - sum * workload->mean) / (args->runs - 1))) : 0.0;
+
+	if(baseline == NULL || !suite_bench_baseline(baseline, workload) || workload->instructions == 0) {
+		workload->instructions = suite_bench_count(args, workload);
+	}
+}
+
+int
+main(int argc, char **argv) {
+	const struct suite_bench_args args = suite_bench_parse_args(argc, argv);
+	const size_t count = argc - optind + (args.rom != NULL);
+	struct suite_bench_workload * const workloads = calloc(count, sizeof(*workloads));
+	char * const baseline = args.baseline != NULL ? suite_bench_read(args.baseline) : NULL;
+	int status = EXIT_SUCCESS;
+
+	if(workloads == NULL) {
+		err(EXIT_FAILURE, "calloc");
+	}
+
+	for(size_t i = 0; i < count; i++) {
+		struct suite_bench_workload * const workload = workloads + i;
+
+		workload->invaders = args.rom != NULL && i == count - 1;
+		workload->path = workload->invaders ? args.rom : argv[optind + i];
+		if(workload->invaders && args.replay != NULL) {
+			snprintf(workload->name, sizeof(workload->name), "%s:%s", bench_basename(args.rom), bench_basename(args.replay));
+		} else {
+			snprintf(workload->name, sizeof(workload->name), "%s", bench_basename(workload->path));
+		}
+
+		suite_bench_measure(&args, workload, baseline);
+	}
+
+	printf("{\n\t\"engine\": \"%s\",\n\t\"runs\": %u,\n\t\"workloads\": [\n", i8080_engine_name(args.engine), args.runs);
+
+	for(size_t i = 0; i < count; i++) {
+		const struct suite_bench_workload * const workload = workloads + i;
+
+		printf("\t\t{\n\t\t\t\"name\": \"%s\",\n", workload->name);
+		if(workload->invaders) {
+			printf("\t\t\t\"frames\": %" PRIu64 ",\n", args.frames);
+		}
+		printf("\t\t\t\"cycles\": %" PRIu64 ",\n\t\t\t\"instructions\": %" PRIu64 ",\n", workload->cycles, workload->instructions);
+		printf("\t\t\t\"seconds\": { \"mean\": %.9f, \"stddev\": %.9f, \"best\": %.9f, \"worst\": %.9f },\n",
+			workload->mean, workload->stddev, workload->best, workload->worst);
+		printf("\t\t\t\"mhz\": %.2f,\n\t\t\t\"instructions_per_second\": %.0f",
+			workload->cycles / workload->best / 1e6, workload->instructions / workload->best);
+
+		if(workload->baseline != 0.0) {
+			const double change = 100.0 * (workload->best - workload->baseline) / workload->baseline;
+
+			printf(",\n\t\t\t\"baseline\": { \"best\": %.9f, \"change\": %.2f }", workload->baseline, change);
+
+			if(change > args.threshold) {
+				fprintf(stderr, "%s: %.2f%% slower than the baseline, above the %.2f%% threshold\n",
+					workload->name, change, args.threshold);
+				status = EXIT_FAILURE;
+			}
+		}
+
+		printf("\n\t\t}%s\n", i != count - 1 ? "," : "");
+	}
+
+	printf("\t]\n}\n");
+
+	free(baseline);
+	free(workloads);
+
+	return status;
+}
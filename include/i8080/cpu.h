@@ -1,6 +1,7 @@
 #ifndef I8080_CPU_H
 #define I8080_CPU_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -8,6 +9,10 @@
 #include "i8080/endianness.h"
 
 #define I8080_MEMORY_SIZE 0x10000
+#define I8080_PAGE_SIZE   0x100
+#define I8080_PAGE_COUNT  (I8080_MEMORY_SIZE / I8080_PAGE_SIZE)
+
+#define I8080_EVENT_COUNT 16
 
 #define I8080_BIT_CONDITION_CARRY           0
 #define I8080_BIT_CONDITION_UNUSED1         1
@@ -28,6 +33,10 @@
 #define I8080_MASK_CONDITION_SIGN            (1 << I8080_BIT_CONDITION_SIGN)
 
 struct i8080_cpu;
+struct i8080_block_cache;
+struct i8080_snapshot;
+struct i8080_profile;
+struct i8080_trace;
 
 union i8080_imm {
 	uint16_t a16;
@@ -44,15 +53,69 @@ struct i8080_rom_section {
 	uint16_t begin, end;
 };
 
+/* Memory mapped devices, called for accesses to the pages they are mapped on.
+ * Registers are not guaranteed to be up to date when they are called */
+struct i8080_mmio {
+	uint8_t (*load)(struct i8080_cpu *, uint16_t);
+	void (*store)(struct i8080_cpu *, uint16_t, uint8_t);
+};
+
+/* A page is accessed directly through host memory when load or store are set,
+ * else through its mmio if any. Unmapped reads return 0xFF, unmapped writes are discarded */
+struct i8080_page {
+	uint8_t *load;
+	uint8_t *store;
+	const struct i8080_mmio *mmio;
+};
+
+enum i8080_engine {
+	I8080_ENGINE_TABLE,    /* Decodes and dispatches each instruction through the opcode table */
+	I8080_ENGINE_THREADED, /* Threaded interpreter, registers cached and handlers directly chained */
+	I8080_ENGINE_BLOCK,    /* Predecoded straight-line blocks cached by address, dropped when their code is written */
+	I8080_ENGINE_JIT,      /* Block engine translating hot blocks to native code, unavailable if not built with I8080_JIT */
+};
+
+struct i8080_block_stats {
+	uint64_t hits, misses, invalidations;
+	uint64_t skipped; /* Cycles skipped in idle loops */
+};
+
+/* Events posted by boards at absolute cycle timestamps (interrupts, device timers...) */
+struct i8080_event {
+	uint64_t timestamp;
+	void (*handler)(struct i8080_cpu *, void *);
+	void *data;
+};
+
 struct i8080_instruction {
 	const char *mnemonic;
 	bool (*execute)(struct i8080_cpu *, union i8080_imm);
 	unsigned length, nojump, onjump;
 };
 
+/* Execution counts of each opcode, and of each pair of consecutive opcodes indexed by [first][second] */
+struct i8080_histogram {
+	uint64_t opcodes[0x100];
+	uint64_t pairs[0x100][0x100];
+	uint16_t previous; /* Last opcode counted, 0x100 before the first one */
+};
+
+/* Registers, pending events and memory of a cpu, as seen through its pages when the snapshot was taken */
+struct i8080_snapshot {
+	unsigned stopped : 1;
+	unsigned inte : 1;
+	uint16_t b, d, h, psw;
+	uint16_t pc, sp;
+	uint64_t uptime_cycles;
+	unsigned event_count;
+	struct i8080_event events[I8080_EVENT_COUNT];
+	uint8_t memory[I8080_MEMORY_SIZE];
+};
+
 struct i8080_cpu {
 	unsigned stopped : 1;
 	unsigned inte : 1;
+	unsigned yield : 1;
 	union {
 		struct {
 #ifdef I8080_TARGET_LITTLE_ENDIAN
@@ -85,8 +148,21 @@ struct i8080_cpu {
 	} registers;
 	uint16_t pc, sp;
 	uint64_t uptime_cycles;
+	enum i8080_engine engine;
+	struct i8080_block_cache *blocks;
+	struct i8080_profile *profile;
+	struct i8080_histogram *histogram;
+	struct i8080_trace *trace;
 	const struct i8080_io *io;
-	const struct i8080_rom_section *rom_map;
+	void *data; /* Private data of the board, untouched by the library */
+	const struct i8080_snapshot *snapshot; /* Last snapshot taken or restored */
+	bool dirty[I8080_PAGE_COUNT]; /* Pages written since the last snapshot taken or restored */
+	uint8_t *clean[I8080_PAGE_COUNT]; /* Store mapping of the pages write protected until their first write since then */
+	unsigned event_count;
+	struct i8080_event events[I8080_EVENT_COUNT]; /* Pending events, min-heap on their timestamps */
+	struct i8080_page pages[I8080_PAGE_COUNT];
+	struct i8080_page mapping[I8080_PAGE_COUNT]; /* As mapped by the board, before ROM sections */
+	uint8_t rom_bytes[I8080_MEMORY_SIZE / 8];
 	uint8_t memory[I8080_MEMORY_SIZE];
 };
 
@@ -96,9 +172,122 @@ i8080_cpu_init(struct i8080_cpu *cpu, const struct i8080_io *io);
 int
 i8080_cpu_deinit(struct i8080_cpu *cpu);
 
+int
+i8080_cpu_set_engine(struct i8080_cpu *cpu, enum i8080_engine engine);
+
+/* Name of an engine as given on command lines, NULL past the last engine */
+const char *
+i8080_engine_name(enum i8080_engine engine);
+
+/* Engine of the given name, regardless of case. Fails for unknown names */
+int
+i8080_engine_find(const char *name, enum i8080_engine *engine);
+
+/* Replaces the ROM sections, ending with an empty one. Stores to them are dropped whatever host memory is mapped there.
+ * Fails if a section covers a page mapped to mmio, whose handler decides what its stores do */
+int
+i8080_cpu_set_rom_map(struct i8080_cpu *cpu, const struct i8080_rom_section *rom_map);
+
+int
+i8080_cpu_map(struct i8080_cpu *cpu, uint16_t address, size_t size, uint8_t *load, uint8_t *store);
+
+/* Fails over pages covered by ROM sections */
+int
+i8080_cpu_map_mmio(struct i8080_cpu *cpu, uint16_t address, size_t size, const struct i8080_mmio *mmio);
+
+/* Must be called when the host writes directly in memory, for the engines caching decoded instructions
+ * and so the pages written are restored by i8080_cpu_restore */
+int
+i8080_cpu_invalidate(struct i8080_cpu *cpu, uint16_t address, size_t size);
+
+/* Snapshots registers, pending events and memory of all pages with host memory. Pages are write protected, and marked dirty
+ * by their first write from then on, so restoring the same snapshot only copies them back. Page mappings must not change in-between */
+int
+i8080_cpu_snapshot(struct i8080_cpu *cpu, struct i8080_snapshot *snapshot);
+
+int
+i8080_cpu_restore(struct i8080_cpu *cpu, const struct i8080_snapshot *snapshot);
+
+int
+i8080_cpu_block_stats(const struct i8080_cpu *cpu, struct i8080_block_stats *stats);
+
+/* Block and jit engines only: polling loops which provably do the same thing at each iteration until an event
+ * (reading memory at fixed addresses, comparing, jumping back, never storing) are skipped up to the next event.
+ * Registers, memory and cycle counts end up exactly as if they had been run. Must be set after the engine, before running */
+int
+i8080_cpu_set_idle_skip(struct i8080_cpu *cpu, bool enabled);
+
+/* Profiling, unavailable if not built with I8080_PROFILE. Cycles are accumulated per address, and per call stack
+ * by following calls, restarts, interrupts and returns. Lockstep batches are not profiled, nor cycles skipped by
+ * idle loops or halts, and the jit engine falls back to the block interpreter meanwhile */
+int
+i8080_cpu_profile_start(struct i8080_cpu *cpu);
+
+int
+i8080_cpu_profile_stop(struct i8080_cpu *cpu);
+
+/* Cycles spent at each address since profiling started */
+const uint64_t *
+i8080_cpu_profile_cycles(const struct i8080_cpu *cpu);
+
+/* Writes the call stacks in the collapsed format of flamegraph tools, one line per stack with its frames
+ * named after their entry point from the root (the pc when profiling started) and the cycles spent in the last one */
+int
+i8080_cpu_profile_write(const struct i8080_cpu *cpu, FILE *output);
+
+/* Opcode counting, unavailable if not built with I8080_HISTOGRAM. As with profiling,
+ * lockstep batches are not counted and the jit engine falls back to the block interpreter meanwhile */
+int
+i8080_cpu_histogram_start(struct i8080_cpu *cpu);
+
+int
+i8080_cpu_histogram_stop(struct i8080_cpu *cpu);
+
+/* Counts since counting started, NULL if not counting */
+const struct i8080_histogram *
+i8080_cpu_histogram(const struct i8080_cpu *cpu);
+
+/* Execution tracing, unavailable if not built with I8080_TRACE. Each instruction executed is recorded with the registers
+ * it changed and the memory it wrote, in the compact binary format of src/libi8080/trace.h, written to output by a background
+ * thread. Lockstep batches are not traced, and the threaded and jit engines fall back to the table and block interpreters meanwhile */
+int
+i8080_cpu_trace_start(struct i8080_cpu *cpu, FILE *output);
+
+/* Flushes the trace, fails if any of it could not be written */
+int
+i8080_cpu_trace_stop(struct i8080_cpu *cpu);
+
+/* Posts an event, its handler is called with data by i8080_cpu_run once uptime_cycles reaches timestamp:
+ * the cpu runs exactly up to the boundary of the instruction reaching it, then the handler is dispatched.
+ * Events are dispatched in timestamp order, and handlers may post other events. Fails when I8080_EVENT_COUNT are pending */
+int
+i8080_cpu_schedule(struct i8080_cpu *cpu, uint64_t timestamp, void (*handler)(struct i8080_cpu *, void *), void *data);
+
+/* Cancels the pending events with this handler and data */
+int
+i8080_cpu_unschedule(struct i8080_cpu *cpu, void (*handler)(struct i8080_cpu *, void *), void *data);
+
 int
 i8080_cpu_next(struct i8080_cpu *cpu);
 
+/* Runs until the cpu stops, yields or cycle_budget cycles elapsed, dispatching the events reached in-between */
+uint64_t
+i8080_cpu_run(struct i8080_cpu *cpu, uint64_t cycle_budget);
+
+/* Batch variants of i8080_cpu_next and i8080_cpu_run over independent cpus, typically running the same program
+ * from different initial states. Cpus at the same pc are stepped together in SIMD lanes, and split apart when they diverge.
+ * Each cpu ends up as if it was run by itself, i8080_cpu_run_batch returns the sum of the cycles run by all cpus */
+int
+i8080_cpu_next_batch(struct i8080_cpu * const *cpus, size_t count);
+
+uint64_t
+i8080_cpu_run_batch(struct i8080_cpu * const *cpus, size_t count, uint64_t cycle_budget);
+
+/* Makes i8080_cpu_run return, from io callbacks, mmio handlers or event handlers. The table and threaded engines
+ * return once the current instruction completes, the block and jit engines may complete the current block first */
+int
+i8080_cpu_yield(struct i8080_cpu *cpu);
+
 int
 i8080_cpu_interrupt(struct i8080_cpu *cpu, uint8_t opcode, union i8080_imm imm);
 
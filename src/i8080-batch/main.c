@@ -0,0 +1,435 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <errno.h>
+#include <err.h>
+
+#include "i8080/cpu.h"
+
+#include "../i8080/board/cpm.h"
+
+/* Runs a list of CP/M programs, each one on its own cpu, across a pool of threads.
+ * Jobs are dealt in contiguous ranges to the workers, which pop their own jobs from the bottom
+ * of their range and steal from the top of the others' once done. Console output of each job
+ * is captured in memory, and optionally saved to <directory>/<job>.out.
+ * Files opened by the programs are the ones of the host directory given with -directory */
+
+struct batch_args {
+	const char *joblist;
+	const char *output;
+	const char *directory;
+	unsigned threads;
+	enum i8080_engine engine;
+	uint64_t cycles;
+};
+
+struct batch_job {
+	char *program, *input_name, *command;
+	uint8_t *input;
+	size_t input_size;
+	uint8_t *output;
+	size_t output_size;
+	const char *status;
+	uint64_t cycles;
+	double seconds;
+};
+
+struct batch_worker {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	size_t top, bottom; /* Pending jobs, in [top, bottom) */
+	struct batch *batch;
+};
+
+struct batch {
+	const struct batch_args *args;
+	struct batch_job *jobs;
+	size_t count;
+	struct batch_worker *workers;
+};
+
+static const struct option longopts[] = {
+	{ "threads", required_argument },
+	{ "engine", required_argument },
+	{ "cycles", required_argument },
+	{ "output", required_argument },
+	{ "directory", required_argument },
+	{ },
+};
+
+static double
+batch_now(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static enum i8080_engine
+batch_engine_parse(const char *name) {
+	enum i8080_engine engine;
+
+	if(i8080_engine_find(name, &engine) != 0) {
+		fprintf(stderr, "Unable to find engine named '%s', available engines are:\n", name);
+
+		for(engine = I8080_ENGINE_TABLE; i8080_engine_name(engine) != NULL; engine++) {
+			printf("  - %s\n", i8080_engine_name(engine));
+		}
+
+		exit(EXIT_FAILURE);
+	}
+
+	return engine;
+}
+
+static void
+batch_usage(const char *batchname) {
+	fprintf(stderr, "usage: %s [-threads <count>] [-engine <engine>] [-cycles <limit>] [-output <directory>] [-directory <directory>] joblist\n", batchname);
+	exit(EXIT_FAILURE);
+}
+
+static struct batch_args
+batch_parse_args(int argc, char **argv) {
+	const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	struct batch_args args = {
+		.output = NULL,
+		.directory = NULL,
+		.threads = processors > 0 ? processors : 1,
+		.engine = I8080_ENGINE_THREADED,
+		.cycles = UINT64_MAX,
+	};
+	int longindex, c;
+	char *end;
+
+	while(c = getopt_long_only(argc, argv, ":", longopts, &longindex), c != -1) {
+		switch(c) {
+		case 0:
+			switch(longindex) {
+			case 0:
+				args.threads = strtoul(optarg, &end, 0);
+				if(*optarg == '\0' || *end != '\0' || args.threads == 0) {
+					fprintf(stderr, "%s: Invalid thread count %s\n", *argv, optarg);
+					batch_usage(*argv);
+				}
+				break;
+			case 1:
+				args.engine = batch_engine_parse(optarg);
+				break;
+			case 2:
+				args.cycles = strtoull(optarg, &end, 0);
+				if(*optarg == '\0' || *end != '\0') {
+					fprintf(stderr, "%s: Invalid cycle limit %s\n", *argv, optarg);
+					batch_usage(*argv);
+				}
+				break;
+			case 3:
+				args.output = optarg;
+				break;
+			case 4:
+				args.directory = optarg;
+				break;
+			}
+			break;
+		case '?':
+			fprintf(stderr, "%s: Invalid option %s\n", *argv, argv[optind - 1]);
+			batch_usage(*argv);
+		case ':':
+			fprintf(stderr, "%s: Missing option argument after -%s\n", *argv, longopts[longindex].name);
+			batch_usage(*argv);
+		}
+	}
+
+	if(argc - optind != 1) {
+		fprintf(stderr, "%s: Expected one job list\n", *argv);
+		batch_usage(*argv);
+	}
+
+	args.joblist = argv[optind];
+
+	return args;
+}
+
+static void
+batch_load_input(struct batch_job *job) {
+	FILE * const filep = fopen(job->input_name, "rb");
+	size_t capacity = 0;
+
+	if(filep == NULL) {
+		err(EXIT_FAILURE, "fopen %s", job->input_name);
+	}
+
+	do {
+		capacity = capacity != 0 ? capacity * 2 : 4096;
+		job->input = realloc(job->input, capacity);
+		if(job->input == NULL) {
+			err(EXIT_FAILURE, "realloc");
+		}
+		job->input_size += fread(job->input + job->input_size, 1, capacity - job->input_size, filep);
+	} while(job->input_size == capacity);
+
+	if(ferror(filep)) {
+		err(EXIT_FAILURE, "fread %s", job->input_name);
+	}
+
+	fclose(filep);
+}
+
+/* One job per line: the program, followed by an optional console input file ('-' for none),
+ * and the rest of the line is the command tail. Empty lines and lines starting with '#' are ignored */
+static void
+batch_parse_joblist(struct batch *batch, const char *joblist) {
+	FILE * const filep = strcmp(joblist, "-") != 0 ? fopen(joblist, "r") : stdin;
+	size_t capacity = 0, linesize = 0;
+	char *line = NULL;
+
+	if(filep == NULL) {
+		err(EXIT_FAILURE, "fopen %s", joblist);
+	}
+
+	while(getline(&line, &linesize, filep) != -1) {
+		const char * const program = strtok(line, " \t\r\n"),
+			* const input = program != NULL ? strtok(NULL, " \t\r\n") : NULL,
+			* const command = input != NULL ? strtok(NULL, "\r\n") : NULL;
+		struct batch_job *job;
+
+		if(program == NULL || *program == '#') {
+			continue;
+		}
+
+		if(access(program, R_OK) != 0) {
+			err(EXIT_FAILURE, "%s", program);
+		}
+
+		if(batch->count == capacity) {
+			capacity = capacity != 0 ? capacity * 2 : 64;
+			batch->jobs = realloc(batch->jobs, capacity * sizeof(*batch->jobs));
+			if(batch->jobs == NULL) {
+				err(EXIT_FAILURE, "realloc");
+			}
+		}
+
+		job = batch->jobs + batch->count++;
+		memset(job, 0, sizeof(*job));
+		job->program = strdup(program);
+		job->status = "pending";
+
+		if(input != NULL && strcmp(input, "-") != 0) {
+			job->input_name = strdup(input);
+			batch_load_input(job);
+		}
+
+		if(command != NULL) {
+			job->command = strdup(command);
+		}
+	}
+
+	free(line);
+	if(filep != stdin) {
+		fclose(filep);
+	}
+}
+
+static void
+batch_job_run(struct batch_job *job, struct i8080_cpu *cpu, struct cpm_machine *machine, const struct batch_args *args) {
+	double start;
+
+	*machine = (struct cpm_machine) {
+		.console = { .fd = -1, .input = job->input, .input_size = job->input_size, .input_offset = 0 },
+		.files = { .directory = args->directory },
+		.command = job->command,
+	};
+
+	i8080_cpu_init(cpu, cpm_board.io);
+	if(i8080_cpu_set_engine(cpu, args->engine) != 0) {
+		job->status = "failed";
+		return;
+	}
+
+	cpu->data = machine;
+	cpm_board.setup(cpu, job->program);
+
+	start = batch_now();
+	while(cpm_board.isonline(cpu) && cpu->uptime_cycles < args->cycles) {
+		const uint64_t left = args->cycles - cpu->uptime_cycles;
+
+		cpm_board.poll(cpu);
+
+		i8080_cpu_run(cpu, left < cpm_board.quantum ? left : cpm_board.quantum);
+
+		cpm_board.sync(cpu);
+	}
+	job->seconds = batch_now() - start;
+	job->cycles = cpu->uptime_cycles;
+	job->status = cpm_board.isonline(cpu) ? "limit" : "halted";
+
+	cpm_board.teardown(cpu);
+	i8080_cpu_deinit(cpu);
+
+	/* Output is captured in memory, flushed by the teardown */
+	job->output = machine->console.captured;
+	job->output_size = machine->console.captured_size;
+	if(machine->console.failed) {
+		job->status = "failed";
+	}
+}
+
+/* Owner's end of the range */
+static bool
+batch_worker_pop(struct batch_worker *worker, size_t *index) {
+	bool popped = false;
+
+	pthread_mutex_lock(&worker->lock);
+	if(worker->top != worker->bottom) {
+		*index = --worker->bottom;
+		popped = true;
+	}
+	pthread_mutex_unlock(&worker->lock);
+
+	return popped;
+}
+
+/* Thieves' end of the range */
+static bool
+batch_worker_steal(struct batch_worker *victim, size_t *index) {
+	bool stolen = false;
+
+	pthread_mutex_lock(&victim->lock);
+	if(victim->top != victim->bottom) {
+		*index = victim->top++;
+		stolen = true;
+	}
+	pthread_mutex_unlock(&victim->lock);
+
+	return stolen;
+}
+
+static void *
+batch_worker_main(void *arg) {
+	struct batch_worker * const worker = arg;
+	struct batch * const batch = worker->batch;
+	const unsigned threads = batch->args->threads, self = worker - batch->workers;
+	struct i8080_cpu * const cpu = malloc(sizeof(*cpu));
+	struct cpm_machine * const machine = malloc(sizeof(*machine));
+	size_t index = 0;
+
+	if(cpu == NULL || machine == NULL) {
+		err(EXIT_FAILURE, "malloc");
+	}
+
+	for(;;) {
+		unsigned other = 1;
+
+		if(!batch_worker_pop(worker, &index)) {
+			/* No job is ever added, so once every range is empty, all jobs are taken */
+			while(other < threads && !batch_worker_steal(batch->workers + (self + other) % threads, &index)) {
+				other++;
+			}
+
+			if(other == threads) {
+				break;
+			}
+		}
+
+		batch_job_run(batch->jobs + index, cpu, machine, batch->args);
+	}
+
+	free(machine);
+	free(cpu);
+
+	return NULL;
+}
+
+static void
+batch_save_output(const struct batch_job *job, size_t index, const char *directory) {
+	char path[4096];
+	FILE *filep;
+
+	snprintf(path, sizeof(path), "%s/%zu.out", directory, index);
+
+	filep = fopen(path, "wb");
+	if(filep == NULL) {
+		err(EXIT_FAILURE, "fopen %s", path);
+	}
+
+	fwrite(job->output, 1, job->output_size, filep);
+	fclose(filep);
+}
+
+int
+main(int argc, char **argv) {
+	const struct batch_args args = batch_parse_args(argc, argv);
+	struct batch batch = { .args = &args };
+	uint64_t cycles = 0;
+	double start, elapsed;
+	int status = EXIT_SUCCESS;
+
+	batch_parse_joblist(&batch, args.joblist);
+
+	batch.workers = calloc(args.threads, sizeof(*batch.workers));
+	if(batch.workers == NULL) {
+		err(EXIT_FAILURE, "calloc");
+	}
+
+	for(unsigned i = 0; i < args.threads; i++) {
+		struct batch_worker * const worker = batch.workers + i;
+
+		pthread_mutex_init(&worker->lock, NULL);
+		worker->top = batch.count * i / args.threads;
+		worker->bottom = batch.count * (i + 1) / args.threads;
+		worker->batch = &batch;
+	}
+
+	start = batch_now();
+	for(unsigned i = 0; i < args.threads; i++) {
+		const int errcode = pthread_create(&batch.workers[i].thread, NULL, batch_worker_main, batch.workers + i);
+
+		if(errcode != 0) {
+			errno = errcode;
+			err(EXIT_FAILURE, "pthread_create");
+		}
+	}
+
+	for(unsigned i = 0; i < args.threads; i++) {
+		pthread_join(batch.workers[i].thread, NULL);
+		pthread_mutex_destroy(&batch.workers[i].lock);
+	}
+	elapsed = batch_now() - start;
+
+	printf("%6s %-24s %-8s %14s %10s %10s %10s\n", "job", "program", "status", "cycles", "seconds", "MHz", "output");
+
+	for(size_t i = 0; i < batch.count; i++) {
+		struct batch_job * const job = batch.jobs + i;
+		const char * const basename = strrchr(job->program, '/') != NULL ? strrchr(job->program, '/') + 1 : job->program;
+
+		printf("%6zu %-24s %-8s %14" PRIu64 " %10.3f %10.2f %10zu\n", i, basename, job->status,
+			job->cycles, job->seconds, job->seconds != 0.0 ? job->cycles / job->seconds / 1e6 : 0.0, job->output_size);
+
+		if(strcmp(job->status, "failed") == 0) {
+			status = EXIT_FAILURE;
+		} else if(args.output != NULL) {
+			batch_save_output(job, i, args.output);
+		}
+
+		cycles += job->cycles;
+
+		free(job->program);
+		free(job->input_name);
+		free(job->command);
+		free(job->input);
+		free(job->output);
+	}
+
+	printf("%zu jobs on %u threads in %.3f seconds: %.2f jobs/s, %.2f MHz aggregate\n",
+		batch.count, args.threads, elapsed, batch.count / elapsed, cycles / elapsed / 1e6);
+
+	free(batch.workers);
+	free(batch.jobs);
+
+	return status;
+}
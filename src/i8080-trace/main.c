@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+#include "i8080/cpu.h"
+
+#include "trace.h"
+
+/* Decodes a trace recorded with i8080_cpu_trace_start into disassembly, one line per instruction:
+ * uptime before the instruction, address, bytes, mnemonic with its immediate,
+ * then the registers it changed and the memory it wrote */
+
+struct trace_state {
+	FILE *input;
+	uint16_t address, sp, bc, de, hl;
+	uint8_t a, f;
+	uint64_t uptime_cycles;
+};
+
+static int
+trace_read8(struct trace_state *state, uint8_t *value) {
+	const int c = fgetc(state->input);
+
+	if(c == EOF) {
+		return -1;
+	}
+
+	*value = c;
+
+	return 0;
+}
+
+static uint8_t
+trace_get8(struct trace_state *state) {
+	uint8_t value;
+
+	if(trace_read8(state, &value) != 0) {
+		errx(EXIT_FAILURE, "Truncated trace");
+	}
+
+	return value;
+}
+
+static uint16_t
+trace_get16(struct trace_state *state) {
+	const uint8_t low = trace_get8(state);
+
+	return (uint16_t)trace_get8(state) << 8 | low;
+}
+
+static uint64_t
+trace_get64(struct trace_state *state) {
+	uint64_t value = 0;
+
+	for(unsigned i = 0; i < 8; i++) {
+		value |= (uint64_t)trace_get8(state) << i * 8;
+	}
+
+	return value;
+}
+
+static void
+trace_header(struct trace_state *state) {
+	char magic[sizeof(I8080_TRACE_MAGIC) - 1];
+	uint8_t b, c, d, e, h, l;
+
+	if(fread(magic, 1, sizeof(magic), state->input) != sizeof(magic)
+		|| memcmp(magic, I8080_TRACE_MAGIC, sizeof(magic)) != 0) {
+		errx(EXIT_FAILURE, "Not a trace");
+	}
+
+	if(trace_get8(state) != I8080_TRACE_VERSION) {
+		errx(EXIT_FAILURE, "Unsupported trace version");
+	}
+
+	state->address = trace_get16(state);
+	state->sp = trace_get16(state);
+	state->a = trace_get8(state);
+	state->f = trace_get8(state);
+	b = trace_get8(state), c = trace_get8(state);
+	d = trace_get8(state), e = trace_get8(state);
+	h = trace_get8(state), l = trace_get8(state);
+	state->bc = b << 8 | c;
+	state->de = d << 8 | e;
+	state->hl = h << 8 | l;
+	state->uptime_cycles = trace_get64(state);
+
+	printf("; pc=%04X sp=%04X a=%02X f=%02X bc=%04X de=%04X hl=%04X uptime=%" PRIu64 "\n",
+		state->address, state->sp, state->a, state->f, state->bc, state->de, state->hl, state->uptime_cycles);
+}
+
+/* Mnemonics name their immediate D8, D16 or A16, replaced by its value */
+static void
+trace_mnemonic(const struct i8080_instruction *instruction, uint16_t imm, char *buffer, size_t size) {
+	const char * const name = instruction->mnemonic, * const operand = strrchr(name, ' ');
+
+	if(instruction->length == 1 || operand == NULL) {
+		snprintf(buffer, size, "%s", name);
+	} else if(instruction->length == 2) {
+		snprintf(buffer, size, "%.*s %02Xh", (int)(operand - name), name, imm);
+	} else {
+		snprintf(buffer, size, "%.*s %04Xh", (int)(operand - name), name, imm);
+	}
+}
+
+static bool
+trace_record(struct trace_state *state) {
+	const struct i8080_instruction *instruction;
+	uint8_t opcode, flags, extension = 0;
+	char mnemonic[32], bytes[16];
+	uint16_t address, imm = 0;
+	unsigned cycles;
+
+	if(trace_read8(state, &opcode) != 0) {
+		return false;
+	}
+
+	instruction = i8080_instruction_info(opcode);
+	flags = trace_get8(state);
+
+	address = flags & I8080_TRACE_ADDRESS ? trace_get16(state) : state->address;
+
+	switch(instruction->length) {
+	case 2:
+		imm = trace_get8(state);
+		snprintf(bytes, sizeof(bytes), "%02X %02X", opcode, imm);
+		break;
+	case 3:
+		imm = trace_get16(state);
+		snprintf(bytes, sizeof(bytes), "%02X %02X %02X", opcode, imm & 0xFF, imm >> 8);
+		break;
+	default:
+		snprintf(bytes, sizeof(bytes), "%02X", opcode);
+		break;
+	}
+
+	trace_mnemonic(instruction, imm, mnemonic, sizeof(mnemonic));
+
+	/* Registers are decoded first, the extension byte follows them */
+	if(flags & I8080_TRACE_SP) {
+		state->sp = trace_get16(state);
+	}
+	if(flags & I8080_TRACE_A) {
+		state->a = trace_get8(state);
+	}
+	if(flags & I8080_TRACE_F) {
+		state->f = trace_get8(state);
+	}
+	if(flags & I8080_TRACE_BC) {
+		state->bc = trace_get16(state);
+	}
+	if(flags & I8080_TRACE_DE) {
+		state->de = trace_get16(state);
+	}
+	if(flags & I8080_TRACE_HL) {
+		state->hl = trace_get16(state);
+	}
+
+	if(flags & I8080_TRACE_EXTENDED) {
+		extension = trace_get8(state);
+	}
+
+	if(extension & I8080_TRACE_UPTIME) {
+		state->uptime_cycles = trace_get64(state);
+	}
+
+	printf("%12" PRIu64 " %04X%c %-8s  %-16s", state->uptime_cycles, address,
+		extension & I8080_TRACE_INTERRUPT ? '!' : ':', bytes, mnemonic);
+
+	if(flags & I8080_TRACE_SP) {
+		printf(" sp=%04X", state->sp);
+	}
+	if(flags & I8080_TRACE_A) {
+		printf(" a=%02X", state->a);
+	}
+	if(flags & I8080_TRACE_F) {
+		printf(" f=%02X", state->f);
+	}
+	if(flags & I8080_TRACE_BC) {
+		printf(" bc=%04X", state->bc);
+	}
+	if(flags & I8080_TRACE_DE) {
+		printf(" de=%04X", state->de);
+	}
+	if(flags & I8080_TRACE_HL) {
+		printf(" hl=%04X", state->hl);
+	}
+
+	if(extension & I8080_TRACE_STORES) {
+		const unsigned count = trace_get8(state);
+
+		for(unsigned i = 0; i < count; i++) {
+			const uint16_t destination = trace_get16(state);
+
+			printf(" [%04X]=%02X", destination, trace_get8(state));
+		}
+	}
+
+	putchar('\n');
+
+	if(instruction->nojump == 0 || extension & I8080_TRACE_TAKEN) {
+		cycles = instruction->onjump;
+	} else {
+		cycles = instruction->nojump;
+	}
+
+	state->address = extension & I8080_TRACE_INTERRUPT ? address : address + instruction->length;
+	state->uptime_cycles += cycles;
+
+	return true;
+}
+
+int
+main(int argc, char **argv) {
+	struct trace_state state = { .input = stdin };
+	uint64_t count = 0;
+
+	if(argc > 2) {
+		fprintf(stderr, "usage: %s [trace]\n", *argv);
+		return EXIT_FAILURE;
+	}
+
+	if(argc == 2) {
+		state.input = fopen(argv[1], "rb");
+		if(state.input == NULL) {
+			err(EXIT_FAILURE, "fopen %s", argv[1]);
+		}
+	}
+
+	trace_header(&state);
+
+	while(trace_record(&state)) {
+		count++;
+	}
+
+	if(ferror(state.input)) {
+		err(EXIT_FAILURE, "Unable to read trace");
+	}
+
+	printf("; %" PRIu64 " instructions\n", count);
+
+	fclose(state.input);
+
+	return EXIT_SUCCESS;
+}
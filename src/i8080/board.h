@@ -1,17 +1,26 @@
 #ifndef I8080_BOARD_H
 #define I8080_BOARD_H
 
+#include <stdio.h>
 #include <stdbool.h>
 
 #include "i8080/cpu.h"
 
+/* A board is run by quantums: poll is called before each quantum, and sync after it.
+ * The cpu runs at most quantum cycles in between, less if it stops or yields.
+ * Setup installs the board's memory map (ROM, mirrors, mmio) through the i8080_cpu_map* functions.
+ * Boards with inputs may record them to a file after setup, or replay a recording instead of reading them, NULL otherwise */
 struct i8080_board {
 	const struct i8080_io *io;
+	uint64_t quantum;
+	uint64_t frame; /* Cycles per displayed frame, 0 for boards without display */
 	void (*setup)(struct i8080_cpu *, const char *);
 	void (*teardown)(struct i8080_cpu *);
 	bool (*isonline)(struct i8080_cpu *);
 	void (*poll)(struct i8080_cpu *);
 	void (*sync)(struct i8080_cpu *);
+	int (*record)(struct i8080_cpu *, FILE *);
+	int (*replay)(struct i8080_cpu *, FILE *);
 };
 
 /* I8080_BOARD_H */
@@ -1,59 +1,624 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
 
 #include "cpm.h"
+#include "cpm_stub.h"
 
 #include "../ram.h"
 
-/* Wizard trick to create an output device simulating some CP/M's BIOS calls
- * until a real CP/M is emulated */
-static const uint8_t cpm_bios[] = {
-	0x76, /* 0x00: HLT */
-	0x00, 0x00, 0x00, 0x00,
-	0xCF, /* 0x05: RST 1 (CALL 0x08)*/
-	0xFF, 0xFF, /* 0x06: Available memory */
-	0xD3, 0x00, /* 0x08: OUT 0x00 */
-	0x33, /* 0x0A: INX SP, we want to return from the procedure which called 0x05, so sp += 2 */
-	0x33, /* 0x0B: INX SP */
-	0xC9, /* 0x0C: RET */
+/* CCP and BDOS of a 64K CP/M 2.2, as loaded from the system tracks, followed by the BIOS */
+#define CPM_BIOS_CCP    0xE400
+#define CPM_BIOS_BDOS   (CPM_BIOS_CCP + 0x0806) /* Entry point */
+#define CPM_BIOS_SYSTEM 0x1600 /* Size of the CCP and BDOS */
+#define CPM_BIOS_BASE   (CPM_BIOS_CCP + CPM_BIOS_SYSTEM)
+
+/* The jump table of the BIOS leads to stubs trapping each function through OUT CPM_BIOS_PORT + function.
+ * The disk parameters of the drives follow the stubs and the directory buffer */
+#define CPM_BIOS_PORT   0x10
+#define CPM_BIOS_STUBS  (CPM_BIOS_BASE + 0x40)
+#define CPM_BIOS_STUB   8
+#define CPM_BIOS_DIRBUF (CPM_BIOS_STUBS + CPM_BIOS_FUNCTIONS * CPM_BIOS_STUB)
+
+#define CPM_MASK_CARRY 0x01
+
+enum cpm_bios_function {
+	CPM_BIOS_BOOT,
+	CPM_BIOS_WBOOT,
+	CPM_BIOS_CONST,
+	CPM_BIOS_CONIN,
+	CPM_BIOS_CONOUT,
+	CPM_BIOS_LIST,
+	CPM_BIOS_PUNCH,
+	CPM_BIOS_READER,
+	CPM_BIOS_HOME,
+	CPM_BIOS_SELDSK,
+	CPM_BIOS_SETTRK,
+	CPM_BIOS_SETSEC,
+	CPM_BIOS_SETDMA,
+	CPM_BIOS_READ,
+	CPM_BIOS_WRITE,
+	CPM_BIOS_LISTST,
+	CPM_BIOS_SECTRAN,
+	CPM_BIOS_FUNCTIONS,
 };
 
+void
+cpm_console_flush(struct cpm_console *console) {
+	const uint8_t *next = console->buffer;
+	size_t left = console->buffered;
+
+	console->buffered = 0;
+
+	if(console->fd == -1) {
+		if(console->captured_size + left > console->captured_capacity) {
+			size_t capacity = console->captured_capacity != 0 ? console->captured_capacity : CPM_CONSOLE_BUFFER;
+			uint8_t *captured;
+
+			while(capacity < console->captured_size + left) {
+				capacity *= 2;
+			}
+
+			captured = realloc(console->captured, capacity);
+			if(captured == NULL) {
+				console->failed = true;
+				return;
+			}
+
+			console->captured = captured;
+			console->captured_capacity = capacity;
+		}
+
+		memcpy(console->captured + console->captured_size, next, left);
+		console->captured_size += left;
+		return;
+	}
+
+	while(left != 0) {
+		const ssize_t writeval = write(console->fd, next, left);
+
+		if(writeval == -1) {
+			if(errno == EINTR) {
+				continue;
+			}
+			console->failed = true;
+			return;
+		}
+
+		next += writeval;
+		left -= writeval;
+	}
+}
+
+static void
+cpm_console_write(struct cpm_console *console, const void *data, size_t size) {
+
+	if(console->buffered + size > CPM_CONSOLE_BUFFER) {
+		cpm_console_flush(console);
+
+		/* Larger than the buffer, passed through it by pieces */
+		while(size > CPM_CONSOLE_BUFFER) {
+			memcpy(console->buffer, data, CPM_CONSOLE_BUFFER);
+			console->buffered = CPM_CONSOLE_BUFFER;
+			cpm_console_flush(console);
+			data = (const uint8_t *)data + CPM_CONSOLE_BUFFER;
+			size -= CPM_CONSOLE_BUFFER;
+		}
+	}
+
+	memcpy(console->buffer + console->buffered, data, size);
+	console->buffered += size;
+
+	if(console->flush == CPM_CONSOLE_FLUSH_LINE && memchr(data, '\n', size) != NULL) {
+		cpm_console_flush(console);
+	}
+}
+
+static void
+cpm_console_put(struct cpm_console *console, uint8_t character) {
+	cpm_console_write(console, &character, 1);
+}
+
+/* Next console input character, CP/M's end of file (^Z) once the input is exhausted */
+static uint8_t
+cpm_console_read(struct cpm_console *console) {
+
+	if(console->input_offset == console->input_size) {
+		return 0x1A;
+	}
+
+	return console->input[console->input_offset++];
+}
+
+/* Next character of the input buffer, then of the source, -1 once both are exhausted */
+static int
+cpm_console_next(struct cpm_console *console) {
+
+	if(console->input_offset != console->input_size) {
+		return console->input[console->input_offset++];
+	}
+
+	if(console->source != NULL) {
+		int c;
+
+		/* Prompts are shown before waiting for an answer */
+		cpm_console_flush(console);
+
+		c = fgetc(console->source);
+
+		if(c != EOF) {
+			return c;
+		}
+	}
+
+	return -1;
+}
+
 static void
 cpm_input(struct i8080_cpu *cpu, uint8_t device) {
 }
 
 static void
 cpm_output(struct i8080_cpu *cpu, uint8_t device) {
+	struct cpm_machine * const machine = cpu->data;
+	struct cpm_console * const console = &machine->console;
+
 	if(device != 0) {
 		return;
 	}
 
 	switch(cpu->registers.c) {
+	case 1: /* Console input, echoed */
+		cpu->registers.a = cpm_console_read(console);
+		cpm_console_put(console, cpu->registers.a);
+		break;
 	case 2:
-		fputc(cpu->registers.e, stdout);
+		cpm_console_put(console, cpu->registers.e);
 		break;
 	case 9: {
 		const uint8_t * const begin = cpu->memory + cpu->registers.pair.d,
 			* const end = cpu->memory + sizeof(cpu->memory);
 		const uint8_t * const strend = memchr(begin, '$', end - begin);
 
-		fwrite(begin, 1, (strend == NULL ? end : strend) - begin, stdout);
+		cpm_console_write(console, begin, (strend == NULL ? end : strend) - begin);
+
+	}	break;
+	case 10: { /* Read console buffer: DE points to the maximum length, followed by the read length and characters */
+		const uint16_t buffer = cpu->registers.pair.d;
+		const uint8_t maximum = cpu->memory[buffer];
+		uint8_t length = 0;
+
+		while(length < maximum && console->input_offset != console->input_size) {
+			const uint8_t character = cpm_console_read(console);
+
+			if(character == '\n') {
+				break;
+			}
+
+			if(character != '\r') {
+				cpu->memory[(uint16_t)(buffer + 2 + length++)] = character;
+				cpm_console_put(console, character);
+			}
+		}
+
+		cpu->memory[(uint16_t)(buffer + 1)] = length;
+		i8080_cpu_invalidate(cpu, buffer, 2 + length);
+		cpm_console_put(console, '\n');
 
 	}	break;
+	case 11: /* Console status */
+		cpu->registers.a = console->input_offset != console->input_size ? 0xFF : 0x00;
+		break;
+	default:
+		cpm_files_call(&machine->files, cpu);
+		break;
+	}
+}
+
+/* File name of a command argument, '*' fills the rest of the name or type with '?' */
+static void
+cpm_board_fcb(uint8_t *fcb, const char *argument, size_t length) {
+	const char * const end = argument + length;
+	unsigned i = 1;
+
+	memset(fcb, 0, 16);
+	memset(fcb + 1, ' ', 11);
+
+	if(length >= 2 && argument[1] == ':') {
+		fcb[0] = toupper(*argument) - 'A' + 1;
+		argument += 2;
+	}
+
+	for(; argument != end && *argument != '.'; argument++) {
+		if(*argument == '*') {
+			while(i < 9) {
+				fcb[i++] = '?';
+			}
+		} else if(i < 9) {
+			fcb[i++] = toupper(*argument);
+		}
+	}
+
+	if(argument != end) {
+		argument++;
+	}
+
+	for(i = 9; argument != end; argument++) {
+		if(*argument == '*') {
+			while(i < 12) {
+				fcb[i++] = '?';
+			}
+		} else if(i < 12) {
+			fcb[i++] = toupper(*argument);
+		}
+	}
+}
+
+/* Default FCBs at 0x5C and 0x6C, and the command tail at 0x80, preceded by its length */
+static void
+cpm_board_command(struct i8080_cpu *cpu, const char *command) {
+	uint8_t * const tail = cpu->memory + 0x80;
+	const char *next;
+	size_t length = 0;
+
+	cpm_board_fcb(cpu->memory + 0x5C, "", 0);
+	cpm_board_fcb(cpu->memory + 0x6C, "", 0);
+
+	command += strspn(command, " \t");
+	next = command;
+	for(unsigned argument = 0; argument < 2; argument++) {
+		const size_t size = strcspn(next, " \t");
+
+		if(size == 0) {
+			break;
+		}
+
+		cpm_board_fcb(cpu->memory + 0x5C + argument * 0x10, next, size);
+		next += size;
+		next += strspn(next, " \t");
+	}
+
+	/* The CCP keeps the space separating the command from its tail */
+	if(*command != '\0') {
+		tail[1 + length++] = ' ';
+	}
+
+	for(; *command != '\0' && length < 126; command++) {
+		tail[1 + length++] = toupper(*command);
+	}
+
+	tail[0] = length;
+	tail[1 + length] = '\0';
+}
+
+/* Machine of a cpu set up without one, each cpu has its own console and files.
+ * Output to stdout, shown after each quantum on terminals. The BIOS reads input from stdin */
+static struct cpm_machine *
+cpm_board_standard(struct i8080_cpu *cpu, bool bios) {
+	struct cpm_machine * const machine = malloc(sizeof(*machine));
+
+	if(machine == NULL) {
+		err(EXIT_FAILURE, "malloc");
+	}
+
+	*machine = (struct cpm_machine) {
+		.console = {
+			.fd = STDOUT_FILENO,
+			.flush = isatty(STDOUT_FILENO) ? CPM_CONSOLE_FLUSH_SYNC : CPM_CONSOLE_FLUSH_FULL,
+			.source = bios ? stdin : NULL,
+		},
+		.standard = true,
+	};
+
+	cpu->data = machine;
+
+	return machine;
+}
+
+static void
+cpm_board_release(struct i8080_cpu *cpu, struct cpm_machine *machine) {
+
+	if(machine->standard) {
+		free(machine);
+		cpu->data = NULL;
+	}
+}
+
+/* Output is flushed once the cpu halts, or after each quantum if asked to */
+static void
+cpm_console_sync(struct i8080_cpu *cpu, struct cpm_console *console) {
+
+	if(cpu->stopped || console->flush == CPM_CONSOLE_FLUSH_SYNC) {
+		cpm_console_flush(console);
 	}
 }
 
 static void
 cpm_board_setup(struct i8080_cpu *cpu, const char *filename) {
+	struct cpm_machine *machine = cpu->data;
+
+	if(machine == NULL) {
+		machine = cpm_board_standard(cpu, false);
+	}
+
+	if(cpm_files_setup(&machine->files) != 0) {
+		err(EXIT_FAILURE, "open %s", machine->files.directory != NULL ? machine->files.directory : ".");
+	}
 
-	memcpy(cpu->memory, cpm_bios, sizeof(cpm_bios));
+	memcpy(cpu->memory, cpm_stub, sizeof(cpm_stub));
 	i8080_ram_load_file(cpu, filename, 0x100);
+	cpm_board_command(cpu, machine->command != NULL ? machine->command : "");
 
 	cpu->pc = 0x100;
 }
 
 static void
 cpm_board_teardown(struct i8080_cpu *cpu) {
+	struct cpm_machine * const machine = cpu->data;
+
+	cpm_files_teardown(&machine->files);
+	cpm_console_flush(&machine->console);
+	cpm_board_release(cpu, machine);
+}
+
+/* Loads the CCP and BDOS from the sectors following the boot sector of drive A,
+ * in physical order, and points page zero at the warm boot entry and the BDOS */
+static void
+cpm_bios_boot(struct i8080_cpu *cpu, struct cpm_bios *bios) {
+	const struct cpm_disk * const disk = bios->disks;
+
+	for(unsigned i = 0; i < CPM_BIOS_SYSTEM / CPM_DISK_SECTOR_SIZE; i++) {
+		const unsigned sector = i + 1;
+
+		cpm_disk_read(disk, cpu, sector / disk->format.sectors, sector % disk->format.sectors + 1,
+			CPM_BIOS_CCP + i * CPM_DISK_SECTOR_SIZE);
+	}
+
+	cpu->memory[0x00] = 0xC3; /* JMP WBOOT */
+	cpu->memory[0x01] = (CPM_BIOS_BASE + 3) & 0xFF;
+	cpu->memory[0x02] = (CPM_BIOS_BASE + 3) >> 8;
+	cpu->memory[0x05] = 0xC3; /* JMP BDOS */
+	cpu->memory[0x06] = CPM_BIOS_BDOS & 0xFF;
+	cpu->memory[0x07] = CPM_BIOS_BDOS >> 8;
+	i8080_cpu_invalidate(cpu, 0x0000, 0x08);
+
+	bios->dma = 0x0080;
+}
+
+/* Jump table, stubs, and for each drive its DPB, allocation vector and DPH. No check vector is needed
+ * as images never change, and sectors are translated by SECTRAN itself, so DPHs have no translation table */
+static void
+cpm_bios_install(struct i8080_cpu *cpu, struct cpm_bios *bios) {
+	uint8_t * const memory = cpu->memory;
+	uint32_t next = CPM_BIOS_DIRBUF + CPM_DISK_SECTOR_SIZE;
+
+	for(unsigned function = 0; function < CPM_BIOS_FUNCTIONS; function++) {
+		const uint16_t entry = CPM_BIOS_BASE + function * 3, stub = CPM_BIOS_STUBS + function * CPM_BIOS_STUB;
+
+		memory[entry] = 0xC3; /* JMP stub */
+		memory[entry + 1] = stub & 0xFF;
+		memory[entry + 2] = stub >> 8;
+
+		memory[stub] = 0xD3; /* OUT port */
+		memory[stub + 1] = CPM_BIOS_PORT + function;
+
+		switch(function) {
+		case CPM_BIOS_BOOT:
+		case CPM_BIOS_WBOOT:
+			memory[stub + 2] = 0xC3; /* JMP CCP */
+			memory[stub + 3] = CPM_BIOS_CCP & 0xFF;
+			memory[stub + 4] = CPM_BIOS_CCP >> 8;
+			break;
+		case CPM_BIOS_CONIN: /* Carry is set once the input is exhausted */
+			memory[stub + 2] = 0xD0; /* RNC */
+			memory[stub + 3] = 0x76; /* HLT */
+			break;
+		default:
+			memory[stub + 2] = 0xC9; /* RET */
+			break;
+		}
+	}
+
+	for(unsigned drive = 0; drive < bios->count; drive++) {
+		const struct cpm_disk_parameters * const parameters = &bios->disks[drive].parameters;
+		const uint16_t dpb = next, alv = dpb + 15, dph = alv + parameters->dsm / 8 + 1;
+		const uint8_t block[] = {
+			parameters->spt & 0xFF, parameters->spt >> 8,
+			parameters->bsh, parameters->blm, parameters->exm,
+			parameters->dsm & 0xFF, parameters->dsm >> 8,
+			parameters->drm & 0xFF, parameters->drm >> 8,
+			parameters->al0, parameters->al1,
+			parameters->cks & 0xFF, parameters->cks >> 8,
+			parameters->off & 0xFF, parameters->off >> 8,
+		}, header[] = {
+			0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, /* XLT and BDOS scratch */
+			CPM_BIOS_DIRBUF & 0xFF, CPM_BIOS_DIRBUF >> 8,
+			dpb & 0xFF, dpb >> 8,
+			0x00, 0x00, /* CSV */
+			alv & 0xFF, alv >> 8,
+		};
+
+		next += sizeof(block) + parameters->dsm / 8 + 1 + sizeof(header);
+		if(next > I8080_MEMORY_SIZE) {
+			errx(EXIT_FAILURE, "Disk parameters of drive %c do not fit in memory", 'A' + drive);
+		}
+
+		memcpy(memory + dpb, block, sizeof(block));
+		memset(memory + alv, 0, parameters->dsm / 8 + 1);
+		memcpy(memory + dph, header, sizeof(header));
+		bios->dph[drive] = dph;
+	}
+
+	i8080_cpu_invalidate(cpu, CPM_BIOS_BASE, next - CPM_BIOS_BASE);
+}
+
+static void
+cpm_bios_output(struct i8080_cpu *cpu, uint8_t device) {
+	struct cpm_machine * const machine = cpu->data;
+	struct cpm_bios * const bios = &machine->bios;
+
+	if(device < CPM_BIOS_PORT || device >= CPM_BIOS_PORT + CPM_BIOS_FUNCTIONS) {
+		return;
+	}
+
+	switch(device - CPM_BIOS_PORT) {
+	case CPM_BIOS_BOOT:
+		cpu->memory[0x03] = 0x00; /* IOBYTE */
+		cpu->memory[0x04] = 0x00; /* Current drive and user */
+		/* fallthrough */
+	case CPM_BIOS_WBOOT:
+		cpm_bios_boot(cpu, bios);
+		cpu->registers.c = cpu->memory[0x04];
+		break;
+	case CPM_BIOS_CONST:
+		cpu->registers.a = machine->console.input_offset != machine->console.input_size ? 0xFF : 0x00;
+		break;
+	case CPM_BIOS_CONIN: {
+		const int c = cpm_console_next(&machine->console);
+
+		if(c == -1) {
+			cpu->registers.a = 0x1A;
+			cpu->registers.f |= CPM_MASK_CARRY;
+		} else {
+			cpu->registers.a = c != '\n' ? c : '\r';
+			cpu->registers.f &= ~CPM_MASK_CARRY;
+		}
+	}	break;
+	case CPM_BIOS_CONOUT:
+		cpm_console_put(&machine->console, cpu->registers.c);
+		break;
+	case CPM_BIOS_LIST:
+	case CPM_BIOS_PUNCH: /* No printer nor punch is attached, their output is discarded and LISTST always reports ready */
+		break;
+	case CPM_BIOS_READER: /* Nor any reader, which is always at the end of its file */
+		cpu->registers.a = 0x1A;
+		break;
+	case CPM_BIOS_HOME:
+		bios->track = 0;
+		break;
+	case CPM_BIOS_SELDSK:
+		/* Bit 0 of E is clear on the first selection of a drive since the last boot, for BIOSes identifying
+		 * the format of the disk inserted then. Formats are given on the command line, so it is ignored */
+		if(cpu->registers.c < bios->count) {
+			bios->drive = cpu->registers.c;
+			cpu->registers.pair.h = bios->dph[bios->drive];
+		} else {
+			cpu->registers.pair.h = 0x0000;
+		}
+		break;
+	case CPM_BIOS_SETTRK:
+		bios->track = cpu->registers.pair.b;
+		break;
+	case CPM_BIOS_SETSEC:
+		bios->sector = cpu->registers.pair.b;
+		break;
+	case CPM_BIOS_SETDMA:
+		bios->dma = cpu->registers.pair.b;
+		break;
+	case CPM_BIOS_READ:
+		cpu->registers.a = cpm_disk_read(bios->disks + bios->drive, cpu, bios->track, bios->sector, bios->dma) == 0 ? 0x00 : 0x01;
+		break;
+	case CPM_BIOS_WRITE:
+		cpu->registers.a = cpm_disk_write(bios->disks + bios->drive, cpu, bios->track, bios->sector, bios->dma) == 0 ? 0x00 : 0x01;
+		break;
+	case CPM_BIOS_LISTST:
+		cpu->registers.a = 0xFF;
+		break;
+	case CPM_BIOS_SECTRAN:
+		cpu->registers.pair.h = cpm_disk_translate(bios->disks + bios->drive, cpu->registers.pair.b);
+		break;
+	}
+}
+
+static void
+cpm_bios_board_setup(struct i8080_cpu *cpu, const char *images) {
+	struct cpm_machine *machine = cpu->data;
+	char * const list = strdup(images);
+	struct cpm_bios *bios;
+	const struct cpm_disk *system;
+	char *image, *state;
+
+	if(list == NULL) {
+		err(EXIT_FAILURE, "strdup");
+	}
+
+	if(machine == NULL) {
+		machine = cpm_board_standard(cpu, true);
+	}
+
+	bios = &machine->bios;
+	*bios = (struct cpm_bios) { };
+
+	for(image = strtok_r(list, ":", &state); image != NULL; image = strtok_r(NULL, ":", &state)) {
+		struct cpm_disk_format format = cpm_disk_format_sssd;
+		char * const custom = strchr(image, '@');
+
+		if(bios->count == CPM_DRIVES) {
+			errx(EXIT_FAILURE, "At most %d drives are supported", CPM_DRIVES);
+		}
+
+		if(custom != NULL) {
+			*custom = '\0';
+			if(cpm_disk_format_parse(&format, custom + 1) != 0) {
+				errx(EXIT_FAILURE, "Invalid disk format %s", custom + 1);
+			}
+		}
+
+		if(cpm_disk_open(bios->disks + bios->count, image, &format) != 0) {
+			err(EXIT_FAILURE, "Unable to map disk image %s", image);
+		}
+
+		bios->count++;
+	}
+
+	free(list);
+
+	if(bios->count == 0) {
+		errx(EXIT_FAILURE, "No disk image to boot from");
+	}
+
+	system = bios->disks;
+	if((size_t)system->format.reserved * system->format.sectors * CPM_DISK_SECTOR_SIZE < CPM_DISK_SECTOR_SIZE + CPM_BIOS_SYSTEM
+		|| system->size < CPM_DISK_SECTOR_SIZE + CPM_BIOS_SYSTEM) {
+		errx(EXIT_FAILURE, "No CP/M system on the system tracks of drive A");
+	}
+
+	cpm_bios_install(cpu, bios);
+
+	cpu->memory[0x03] = 0x00;
+	cpu->memory[0x04] = 0x00;
+	cpm_bios_boot(cpu, bios);
+
+	cpu->registers.c = 0x00;
+	cpu->pc = CPM_BIOS_CCP;
+}
+
+static void
+cpm_bios_board_teardown(struct i8080_cpu *cpu) {
+	struct cpm_machine * const machine = cpu->data;
+
+	for(unsigned drive = 0; drive < machine->bios.count; drive++) {
+		cpm_disk_close(machine->bios.disks + drive);
+	}
+
+	cpm_console_flush(&machine->console);
+	cpm_board_release(cpu, machine);
+}
+
+/* Sectors written during the quantum start being written back */
+static void
+cpm_bios_board_sync(struct i8080_cpu *cpu) {
+	struct cpm_machine * const machine = cpu->data;
+
+	for(unsigned drive = 0; drive < machine->bios.count; drive++) {
+		cpm_disk_sync(machine->bios.disks + drive, false);
+	}
+
+	cpm_console_sync(cpu, &machine->console);
 }
 
 static bool
@@ -67,6 +632,9 @@ cpm_board_poll(struct i8080_cpu *cpu) {
 
 static void
 cpm_board_sync(struct i8080_cpu *cpu) {
+	struct cpm_machine * const machine = cpu->data;
+
+	cpm_console_sync(cpu, &machine->console);
 }
 
 static const struct i8080_io cpm_io = {
@@ -75,6 +643,7 @@ static const struct i8080_io cpm_io = {
 
 const struct i8080_board cpm_board = {
 	.io = &cpm_io,
+	.quantum = 1 << 20,
 	.setup = cpm_board_setup,
 	.teardown = cpm_board_teardown,
 	.isonline = cpm_board_isonline,
@@ -82,3 +651,17 @@ const struct i8080_board cpm_board = {
 	.sync = cpm_board_sync,
 };
 
+static const struct i8080_io cpm_bios_io = {
+	.input = cpm_input, .output = cpm_bios_output,
+};
+
+const struct i8080_board cpm_bios_board = {
+	.io = &cpm_bios_io,
+	.quantum = 1 << 20,
+	.setup = cpm_bios_board_setup,
+	.teardown = cpm_bios_board_teardown,
+	.isonline = cpm_board_isonline,
+	.poll = cpm_board_poll,
+	.sync = cpm_bios_board_sync,
+};
+
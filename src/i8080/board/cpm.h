@@ -1,9 +1,72 @@
 #ifndef I8080_BOARD_CPM_H
 #define I8080_BOARD_CPM_H
 
+#include <stdio.h>
+
 #include "../board.h"
 
+#include "cpm_files.h"
+#include "cpm_disk.h"
+
+#define CPM_DRIVES 4
+
+#define CPM_CONSOLE_BUFFER 0x10000
+
+/* When console output is written to its target, besides when the buffer is full, when the cpu halts,
+ * before reading the input source and on teardown */
+enum cpm_console_flush {
+	CPM_CONSOLE_FLUSH_FULL, /* Never otherwise */
+	CPM_CONSOLE_FLUSH_SYNC, /* After each quantum run by the board, for terminals */
+	CPM_CONSOLE_FLUSH_LINE, /* At each line feed */
+};
+
+/* Console of a CP/M machine. Output is buffered, then written to the file descriptor (file, pipe, terminal),
+ * or appended to the captured buffer if it is -1, which is then the caller's to free.
+ * Input is read from the input buffer, then by the BIOS from the source stream if any */
+struct cpm_console {
+	int fd;
+	enum cpm_console_flush flush;
+	bool failed; /* Some output could not be written */
+	uint8_t *captured;
+	size_t captured_size, captured_capacity;
+	FILE *source;
+	const uint8_t *input;
+	size_t input_size, input_offset;
+	size_t buffered;
+	uint8_t buffer[CPM_CONSOLE_BUFFER];
+};
+
+/* Disk state of the BIOS of a CP/M 2.2 machine, the drives are disk images */
+struct cpm_bios {
+	struct cpm_disk disks[CPM_DRIVES];
+	unsigned count;
+	uint16_t dph[CPM_DRIVES]; /* Address of the disk parameter header of each drive */
+	uint16_t track, sector, dma;
+	uint8_t drive;
+};
+
+/* CP/M machine, attached through the cpu's data before setup. The command tail is parsed into the default FCBs,
+ * as the CCP would before running the program. Without a machine, console output goes to stdout,
+ * input is at end of file (stdin for the BIOS board), files are in the current directory and the command tail is empty */
+struct cpm_machine {
+	struct cpm_console console;
+	struct cpm_files files;
+	struct cpm_bios bios;
+	const char *command;
+	/* Allocated by the setup of a cpu set up without a machine, freed by its teardown */
+	bool standard;
+};
+
+void
+cpm_console_flush(struct cpm_console *console);
+
+/* Runs a COM file, BDOS functions are run by the host */
 extern const struct i8080_board cpm_board;
 
+/* Boots a 64K CP/M 2.2 from the system tracks of drive A, only the BIOS is run by the host.
+ * Drives are images separated by ':', each one with an optional custom format after '@'
+ * (see cpm_disk_format_parse), standard 8" SSSD otherwise */
+extern const struct i8080_board cpm_bios_board;
+
 /* I8080_BOARD_CPM_H */
 #endif
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cpm_disk.h"
+
+const struct cpm_disk_format cpm_disk_format_sssd = {
+	.sectors = 26, .tracks = 77, .block = 1024, .entries = 64, .reserved = 2, .skew = 6,
+};
+
+/* Derives the DPB of a format, fails if CP/M 2.2 cannot describe it */
+static int
+cpm_disk_parameters(struct cpm_disk_parameters *parameters, const struct cpm_disk_format *format) {
+	const unsigned records = format->block / CPM_DISK_SECTOR_SIZE,
+		directory = (format->entries * 32 + format->block - 1) / format->block;
+	unsigned long blocks;
+	unsigned bsh = 0;
+
+	if(format->sectors == 0 || format->sectors > UINT16_MAX || format->tracks <= format->reserved || format->reserved > UINT16_MAX
+		|| format->block < 1024 || format->block > 16384 || (format->block & (format->block - 1)) != 0
+		|| format->entries == 0 || directory > 16) {
+		return -1;
+	}
+
+	blocks = (unsigned long)(format->tracks - format->reserved) * format->sectors / records;
+	if(blocks <= directory || blocks > 0x10000 || (blocks > 256 && format->block == 1024)) {
+		return -1;
+	}
+
+	while(1u << bsh < records) {
+		bsh++;
+	}
+
+	parameters->spt = format->sectors;
+	parameters->bsh = bsh;
+	parameters->blm = records - 1;
+	parameters->exm = blocks > 256 ? format->block / 2048 - 1 : format->block / 1024 - 1;
+	parameters->dsm = blocks - 1;
+	parameters->drm = format->entries - 1;
+	/* Blocks of the directory, from the first one */
+	parameters->al0 = 0xFFFF << (16 - directory) >> 8;
+	parameters->al1 = 0xFFFF << (16 - directory);
+	parameters->cks = 0; /* Images are never changed under the cpu's feet */
+	parameters->off = format->reserved;
+
+	return 0;
+}
+
+/* Each logical sector is skew physical sectors after the previous one, or the next free one */
+static int
+cpm_disk_skew(uint8_t *translate, const struct cpm_disk_format *format) {
+	bool used[CPM_DISK_TRANSLATE] = { false };
+	unsigned next = 0;
+
+	if(format->skew == 0) {
+		return 0;
+	}
+
+	if(format->sectors > CPM_DISK_TRANSLATE || format->skew >= format->sectors) {
+		return -1;
+	}
+
+	for(unsigned sector = 0; sector < format->sectors; sector++) {
+		while(used[next]) {
+			next = (next + 1) % format->sectors;
+		}
+
+		translate[sector] = next + 1;
+		used[next] = true;
+		next = (next + format->skew) % format->sectors;
+	}
+
+	return 0;
+}
+
+int
+cpm_disk_format_parse(struct cpm_disk_format *format, const char *string) {
+	int end = 0;
+
+	if(sscanf(string, "%u,%u,%u,%u,%u,%u%n", &format->sectors, &format->tracks, &format->block,
+		&format->entries, &format->reserved, &format->skew, &end) != 6 || string[end] != '\0') {
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+cpm_disk_open(struct cpm_disk *disk, const char *path, const struct cpm_disk_format *format) {
+	struct stat st;
+
+	*disk = (struct cpm_disk) { .format = *format, .fd = -1 };
+
+	if(cpm_disk_parameters(&disk->parameters, format) != 0 || cpm_disk_skew(disk->translate, format) != 0) {
+		return -1;
+	}
+
+	disk->fd = open(path, O_RDWR);
+	if(disk->fd == -1) {
+		disk->fd = open(path, O_RDONLY);
+		disk->readonly = true;
+	}
+
+	if(disk->fd == -1 || fstat(disk->fd, &st) != 0 || st.st_size == 0) {
+		goto cpm_disk_open_err0;
+	}
+
+	disk->size = st.st_size;
+	disk->image = mmap(NULL, disk->size, disk->readonly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, disk->fd, 0);
+	if(disk->image == MAP_FAILED) {
+		goto cpm_disk_open_err0;
+	}
+
+	return 0;
+cpm_disk_open_err0:
+	if(disk->fd != -1) {
+		close(disk->fd);
+	}
+	disk->fd = -1;
+	disk->image = NULL;
+	return -1;
+}
+
+void
+cpm_disk_close(struct cpm_disk *disk) {
+
+	if(disk->image == NULL) {
+		return;
+	}
+
+	cpm_disk_sync(disk, true);
+	munmap(disk->image, disk->size);
+	close(disk->fd);
+
+	disk->image = NULL;
+	disk->fd = -1;
+}
+
+uint16_t
+cpm_disk_translate(const struct cpm_disk *disk, uint16_t sector) {
+
+	if(disk->format.skew == 0 || sector >= disk->format.sectors) {
+		return sector + 1;
+	}
+
+	return disk->translate[sector];
+}
+
+/* Offset of a sector in the image, fails outside of it */
+static int
+cpm_disk_offset(const struct cpm_disk *disk, uint16_t track, uint16_t sector, size_t *offset) {
+
+	if(track >= disk->format.tracks || sector == 0 || sector > disk->format.sectors) {
+		return -1;
+	}
+
+	*offset = ((size_t)track * disk->format.sectors + sector - 1) * CPM_DISK_SECTOR_SIZE;
+
+	return *offset + CPM_DISK_SECTOR_SIZE <= disk->size ? 0 : -1;
+}
+
+int
+cpm_disk_read(const struct cpm_disk *disk, struct i8080_cpu *cpu, uint16_t track, uint16_t sector, uint16_t address) {
+	const size_t first = I8080_MEMORY_SIZE - address < CPM_DISK_SECTOR_SIZE ? I8080_MEMORY_SIZE - address : CPM_DISK_SECTOR_SIZE;
+	size_t offset;
+
+	if(cpm_disk_offset(disk, track, sector, &offset) != 0) {
+		return -1;
+	}
+
+	/* The DMA buffer may wrap around the address space */
+	memcpy(cpu->memory + address, disk->image + offset, first);
+	i8080_cpu_invalidate(cpu, address, first);
+	if(first != CPM_DISK_SECTOR_SIZE) {
+		memcpy(cpu->memory, disk->image + offset + first, CPM_DISK_SECTOR_SIZE - first);
+		i8080_cpu_invalidate(cpu, 0, CPM_DISK_SECTOR_SIZE - first);
+	}
+
+	return 0;
+}
+
+int
+cpm_disk_write(struct cpm_disk *disk, const struct i8080_cpu *cpu, uint16_t track, uint16_t sector, uint16_t address) {
+	const size_t first = I8080_MEMORY_SIZE - address < CPM_DISK_SECTOR_SIZE ? I8080_MEMORY_SIZE - address : CPM_DISK_SECTOR_SIZE;
+	size_t offset;
+
+	if(disk->readonly || cpm_disk_offset(disk, track, sector, &offset) != 0) {
+		return -1;
+	}
+
+	memcpy(disk->image + offset, cpu->memory + address, first);
+	memcpy(disk->image + offset + first, cpu->memory, CPM_DISK_SECTOR_SIZE - first);
+	disk->dirty = true;
+
+	return 0;
+}
+
+int
+cpm_disk_sync(struct cpm_disk *disk, bool wait) {
+
+	if(!disk->dirty) {
+		return 0;
+	}
+
+	disk->dirty = false;
+
+	return msync(disk->image, disk->size, wait ? MS_SYNC : MS_ASYNC);
+}
@@ -0,0 +1,75 @@
+#ifndef I8080_BOARD_CPM_DISK_H
+#define I8080_BOARD_CPM_DISK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "i8080/cpu.h"
+
+#define CPM_DISK_SECTOR_SIZE 128
+#define CPM_DISK_TRANSLATE   256 /* Sectors per track of skewed formats, at most */
+
+/* Geometry of a disk, from which its DPB is derived */
+struct cpm_disk_format {
+	unsigned sectors; /* Per track */
+	unsigned tracks;
+	unsigned block; /* Allocation block size in bytes, 1024 to 16384 */
+	unsigned entries; /* Directory entries */
+	unsigned reserved; /* System tracks */
+	unsigned skew; /* Of logical sectors on a track, 0 for none */
+};
+
+/* Standard 8" single sided single density disk: 77 tracks of 26 sectors, 2 system tracks, 64 directory entries */
+extern const struct cpm_disk_format cpm_disk_format_sssd;
+
+/* CP/M 2.2 disk parameter block, as read by the BDOS */
+struct cpm_disk_parameters {
+	uint16_t spt;
+	uint8_t bsh, blm, exm;
+	uint16_t dsm, drm;
+	uint8_t al0, al1;
+	uint16_t cks, off;
+};
+
+/* Disk image mapped in host memory, sectors are stored in physical order, track after track.
+ * Sectors are transferred with memcpy, and written back by the kernel from the shared mapping,
+ * msync only tells it to start once sectors were written */
+struct cpm_disk {
+	struct cpm_disk_format format;
+	struct cpm_disk_parameters parameters;
+	uint8_t translate[CPM_DISK_TRANSLATE]; /* Physical sector of each logical one, from 1 */
+	int fd;
+	uint8_t *image;
+	size_t size;
+	bool readonly, dirty;
+};
+
+/* Parses "<sectors>,<tracks>,<block>,<entries>,<reserved>,<skew>" */
+int
+cpm_disk_format_parse(struct cpm_disk_format *format, const char *string);
+
+/* Maps an image of the given format, read-only if it cannot be written */
+int
+cpm_disk_open(struct cpm_disk *disk, const char *path, const struct cpm_disk_format *format);
+
+/* Writes back and unmaps */
+void
+cpm_disk_close(struct cpm_disk *disk);
+
+uint16_t
+cpm_disk_translate(const struct cpm_disk *disk, uint16_t sector);
+
+/* Transfers the physical sector of a track from or to the cpu's memory, sectors are numbered from 1 */
+int
+cpm_disk_read(const struct cpm_disk *disk, struct i8080_cpu *cpu, uint16_t track, uint16_t sector, uint16_t address);
+
+int
+cpm_disk_write(struct cpm_disk *disk, const struct i8080_cpu *cpu, uint16_t track, uint16_t sector, uint16_t address);
+
+/* Starts writing back the sectors written since the last sync, waits for it if wait */
+int
+cpm_disk_sync(struct cpm_disk *disk, bool wait);
+
+/* I8080_BOARD_CPM_DISK_H */
+#endif
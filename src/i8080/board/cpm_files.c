@@ -0,0 +1,869 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "cpm_files.h"
+
+/* FCB layout */
+#define CPM_FCB_DRIVE 0
+#define CPM_FCB_NAME  1
+#define CPM_FCB_EX    12
+#define CPM_FCB_S2    14
+#define CPM_FCB_RC    15
+#define CPM_FCB_D0    16 /* Open file binding, one plus its index */
+#define CPM_FCB_CR    32
+#define CPM_FCB_R0    33
+#define CPM_FCB_SIZE  36
+
+#define CPM_EXTENT_RECORDS 128
+#define CPM_DIRECTORY_ENTRY_SIZE 32
+
+/* Return codes of the read and write functions */
+#define CPM_STATUS_OK         0
+#define CPM_STATUS_EOF        1 /* Reading unwritten data */
+#define CPM_STATUS_FULL       2
+#define CPM_STATUS_OUT_RANGE  6
+#define CPM_STATUS_NOT_FOUND  0xFF
+
+/* Host memory of the cpu wraps around */
+static void
+cpm_files_load(const struct i8080_cpu *cpu, uint16_t address, uint8_t *data, size_t size) {
+
+	for(size_t i = 0; i < size; i++) {
+		data[i] = cpu->memory[(uint16_t)(address + i)];
+	}
+}
+
+static void
+cpm_files_store(struct i8080_cpu *cpu, uint16_t address, const uint8_t *data, size_t size) {
+
+	for(size_t i = 0; i < size; i++) {
+		cpu->memory[(uint16_t)(address + i)] = data[i];
+	}
+
+	if(address + size > I8080_MEMORY_SIZE) {
+		i8080_cpu_invalidate(cpu, address, I8080_MEMORY_SIZE - address);
+		i8080_cpu_invalidate(cpu, 0, address + size - I8080_MEMORY_SIZE);
+	} else {
+		i8080_cpu_invalidate(cpu, address, size);
+	}
+}
+
+/* Name of a FCB in upper case, without its attributes */
+static void
+cpm_fcb_name(const uint8_t *fcb, uint8_t *name) {
+
+	for(unsigned i = 0; i < CPM_NAME_SIZE; i++) {
+		name[i] = toupper(fcb[CPM_FCB_NAME + i] & 0x7F);
+	}
+}
+
+static uint32_t
+cpm_fcb_record(const uint8_t *fcb) {
+	return ((fcb[CPM_FCB_S2] & 0x3F) << 12 | (fcb[CPM_FCB_EX] & 0x1F) << 7) + fcb[CPM_FCB_CR];
+}
+
+static uint32_t
+cpm_fcb_random(const uint8_t *fcb) {
+	return fcb[CPM_FCB_R0] | fcb[CPM_FCB_R0 + 1] << 8 | fcb[CPM_FCB_R0 + 2] << 16;
+}
+
+static void
+cpm_fcb_set_random(uint8_t *fcb, uint32_t record) {
+
+	fcb[CPM_FCB_R0] = record;
+	fcb[CPM_FCB_R0 + 1] = record >> 8;
+	fcb[CPM_FCB_R0 + 2] = record >> 16;
+}
+
+/* Moves the sequential position to a record, with the count of records in its extent */
+static void
+cpm_fcb_seek(uint8_t *fcb, uint32_t record, off_t size) {
+	const off_t records = (size + CPM_RECORD_SIZE - 1) / CPM_RECORD_SIZE,
+		extent = record & ~(uint32_t)(CPM_EXTENT_RECORDS - 1);
+
+	fcb[CPM_FCB_CR] = record % CPM_EXTENT_RECORDS;
+	fcb[CPM_FCB_EX] = record >> 7 & 0x1F;
+	fcb[CPM_FCB_S2] = record >> 12;
+
+	if(records <= extent) {
+		fcb[CPM_FCB_RC] = 0;
+	} else if(records - extent >= CPM_EXTENT_RECORDS) {
+		fcb[CPM_FCB_RC] = CPM_EXTENT_RECORDS;
+	} else {
+		fcb[CPM_FCB_RC] = records - extent;
+	}
+}
+
+/* Host names seen are 8.3 names, of characters a CCP could parse */
+static bool
+cpm_files_host_name(const char *host, uint8_t *name) {
+	const char * const dot = strchr(host, '.');
+	const size_t length = dot != NULL ? (size_t)(dot - host) : strlen(host),
+		type = dot != NULL ? strlen(dot + 1) : 0;
+
+	if(length == 0 || length > 8 || type > 3) {
+		return false;
+	}
+
+	memset(name, ' ', CPM_NAME_SIZE);
+	for(size_t i = 0; host[i] != '\0'; i++) {
+		const char c = host[i];
+
+		if(i == length) {
+			continue;
+		}
+
+		if(c <= ' ' || c > '~' || strchr("<>.,;:=?*[]|/\\\"", c) != NULL) {
+			return false;
+		}
+
+		name[i < length ? i : i - 1 - length + 8] = toupper(c);
+	}
+
+	return true;
+}
+
+static void
+cpm_files_name_host(const uint8_t *name, char *host) {
+	size_t length = 0;
+
+	for(unsigned i = 0; i < 8 && name[i] != ' '; i++) {
+		host[length++] = name[i];
+	}
+
+	if(name[8] != ' ') {
+		host[length++] = '.';
+		for(unsigned i = 8; i < CPM_NAME_SIZE && name[i] != ' '; i++) {
+			host[length++] = name[i];
+		}
+	}
+
+	host[length] = '\0';
+}
+
+static bool
+cpm_files_name_match(const uint8_t *pattern, const uint8_t *name) {
+
+	for(unsigned i = 0; i < CPM_NAME_SIZE; i++) {
+		if(pattern[i] != '?' && pattern[i] != name[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static int
+cpm_files_entry_compare(const void *lhs, const void *rhs) {
+	const struct cpm_files_entry * const left = lhs, * const right = rhs;
+
+	return memcmp(left->name, right->name, CPM_NAME_SIZE);
+}
+
+/* Lists the host files matching a pattern, '?' matching any character */
+static int
+cpm_files_list(struct cpm_files *files, struct cpm_files_list *list, const uint8_t *pattern) {
+	const int fd = dup(files->dirfd);
+	struct dirent *entry;
+	DIR *dir;
+
+	list->count = 0;
+	list->next = 0;
+
+	if(fd == -1 || (dir = fdopendir(fd)) == NULL) {
+		if(fd != -1) {
+			close(fd);
+		}
+		return -1;
+	}
+
+	/* The duplicate shares the offset of the last listing */
+	rewinddir(dir);
+
+	while(entry = readdir(dir), entry != NULL) {
+		struct cpm_files_entry current;
+		struct stat st;
+
+		if(!cpm_files_host_name(entry->d_name, current.name) || !cpm_files_name_match(pattern, current.name)
+			|| fstatat(files->dirfd, entry->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+			continue;
+		}
+
+		if(list->count == list->capacity) {
+			const size_t capacity = list->capacity != 0 ? list->capacity * 2 : 64;
+			struct cpm_files_entry * const entries = realloc(list->entries, capacity * sizeof(*entries));
+
+			if(entries == NULL) {
+				closedir(dir);
+				return -1;
+			}
+
+			list->entries = entries;
+			list->capacity = capacity;
+		}
+
+		strcpy(current.host, entry->d_name);
+		current.size = st.st_size;
+		list->entries[list->count++] = current;
+	}
+
+	closedir(dir);
+
+	qsort(list->entries, list->count, sizeof(*list->entries), cpm_files_entry_compare);
+
+	return 0;
+}
+
+static int
+cpm_file_flush(struct cpm_file *file) {
+
+	while(file->dirty_begin != file->dirty_end) {
+		const ssize_t writeval = pwrite(file->fd, file->buffer + file->dirty_begin,
+			file->dirty_end - file->dirty_begin, file->offset + file->dirty_begin);
+
+		if(writeval <= 0) {
+			return -1;
+		}
+
+		file->dirty_begin += writeval;
+	}
+
+	file->dirty_begin = 0;
+	file->dirty_end = 0;
+
+	return 0;
+}
+
+/* Moves the buffer over the part of the file holding a position, reading it ahead */
+static int
+cpm_file_seek(struct cpm_file *file, off_t position) {
+	const off_t offset = position - position % CPM_FILES_BUFFER;
+	ssize_t readval = 0;
+
+	if(file->offset == offset) {
+		return 0;
+	}
+
+	if(cpm_file_flush(file) != 0) {
+		return -1;
+	}
+
+	file->offset = offset;
+	file->length = 0;
+
+	while(file->length < CPM_FILES_BUFFER
+		&& (readval = pread(file->fd, file->buffer + file->length, CPM_FILES_BUFFER - file->length, offset + file->length)) > 0) {
+		file->length += readval;
+	}
+
+	if(readval == -1) {
+		file->offset = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Reads a record, the last one of a file is padded with CP/M's end of file (^Z) */
+static int
+cpm_file_read(struct cpm_file *file, off_t position, uint8_t *record) {
+	size_t available;
+
+	if(position >= file->size) {
+		return CPM_STATUS_EOF;
+	}
+
+	if(cpm_file_seek(file, position) != 0) {
+		return CPM_STATUS_EOF;
+	}
+
+	if(file->length <= position - file->offset) {
+		return CPM_STATUS_EOF;
+	}
+
+	available = file->length - (position - file->offset);
+	if(available >= CPM_RECORD_SIZE) {
+		available = CPM_RECORD_SIZE;
+	}
+
+	memcpy(record, file->buffer + (position - file->offset), available);
+	memset(record + available, 0x1A, CPM_RECORD_SIZE - available);
+
+	return CPM_STATUS_OK;
+}
+
+static int
+cpm_file_write(struct cpm_file *file, off_t position, const uint8_t *record) {
+	size_t begin;
+
+	if(cpm_file_seek(file, position) != 0) {
+		return CPM_STATUS_FULL;
+	}
+
+	begin = position - file->offset;
+
+	/* Past the end of file, unwritten records read as zeroes */
+	if(begin > file->length) {
+		memset(file->buffer + file->length, 0, begin - file->length);
+	}
+
+	memcpy(file->buffer + begin, record, CPM_RECORD_SIZE);
+
+	if(file->dirty_begin == file->dirty_end) {
+		file->dirty_begin = begin;
+		file->dirty_end = begin + CPM_RECORD_SIZE;
+	} else {
+		if(begin < file->dirty_begin) {
+			file->dirty_begin = begin;
+		}
+		if(begin + CPM_RECORD_SIZE > file->dirty_end) {
+			file->dirty_end = begin + CPM_RECORD_SIZE;
+		}
+	}
+
+	if(begin + CPM_RECORD_SIZE > file->length) {
+		file->length = begin + CPM_RECORD_SIZE;
+	}
+
+	if(position + CPM_RECORD_SIZE > file->size) {
+		file->size = position + CPM_RECORD_SIZE;
+	}
+
+	return CPM_STATUS_OK;
+}
+
+static int
+cpm_file_close(struct cpm_file *file) {
+	const int flushed = cpm_file_flush(file);
+
+	if(close(file->fd) != 0 || flushed != 0) {
+		file->fd = -1;
+		return -1;
+	}
+
+	file->fd = -1;
+
+	return 0;
+}
+
+static struct cpm_file *
+cpm_files_find(struct cpm_files *files, const uint8_t *name) {
+
+	for(struct cpm_file *file = files->open; file != files->open + CPM_FILES_OPEN; file++) {
+		if(file->fd != -1 && memcmp(file->name, name, CPM_NAME_SIZE) == 0) {
+			return file;
+		}
+	}
+
+	return NULL;
+}
+
+/* Installs a host file in a free slot, closing the least recently used file if there is none */
+static struct cpm_file *
+cpm_files_install(struct cpm_files *files, int fd, const uint8_t *name) {
+	struct cpm_file *file = files->open;
+	struct stat st;
+
+	for(struct cpm_file *current = files->open; current != files->open + CPM_FILES_OPEN; current++) {
+		if(current->fd == -1) {
+			file = current;
+			break;
+		}
+
+		if(current->used < file->used) {
+			file = current;
+		}
+	}
+
+	if(fstat(fd, &st) != 0 || (file->buffer == NULL && (file->buffer = malloc(CPM_FILES_BUFFER)) == NULL)) {
+		close(fd);
+		return NULL;
+	}
+
+	if(file->fd != -1) {
+		cpm_file_close(file);
+	}
+
+	*file = (struct cpm_file) {
+		.fd = fd,
+		.used = files->calls,
+		.size = st.st_size,
+		.offset = -1,
+		.buffer = file->buffer,
+	};
+	memcpy(file->name, name, CPM_NAME_SIZE);
+
+	return file;
+}
+
+static int
+cpm_files_openat(struct cpm_files *files, const char *host, int flags) {
+	int fd = openat(files->dirfd, host, O_RDWR | flags, 0666);
+
+	if(fd == -1 && flags == 0) {
+		fd = openat(files->dirfd, host, O_RDONLY);
+	}
+
+	return fd;
+}
+
+/* Open file of a FCB, opened by name if it is not bound to one */
+static struct cpm_file *
+cpm_files_get(struct cpm_files *files, uint8_t *fcb) {
+	const unsigned binding = fcb[CPM_FCB_D0];
+	uint8_t name[CPM_NAME_SIZE];
+	struct cpm_file *file;
+
+	cpm_fcb_name(fcb, name);
+
+	if(binding != 0 && binding <= CPM_FILES_OPEN && files->open[binding - 1].fd != -1
+		&& memcmp(files->open[binding - 1].name, name, CPM_NAME_SIZE) == 0) {
+		file = files->open + binding - 1;
+	} else if(file = cpm_files_find(files, name), file == NULL) {
+		int fd;
+
+		if(cpm_files_list(files, &files->matches, name) != 0 || files->matches.count == 0
+			|| (fd = cpm_files_openat(files, files->matches.entries->host, 0)) == -1) {
+			return NULL;
+		}
+
+		file = cpm_files_install(files, fd, files->matches.entries->name);
+		if(file == NULL) {
+			return NULL;
+		}
+	}
+
+	file->used = files->calls;
+	fcb[CPM_FCB_D0] = file - files->open + 1;
+
+	return file;
+}
+
+/* Size of a host file, as seen through its open file if any */
+static off_t
+cpm_files_size(struct cpm_files *files, const struct cpm_files_entry *entry) {
+	const struct cpm_file * const file = cpm_files_find(files, entry->name);
+
+	return file != NULL ? file->size : entry->size;
+}
+
+/* Drops the open files of the entries listed, their pending writes are lost unless flushed */
+static int
+cpm_files_drop(struct cpm_files *files, const struct cpm_files_list *list, bool flush) {
+	int status = 0;
+
+	for(size_t i = 0; i < list->count; i++) {
+		struct cpm_file * const file = cpm_files_find(files, list->entries[i].name);
+
+		if(file != NULL) {
+			if(!flush) {
+				file->dirty_begin = file->dirty_end = 0;
+			}
+
+			if(cpm_file_close(file) != 0) {
+				status = -1;
+			}
+		}
+	}
+
+	return status;
+}
+
+static uint16_t
+cpm_files_open(struct cpm_files *files, uint8_t *fcb) {
+	struct cpm_file *file;
+
+	fcb[CPM_FCB_D0] = 0;
+	fcb[CPM_FCB_S2] = 0;
+
+	file = cpm_files_get(files, fcb);
+	if(file == NULL) {
+		return CPM_STATUS_NOT_FOUND;
+	}
+
+	/* Names matched by wildcards are replaced by the one opened, and the extent asked is kept */
+	memcpy(fcb + CPM_FCB_NAME, file->name, CPM_NAME_SIZE);
+	cpm_fcb_seek(fcb, cpm_fcb_record(fcb), file->size);
+
+	return 0;
+}
+
+static uint16_t
+cpm_files_close(struct cpm_files *files, uint8_t *fcb) {
+	uint8_t name[CPM_NAME_SIZE];
+	struct cpm_file *file;
+
+	cpm_fcb_name(fcb, name);
+
+	file = cpm_files_find(files, name);
+	if(file != NULL) {
+		return cpm_file_close(file) == 0 ? 0 : CPM_STATUS_NOT_FOUND;
+	}
+
+	if(cpm_files_list(files, &files->matches, name) != 0 || files->matches.count == 0) {
+		return CPM_STATUS_NOT_FOUND;
+	}
+
+	return 0;
+}
+
+/* Directory entries are returned one per file, describing its last extent */
+static uint16_t
+cpm_files_search_next(struct cpm_files *files, struct i8080_cpu *cpu) {
+	uint8_t directory[CPM_DIRECTORY_ENTRY_SIZE] = { 0 };
+	const struct cpm_files_entry *entry;
+	uint32_t records, last;
+
+	if(files->search.next == files->search.count) {
+		return CPM_STATUS_NOT_FOUND;
+	}
+
+	entry = files->search.entries + files->search.next++;
+	records = (cpm_files_size(files, entry) + CPM_RECORD_SIZE - 1) / CPM_RECORD_SIZE;
+	last = records != 0 ? records - 1 : 0;
+
+	directory[0] = files->user;
+	memcpy(directory + CPM_FCB_NAME, entry->name, CPM_NAME_SIZE);
+	directory[CPM_FCB_EX] = last >> 7 & 0x1F;
+	directory[CPM_FCB_S2] = last >> 12;
+	directory[CPM_FCB_RC] = records - (last & ~(uint32_t)(CPM_EXTENT_RECORDS - 1));
+
+	cpm_files_store(cpu, files->dma, directory, sizeof(directory));
+
+	return 0;
+}
+
+static uint16_t
+cpm_files_search_first(struct cpm_files *files, struct i8080_cpu *cpu, const uint8_t *fcb) {
+	uint8_t pattern[CPM_NAME_SIZE];
+
+	if(fcb[CPM_FCB_DRIVE] == '?') {
+		memset(pattern, '?', sizeof(pattern));
+	} else {
+		cpm_fcb_name(fcb, pattern);
+	}
+
+	if(cpm_files_list(files, &files->search, pattern) != 0) {
+		return CPM_STATUS_NOT_FOUND;
+	}
+
+	return cpm_files_search_next(files, cpu);
+}
+
+static uint16_t
+cpm_files_delete(struct cpm_files *files, const uint8_t *fcb) {
+	uint8_t pattern[CPM_NAME_SIZE];
+	uint16_t status = 0;
+
+	cpm_fcb_name(fcb, pattern);
+
+	if(cpm_files_list(files, &files->matches, pattern) != 0 || files->matches.count == 0) {
+		return CPM_STATUS_NOT_FOUND;
+	}
+
+	cpm_files_drop(files, &files->matches, false);
+
+	for(size_t i = 0; i < files->matches.count; i++) {
+		if(unlinkat(files->dirfd, files->matches.entries[i].host, 0) != 0) {
+			status = CPM_STATUS_NOT_FOUND;
+		}
+	}
+
+	return status;
+}
+
+static uint16_t
+cpm_files_make(struct cpm_files *files, uint8_t *fcb) {
+	uint8_t name[CPM_NAME_SIZE];
+	char host[13];
+	struct cpm_file *file;
+	int fd;
+
+	cpm_fcb_name(fcb, name);
+	if(memchr(name, '?', sizeof(name)) != NULL) {
+		return CPM_STATUS_NOT_FOUND;
+	}
+
+	/* Recreates a file named in another case on the host */
+	if(cpm_files_list(files, &files->matches, name) != 0) {
+		return CPM_STATUS_NOT_FOUND;
+	}
+
+	cpm_files_drop(files, &files->matches, false);
+
+	if(files->matches.count != 0) {
+		strcpy(host, files->matches.entries->host);
+	} else {
+		cpm_files_name_host(name, host);
+	}
+
+	fd = cpm_files_openat(files, host, O_CREAT | O_TRUNC);
+	if(fd == -1) {
+		return CPM_STATUS_NOT_FOUND;
+	}
+
+	file = cpm_files_install(files, fd, name);
+	if(file == NULL) {
+		return CPM_STATUS_NOT_FOUND;
+	}
+
+	fcb[CPM_FCB_D0] = file - files->open + 1;
+	fcb[CPM_FCB_S2] = 0;
+	fcb[CPM_FCB_RC] = 0;
+
+	return 0;
+}
+
+/* The new name is in the second half of the FCB */
+static uint16_t
+cpm_files_rename(struct cpm_files *files, const uint8_t *fcb) {
+	uint8_t name[CPM_NAME_SIZE], renamed[CPM_NAME_SIZE];
+	char host[13];
+
+	cpm_fcb_name(fcb, name);
+	cpm_fcb_name(fcb + CPM_FCB_D0, renamed);
+
+	if(memchr(renamed, '?', sizeof(renamed)) != NULL
+		|| cpm_files_list(files, &files->matches, name) != 0 || files->matches.count == 0) {
+		return CPM_STATUS_NOT_FOUND;
+	}
+
+	if(cpm_files_drop(files, &files->matches, true) != 0) {
+		return CPM_STATUS_NOT_FOUND;
+	}
+
+	cpm_files_name_host(renamed, host);
+
+	return renameat(files->dirfd, files->matches.entries->host, files->dirfd, host) == 0 ? 0 : CPM_STATUS_NOT_FOUND;
+}
+
+static uint16_t
+cpm_files_read(struct cpm_files *files, struct i8080_cpu *cpu, uint8_t *fcb, uint32_t record, bool sequential) {
+	struct cpm_file * const file = cpm_files_get(files, fcb);
+	uint8_t data[CPM_RECORD_SIZE];
+	int status;
+
+	if(file == NULL) {
+		return CPM_STATUS_EOF;
+	}
+
+	status = cpm_file_read(file, (off_t)record * CPM_RECORD_SIZE, data);
+	if(status != CPM_STATUS_OK) {
+		if(!sequential) {
+			cpm_fcb_seek(fcb, record, file->size);
+		}
+		return status;
+	}
+
+	cpm_files_store(cpu, files->dma, data, sizeof(data));
+
+	/* Random reads leave the sequential position on the record read */
+	cpm_fcb_seek(fcb, sequential ? record + 1 : record, file->size);
+
+	return CPM_STATUS_OK;
+}
+
+static uint16_t
+cpm_files_write(struct cpm_files *files, struct i8080_cpu *cpu, uint8_t *fcb, uint32_t record, bool sequential) {
+	struct cpm_file * const file = cpm_files_get(files, fcb);
+	uint8_t data[CPM_RECORD_SIZE];
+	int status;
+
+	if(file == NULL) {
+		return CPM_STATUS_FULL;
+	}
+
+	cpm_files_load(cpu, files->dma, data, sizeof(data));
+
+	status = cpm_file_write(file, (off_t)record * CPM_RECORD_SIZE, data);
+	if(status != CPM_STATUS_OK) {
+		return status;
+	}
+
+	cpm_fcb_seek(fcb, sequential ? record + 1 : record, file->size);
+
+	return CPM_STATUS_OK;
+}
+
+static uint16_t
+cpm_files_attributes(struct cpm_files *files, const uint8_t *fcb) {
+	uint8_t name[CPM_NAME_SIZE];
+
+	cpm_fcb_name(fcb, name);
+
+	if(cpm_files_list(files, &files->matches, name) != 0 || files->matches.count == 0) {
+		return CPM_STATUS_NOT_FOUND;
+	}
+
+	return 0;
+}
+
+static uint16_t
+cpm_files_compute_size(struct cpm_files *files, uint8_t *fcb) {
+	uint8_t name[CPM_NAME_SIZE];
+
+	cpm_fcb_name(fcb, name);
+
+	if(cpm_files_list(files, &files->matches, name) != 0 || files->matches.count == 0) {
+		cpm_fcb_set_random(fcb, 0);
+		return CPM_STATUS_NOT_FOUND;
+	}
+
+	cpm_fcb_set_random(fcb, (cpm_files_size(files, files->matches.entries) + CPM_RECORD_SIZE - 1) / CPM_RECORD_SIZE);
+
+	return 0;
+}
+
+int
+cpm_files_setup(struct cpm_files *files) {
+
+	files->dirfd = open(files->directory != NULL ? files->directory : ".", O_RDONLY | O_DIRECTORY);
+	if(files->dirfd == -1) {
+		return -1;
+	}
+
+	files->dma = 0x0080;
+	files->disk = 0;
+	files->user = 0;
+	files->calls = 0;
+	files->search = (struct cpm_files_list) { };
+	files->matches = (struct cpm_files_list) { };
+
+	for(struct cpm_file *file = files->open; file != files->open + CPM_FILES_OPEN; file++) {
+		*file = (struct cpm_file) { .fd = -1 };
+	}
+
+	return 0;
+}
+
+void
+cpm_files_teardown(struct cpm_files *files) {
+
+	for(struct cpm_file *file = files->open; file != files->open + CPM_FILES_OPEN; file++) {
+		if(file->fd != -1) {
+			cpm_file_close(file);
+		}
+		free(file->buffer);
+		file->buffer = NULL;
+	}
+
+	free(files->search.entries);
+	free(files->matches.entries);
+	files->search = (struct cpm_files_list) { };
+	files->matches = (struct cpm_files_list) { };
+
+	close(files->dirfd);
+	files->dirfd = -1;
+}
+
+void
+cpm_files_call(struct cpm_files *files, struct i8080_cpu *cpu) {
+	const uint16_t parameter = cpu->registers.pair.d;
+	uint8_t fcb[CPM_FCB_SIZE];
+	uint16_t value = 0;
+
+	files->calls++;
+
+	cpm_files_load(cpu, parameter, fcb, sizeof(fcb));
+
+	switch(cpu->registers.c) {
+	case 12: /* Version, CP/M 2.2 */
+		value = 0x0022;
+		break;
+	case 13: /* Reset disk system */
+		files->dma = 0x0080;
+		files->disk = 0;
+		break;
+	case 14: /* Select disk */
+		files->disk = cpu->registers.e & 0x0F;
+		break;
+	case 15:
+		value = cpm_files_open(files, fcb);
+		break;
+	case 16:
+		value = cpm_files_close(files, fcb);
+		break;
+	case 17:
+		value = cpm_files_search_first(files, cpu, fcb);
+		break;
+	case 18:
+		value = cpm_files_search_next(files, cpu);
+		break;
+	case 19:
+		value = cpm_files_delete(files, fcb);
+		break;
+	case 20:
+		value = cpm_files_read(files, cpu, fcb, cpm_fcb_record(fcb), true);
+		break;
+	case 21:
+		value = cpm_files_write(files, cpu, fcb, cpm_fcb_record(fcb), true);
+		break;
+	case 22:
+		value = cpm_files_make(files, fcb);
+		break;
+	case 23:
+		value = cpm_files_rename(files, fcb);
+		break;
+	case 24: /* Login vector, drives seen */
+		value = 1 | 1 << files->disk;
+		break;
+	case 25: /* Current disk */
+		value = files->disk;
+		break;
+	case 26: /* Set DMA address */
+		files->dma = parameter;
+		break;
+	case 28: /* Write protect disk */
+	case 29: /* Read-only vector */
+		break;
+	case 30: /* Set file attributes, which host files do not have */
+		value = cpm_files_attributes(files, fcb);
+		break;
+	case 32: /* Get or set user code */
+		if(cpu->registers.e == 0xFF) {
+			value = files->user;
+		} else {
+			files->user = cpu->registers.e & 0x0F;
+		}
+		break;
+	case 33:
+	case 34:
+	case 40: /* Write random with zero fill, holes of host files read as zeroes */
+		if(fcb[CPM_FCB_R0 + 2] != 0) {
+			value = CPM_STATUS_OUT_RANGE;
+		} else if(cpu->registers.c == 33) {
+			value = cpm_files_read(files, cpu, fcb, cpm_fcb_random(fcb), false);
+		} else {
+			value = cpm_files_write(files, cpu, fcb, cpm_fcb_random(fcb), false);
+		}
+		break;
+	case 35:
+		value = cpm_files_compute_size(files, fcb);
+		break;
+	case 36: /* Set random record */
+		cpm_fcb_set_random(fcb, cpm_fcb_record(fcb));
+		break;
+	default:
+		return;
+	}
+
+	/* Sequential functions may be given FCBs without the random record */
+	switch(cpu->registers.c) {
+	case 15: case 16: case 20: case 21: case 22:
+		cpm_files_store(cpu, parameter, fcb, CPM_FCB_R0);
+		break;
+	case 33: case 34: case 35: case 36: case 40:
+		cpm_files_store(cpu, parameter, fcb, sizeof(fcb));
+		break;
+	}
+
+	/* Values are returned in HL, and A = L, B = H */
+	cpu->registers.pair.h = value;
+	cpu->registers.a = value;
+	cpu->registers.b = value >> 8;
+}
@@ -0,0 +1,68 @@
+#ifndef I8080_BOARD_CPM_FILES_H
+#define I8080_BOARD_CPM_FILES_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "i8080/cpu.h"
+
+#define CPM_FILES_OPEN   16     /* Host files open at once, the least recently used one is closed beyond */
+#define CPM_FILES_BUFFER 0x4000 /* Bytes buffered per open file, the records of a 16K extent */
+
+#define CPM_RECORD_SIZE 128
+#define CPM_NAME_SIZE   11 /* Name and type of a FCB, padded with spaces */
+
+/* Host file opened through a FCB. Records are read ahead and written behind in a buffer
+ * holding the bytes at [offset, offset + length) of the file, the dirty ones are written back
+ * when the buffer moves to another part of the file, or when the file is closed */
+struct cpm_file {
+	int fd; /* -1 when closed */
+	uint8_t name[CPM_NAME_SIZE];
+	uint64_t used; /* Last access, in file function calls */
+	off_t size; /* Including the records written behind */
+	off_t offset;
+	size_t length;
+	size_t dirty_begin, dirty_end;
+	uint8_t *buffer;
+};
+
+struct cpm_files_entry {
+	char host[13]; /* As named on the host, NAME.TYP in any case */
+	uint8_t name[CPM_NAME_SIZE];
+	off_t size;
+};
+
+/* Host files matching a FCB name, sorted by name */
+struct cpm_files_list {
+	struct cpm_files_entry *entries;
+	size_t count, capacity, next;
+};
+
+/* BDOS file functions, trapped and run on the files of a host directory.
+ * Every drive is the same directory, where only regular files named in 8.3 are seen, regardless of case.
+ * FCBs are bound to their open file through their first allocation byte, checked against their name,
+ * so files are reopened by name when a FCB was copied, or its file closed to open another one */
+struct cpm_files {
+	const char *directory; /* The current directory if NULL */
+	int dirfd;
+	uint16_t dma;
+	uint8_t disk, user;
+	uint64_t calls;
+	struct cpm_files_list search, matches;
+	struct cpm_file open[CPM_FILES_OPEN];
+};
+
+int
+cpm_files_setup(struct cpm_files *files);
+
+/* Writes back and closes all open files */
+void
+cpm_files_teardown(struct cpm_files *files);
+
+/* Runs the BDOS disk function in register C with its parameter in DE, returns its value in A and HL.
+ * Other functions are ignored */
+void
+cpm_files_call(struct cpm_files *files, struct i8080_cpu *cpu);
+
+/* I8080_BOARD_CPM_FILES_H */
+#endif
@@ -0,0 +1,14 @@
+#include "cpm_stub.h"
+
+/* Wizard trick to create an output device simulating some CP/M's BIOS calls
+ * until a real CP/M is emulated */
+const uint8_t cpm_stub[CPM_STUB_SIZE] = {
+	0x76, /* 0x00: HLT */
+	0x00, 0x00, 0x00, 0x00,
+	0xCF, /* 0x05: RST 1 (CALL 0x08)*/
+	0xFF, 0xFF, /* 0x06: Available memory */
+	0xD3, 0x00, /* 0x08: OUT 0x00 */
+	0x33, /* 0x0A: INX SP, we want to return from the procedure which called 0x05, so sp += 2 */
+	0x33, /* 0x0B: INX SP */
+	0xC9, /* 0x0C: RET */
+};
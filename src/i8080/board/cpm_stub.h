@@ -0,0 +1,12 @@
+#ifndef I8080_BOARD_CPM_STUB_H
+#define I8080_BOARD_CPM_STUB_H
+
+#include <stdint.h>
+
+#define CPM_STUB_SIZE 13
+
+/* Page zero of the CP/M board, up to the BDOS output device, for anything else running COM files the same way */
+extern const uint8_t cpm_stub[CPM_STUB_SIZE];
+
+/* I8080_BOARD_CPM_STUB_H */
+#endif
@@ -1,4 +1,6 @@
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <inttypes.h>
 #include <time.h>
 
 #ifdef __APPLE__
@@ -8,56 +10,32 @@
 #endif
 
 #include "space_invaders.h"
-
-#include "../ram.h"
-
-#define SPACE_INVADERS_SCREEN_WIDTH  256
-#define SPACE_INVADERS_SCREEN_HEIGHT 224
-
-#define SPACE_INVADERS_BIT_INPUT_CREDIT   8
-#define SPACE_INVADERS_BIT_INPUT_2P_START 9
-#define SPACE_INVADERS_BIT_INPUT_1P_START 10
-#define SPACE_INVADERS_BIT_INPUT_P1_SHOT  12
-#define SPACE_INVADERS_BIT_INPUT_P1_LEFT  13
-#define SPACE_INVADERS_BIT_INPUT_P1_RIGHT 14
-#define SPACE_INVADERS_BIT_INPUT_P2_SHOT  20
-#define SPACE_INVADERS_BIT_INPUT_P2_LEFT  21
-#define SPACE_INVADERS_BIT_INPUT_P2_RIGHT 22
-
-#define SPACE_INVADERS_MASK_INPUT_DEFAULT  0x080E
-#define SPACE_INVADERS_MASK_INPUT_CREDIT   (1 << SPACE_INVADERS_BIT_INPUT_CREDIT)
-#define SPACE_INVADERS_MASK_INPUT_2P_START (1 << SPACE_INVADERS_BIT_INPUT_2P_START)
-#define SPACE_INVADERS_MASK_INPUT_1P_START (1 << SPACE_INVADERS_BIT_INPUT_1P_START)
-#define SPACE_INVADERS_MASK_INPUT_P1_SHOT  (1 << SPACE_INVADERS_BIT_INPUT_P1_SHOT)
-#define SPACE_INVADERS_MASK_INPUT_P1_LEFT  (1 << SPACE_INVADERS_BIT_INPUT_P1_LEFT)
-#define SPACE_INVADERS_MASK_INPUT_P1_RIGHT (1 << SPACE_INVADERS_BIT_INPUT_P1_RIGHT)
-#define SPACE_INVADERS_MASK_INPUT_P2_SHOT  (1 << SPACE_INVADERS_BIT_INPUT_P2_SHOT)
-#define SPACE_INVADERS_MASK_INPUT_P2_LEFT  (1 << SPACE_INVADERS_BIT_INPUT_P2_LEFT)
-#define SPACE_INVADERS_MASK_INPUT_P2_RIGHT (1 << SPACE_INVADERS_BIT_INPUT_P2_RIGHT)
+#include "space_invaders_machine.h"
+#include "space_invaders_screen.h"
+#include "space_invaders_frames.h"
 
 typedef uint64_t nanoseconds_t;
 
 static struct {
 	/* Board management */
 	bool isonline;
-	uint64_t inputs;
-	uint64_t interrupt_frame;
-
-	/* Dedicated shift HW */
-	uint16_t shift_register;
-	unsigned shift_amount;
 
 	/* Time management */
 	nanoseconds_t start;
 	nanoseconds_t cycle_duration;
-	nanoseconds_t vblank_duration;
+
+	/* Rendering, frames are handed to the render thread */
+	struct space_invaders_frames frames;
+	atomic_bool rendering;
+	int render_status;
 
 	/* SDL2 */
 	Uint32 sdl_initialized;
 	const Uint8 *sdl_keyboard_state;
 	SDL_Window *sdl_window;
-	SDL_Renderer *sdl_renderer;
-	SDL_Texture *sdl_texture;
+	SDL_Thread *sdl_render_thread;
+	SDL_sem *sdl_render_ready;
+	SDL_sem *sdl_frame_ready;
 } space_invaders;
 
 static inline nanoseconds_t
@@ -89,52 +67,87 @@ space_invaders_frequency_period(uint64_t frequency) {
 	return 1000000000 / frequency;
 }
 
-static void
-space_invaders_input(struct i8080_cpu *cpu, uint8_t device) {
-	switch(device) {
-	case 0:
-	case 1:
-	case 2:
-		cpu->registers.a = space_invaders.inputs >> device * 8;
-		break;
-	case 3:
-		cpu->registers.a = space_invaders.shift_register >> space_invaders.shift_amount;
-		break;
+/* The renderer is created and only used on the render thread, which presents the latest frame on each display refresh.
+ * A frame not published within a refresh is presented again, without being expanded again */
+static int
+space_invaders_render(void *data) {
+	SDL_Renderer *renderer;
+	SDL_Texture *texture;
+
+	renderer = SDL_CreateRenderer(space_invaders.sdl_window, -1, SDL_RENDERER_PRESENTVSYNC);
+	if(renderer == NULL) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't create renderer SDL: %s", SDL_GetError());
+		goto space_invaders_render_err0;
+	}
+
+	SDL_RenderSetLogicalSize(renderer, SPACE_INVADERS_DISPLAY_WIDTH, SPACE_INVADERS_DISPLAY_HEIGHT);
+
+	/* The texture is in display orientation, so it is copied as is to the renderer */
+	texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB332,
+		SDL_TEXTUREACCESS_STREAMING, SPACE_INVADERS_DISPLAY_WIDTH, SPACE_INVADERS_DISPLAY_HEIGHT);
+	if(texture == NULL) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't create texture SDL: %s", SDL_GetError());
+		goto space_invaders_render_err1;
 	}
+
+	SDL_SemPost(space_invaders.sdl_render_ready);
+
+	while(atomic_load_explicit(&space_invaders.rendering, memory_order_relaxed)) {
+		const uint64_t duplicated = space_invaders.frames.duplicated;
+		const uint8_t *vram;
+		void *pixels;
+		int pitch;
+
+		if(SDL_SemWaitTimeout(space_invaders.sdl_frame_ready, 1000 / SPACE_INVADERS_VBLANK_FREQUENCY) == 0) {
+			while(SDL_SemTryWait(space_invaders.sdl_frame_ready) == 0);
+		}
+
+		vram = space_invaders_frames_acquire(&space_invaders.frames);
+
+		if(space_invaders.frames.duplicated == duplicated
+			&& SDL_LockTexture(texture, NULL, &pixels, &pitch) == 0) {
+			space_invaders_screen_expand(vram, 0, SPACE_INVADERS_SCREEN_HEIGHT, pixels, pitch);
+			SDL_UnlockTexture(texture);
+		}
+
+		SDL_RenderCopy(renderer, texture, NULL, NULL);
+		SDL_RenderPresent(renderer);
+	}
+
+	SDL_DestroyTexture(texture);
+	SDL_DestroyRenderer(renderer);
+
+	return 0;
+space_invaders_render_err1:
+	SDL_DestroyRenderer(renderer);
+space_invaders_render_err0:
+	space_invaders.render_status = -1;
+	SDL_SemPost(space_invaders.sdl_render_ready);
+	return -1;
 }
 
+/* Each half of the video memory is snapshot when its interrupt is raised, and the frame is handed
+ * to the render thread at VBLANK. The emulation never waits on the renderer */
 static void
-space_invaders_output(struct i8080_cpu *cpu, uint8_t device) {
-	switch(device) {
-	case 2:
-		space_invaders.shift_amount = cpu->registers.a & 0x7;
-		return;
-	case 3:
-		return;
-	case 4:
-		space_invaders.shift_register = space_invaders.shift_register << 8 | cpu->registers.a;
-		return;
-	case 5:
-		return;
-	case 6:
-		return;
+space_invaders_blit(const uint8_t *vram, bool vblank) {
+	const size_t half = SPACE_INVADERS_VRAM_SIZE / 2, offset = vblank ? 0 : half;
+
+	memcpy(space_invaders_frames_back(&space_invaders.frames) + offset, vram + offset, half);
+
+	if(vblank) {
+		space_invaders_frames_publish(&space_invaders.frames);
+		SDL_SemPost(space_invaders.sdl_frame_ready);
 	}
 }
 
 static void
 space_invaders_board_setup(struct i8080_cpu *cpu, const char *filename) {
-	static const struct i8080_rom_section space_invaders_rom_map[] = {
-		{ .begin = 0x1000, .end = 0x2000 },
-		{ },
-	};
 
-	i8080_ram_load_file(cpu, filename, 0x0000);
-	cpu->rom_map = space_invaders_rom_map;
+	space_invaders_machine_setup(cpu, filename, space_invaders_blit);
 
 	space_invaders.isonline = true;
 
-	space_invaders.cycle_duration = space_invaders_frequency_period(3000000);
-	space_invaders.vblank_duration = space_invaders_frequency_period(60);
+	space_invaders.cycle_duration = space_invaders_frequency_period(SPACE_INVADERS_CPU_FREQUENCY);
 	space_invaders.start = space_invaders_now();
 
 	const Uint32 required_initialized = SDL_INIT_VIDEO;
@@ -146,23 +159,39 @@ space_invaders_board_setup(struct i8080_cpu *cpu, const char *filename) {
 
 	space_invaders.sdl_keyboard_state = SDL_GetKeyboardState(NULL);
 
-	if(SDL_CreateWindowAndRenderer(SPACE_INVADERS_SCREEN_WIDTH * 2, SPACE_INVADERS_SCREEN_WIDTH * 2, SDL_WINDOW_RESIZABLE,
-		&space_invaders.sdl_window, &space_invaders.sdl_renderer) != 0) {
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't create window and renderer SDL: %s", SDL_GetError());
+	space_invaders.sdl_window = SDL_CreateWindow("Space Invaders", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+		SPACE_INVADERS_DISPLAY_WIDTH * 2, SPACE_INVADERS_DISPLAY_HEIGHT * 2, SDL_WINDOW_RESIZABLE);
+	if(space_invaders.sdl_window == NULL) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't create window SDL: %s", SDL_GetError());
 		goto space_invaders_board_setup_err1;
 	}
 
-	/* SDL is weird when rotating its renderer, to simplify, we make the screen appear square and ensure aspect ratio when blitting */
-	SDL_RenderSetLogicalSize(space_invaders.sdl_renderer, SPACE_INVADERS_SCREEN_WIDTH, SPACE_INVADERS_SCREEN_WIDTH);
+	space_invaders.sdl_render_ready = SDL_CreateSemaphore(0);
+	space_invaders.sdl_frame_ready = SDL_CreateSemaphore(0);
+	if(space_invaders.sdl_render_ready == NULL || space_invaders.sdl_frame_ready == NULL) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't create semaphores SDL: %s", SDL_GetError());
+		goto space_invaders_board_setup_err2;
+	}
 
-	space_invaders.sdl_texture = SDL_CreateTexture(space_invaders.sdl_renderer, SDL_PIXELFORMAT_RGB332,
-		SDL_TEXTUREACCESS_STREAMING, SPACE_INVADERS_SCREEN_WIDTH, SPACE_INVADERS_SCREEN_HEIGHT);
-	if(space_invaders.sdl_texture == NULL) {
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't create window and renderer SDL: %s", SDL_GetError());
-		goto space_invaders_board_setup_err1;
+	space_invaders_frames_init(&space_invaders.frames);
+	atomic_init(&space_invaders.rendering, true);
+	space_invaders.render_status = 0;
+
+	space_invaders.sdl_render_thread = SDL_CreateThread(space_invaders_render, "render", NULL);
+	if(space_invaders.sdl_render_thread == NULL) {
+		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't create render thread SDL: %s", SDL_GetError());
+		goto space_invaders_board_setup_err2;
+	}
+
+	SDL_SemWait(space_invaders.sdl_render_ready);
+	if(space_invaders.render_status != 0) {
+		SDL_WaitThread(space_invaders.sdl_render_thread, NULL);
+		goto space_invaders_board_setup_err2;
 	}
 
 	return;
+space_invaders_board_setup_err2:
+	SDL_DestroyWindow(space_invaders.sdl_window);
 space_invaders_board_setup_err1:
 	SDL_QuitSubSystem(space_invaders.sdl_initialized);
 space_invaders_board_setup_err0:
@@ -171,8 +200,23 @@ space_invaders_board_setup_err0:
 
 static void
 space_invaders_board_teardown(struct i8080_cpu *cpu) {
-	SDL_DestroyTexture(space_invaders.sdl_texture);
-	SDL_DestroyRenderer(space_invaders.sdl_renderer);
+
+	space_invaders_machine_teardown(cpu);
+
+	atomic_store_explicit(&space_invaders.rendering, false, memory_order_relaxed);
+	SDL_SemPost(space_invaders.sdl_frame_ready);
+	SDL_WaitThread(space_invaders.sdl_render_thread, NULL);
+
+	fprintf(stderr, "space-invaders: %" PRIu64 " frames emulated, %" PRIu64 " dropped, %" PRIu64 " presented, %" PRIu64 " duplicated\n",
+		space_invaders.frames.published, space_invaders.frames.dropped,
+		space_invaders.frames.presented, space_invaders.frames.duplicated);
+	if(space_invaders_machine.record != NULL || space_invaders_machine.replay != NULL) {
+		fprintf(stderr, "space-invaders: %" PRIu64 " frames digest 0x%016" PRIX64 "\n",
+			space_invaders_machine.interrupt_frame / 2, space_invaders_machine.digest);
+	}
+
+	SDL_DestroySemaphore(space_invaders.sdl_frame_ready);
+	SDL_DestroySemaphore(space_invaders.sdl_render_ready);
 	SDL_DestroyWindow(space_invaders.sdl_window);
 
 	SDL_QuitSubSystem(space_invaders.sdl_initialized);
@@ -190,69 +234,32 @@ space_invaders_sdl_key_mask(SDL_Keycode keycode, uint64_t mask) {
 
 static void
 space_invaders_board_poll(struct i8080_cpu *cpu) {
+	SDL_Event event;
 
-	if((cpu->uptime_cycles * space_invaders.cycle_duration & 0xFFF) == 0) {
-		SDL_Event event;
-
-		while(SDL_PollEvent(&event) != 0) {
-			switch(event.type) {
-			case SDL_QUIT:
-				space_invaders.isonline = false;
-				break;
-			}
-		}
-
-		space_invaders.inputs = SPACE_INVADERS_MASK_INPUT_DEFAULT
-			| space_invaders_sdl_key_mask(SDLK_SPACE, SPACE_INVADERS_MASK_INPUT_CREDIT)
-			| space_invaders_sdl_key_mask(SDLK_1, SPACE_INVADERS_MASK_INPUT_1P_START)
-			| space_invaders_sdl_key_mask(SDLK_2, SPACE_INVADERS_MASK_INPUT_2P_START)
-			| space_invaders_sdl_key_mask(SDLK_LEFT, SPACE_INVADERS_MASK_INPUT_P1_LEFT)
-			| space_invaders_sdl_key_mask(SDLK_RIGHT, SPACE_INVADERS_MASK_INPUT_P1_RIGHT)
-			| space_invaders_sdl_key_mask(SDLK_UP, SPACE_INVADERS_MASK_INPUT_P1_SHOT)
-			| space_invaders_sdl_key_mask(SDLK_q, SPACE_INVADERS_MASK_INPUT_P2_LEFT)
-			| space_invaders_sdl_key_mask(SDLK_d, SPACE_INVADERS_MASK_INPUT_P2_RIGHT)
-			| space_invaders_sdl_key_mask(SDLK_z, SPACE_INVADERS_MASK_INPUT_P2_SHOT)
-		;
-	}
-}
-
-static void
-space_invaders_blit(const uint8_t *vram, bool vblank) {
-	const SDL_Point center = { .x = SPACE_INVADERS_SCREEN_WIDTH / 2, .y = SPACE_INVADERS_SCREEN_WIDTH / 2 };
-	SDL_Rect src = { .x = 0, .y = 0, .w = SPACE_INVADERS_SCREEN_WIDTH, .h = SPACE_INVADERS_SCREEN_HEIGHT / 2, };
-	SDL_Rect dest = { .x = src.x + (SPACE_INVADERS_SCREEN_WIDTH - SPACE_INVADERS_SCREEN_HEIGHT) / 2, .y = src.y, .w = src.w, .h = src.h };
-	uint8_t pixels[SPACE_INVADERS_SCREEN_WIDTH * SPACE_INVADERS_SCREEN_HEIGHT / 2];
-
-	if(!vblank) {
-		src.y += src.h;
-		dest.x += dest.h;
-		vram += 0xE00;
+	if(cpu->stopped && !cpu->inte) {
+		/* Halted for good, nothing but the user can end it: block instead of spinning */
+		SDL_WaitEvent(NULL);
 	}
 
-	for(unsigned i = 0; i < sizeof(pixels); i++) {
-		pixels[i] = -(vram[i / 8] >> (i & 7) & 1);
-	}
-
-	for(unsigned i = 0; i < sizeof(pixels); i+= SPACE_INVADERS_SCREEN_WIDTH) {
-		/* Masking white to red */
-		for(unsigned x = 192; x < 224; x++) {
-			pixels[i + x] &= 0xE0;
-		}
-		/* Masking white to green */
-		for(unsigned x = 0; x < 64; x++) {
-			pixels[i + x] &= 0x1C;
+	while(SDL_PollEvent(&event) != 0) {
+		switch(event.type) {
+		case SDL_QUIT:
+			space_invaders.isonline = false;
+			break;
 		}
 	}
 
-	SDL_UpdateTexture(space_invaders.sdl_texture, &src, pixels, SPACE_INVADERS_SCREEN_WIDTH);
-	SDL_RenderCopyEx(space_invaders.sdl_renderer, space_invaders.sdl_texture, &src, &dest, -90.0, &center, SDL_FLIP_NONE);
-
-	if(vblank) {
-		/* As SDL_Renderer works with a backbuffer, we can't really blit half the screen
-		   without explicitly asking to do so. Which translates to a half screen blinking as hell.
-		   So we render the screen once per VBLANK but update the texture as requested for each VBLANK's half */
-		SDL_RenderPresent(space_invaders.sdl_renderer);
-	}
+	space_invaders_machine_inputs(cpu, SPACE_INVADERS_MASK_INPUT_DEFAULT
+		| space_invaders_sdl_key_mask(SDLK_SPACE, SPACE_INVADERS_MASK_INPUT_CREDIT)
+		| space_invaders_sdl_key_mask(SDLK_1, SPACE_INVADERS_MASK_INPUT_1P_START)
+		| space_invaders_sdl_key_mask(SDLK_2, SPACE_INVADERS_MASK_INPUT_2P_START)
+		| space_invaders_sdl_key_mask(SDLK_LEFT, SPACE_INVADERS_MASK_INPUT_P1_LEFT)
+		| space_invaders_sdl_key_mask(SDLK_RIGHT, SPACE_INVADERS_MASK_INPUT_P1_RIGHT)
+		| space_invaders_sdl_key_mask(SDLK_UP, SPACE_INVADERS_MASK_INPUT_P1_SHOT)
+		| space_invaders_sdl_key_mask(SDLK_q, SPACE_INVADERS_MASK_INPUT_P2_LEFT)
+		| space_invaders_sdl_key_mask(SDLK_d, SPACE_INVADERS_MASK_INPUT_P2_RIGHT)
+		| space_invaders_sdl_key_mask(SDLK_z, SPACE_INVADERS_MASK_INPUT_P2_SHOT)
+	);
 }
 
 static void
@@ -263,33 +270,18 @@ space_invaders_board_sync(struct i8080_cpu *cpu) {
 	if(uptime > elapsed) {
 		space_invaders_sleep(uptime - elapsed);
 	}
-
-	const uint64_t interrupt_frame = uptime / (space_invaders.vblank_duration / 2);
-	while(space_invaders.interrupt_frame != interrupt_frame) {
-		const uint8_t * const vram = cpu->memory + 0x2400;
-
-		if(space_invaders.interrupt_frame & 1) { /* VBLANK (high) */
-			i8080_cpu_interrupt_restart(cpu, 2); /* RST 10 */
-			space_invaders_blit(vram, true);
-		} else { /* (low) */
-			i8080_cpu_interrupt_restart(cpu, 1); /* RST 8 */
-			space_invaders_blit(vram, false);
-		}
-
-		space_invaders.interrupt_frame++;
-	}
 }
 
-static const struct i8080_io space_invaders_io = {
-	.input = space_invaders_input, .output = space_invaders_output,
-};
-
 const struct i8080_board space_invaders_board = {
-	.io = &space_invaders_io,
+	.io = &space_invaders_machine_io,
+	.quantum = SPACE_INVADERS_FRAME_CYCLES / 2, /* Half a frame */
+	.frame = SPACE_INVADERS_FRAME_CYCLES,
 	.setup = space_invaders_board_setup,
 	.teardown = space_invaders_board_teardown,
 	.isonline = space_invaders_board_isonline,
 	.poll = space_invaders_board_poll,
 	.sync = space_invaders_board_sync,
+	.record = space_invaders_machine_record,
+	.replay = space_invaders_machine_replay,
 };
 
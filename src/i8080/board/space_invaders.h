@@ -3,7 +3,12 @@
 
 #include "../board.h"
 
+#ifdef I8080_SDL
 extern const struct i8080_board space_invaders_board;
+#endif
+
+/* Runs unthrottled without SDL, nothing is displayed and no input is read but the ones replayed */
+extern const struct i8080_board space_invaders_headless_board;
 
 /* I8080_BOARD_SPACE_INVADERS_H */
 #endif
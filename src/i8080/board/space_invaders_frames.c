@@ -0,0 +1,50 @@
+#include <string.h>
+
+#include "space_invaders_frames.h"
+
+#define SPACE_INVADERS_FRAMES_FRESH 0x4
+
+void
+space_invaders_frames_init(struct space_invaders_frames *frames) {
+
+	memset(frames->vram, 0, sizeof(frames->vram));
+
+	frames->back = 0;
+	atomic_init(&frames->middle, 1);
+	frames->front = 2;
+
+	frames->published = 0;
+	frames->dropped = 0;
+	frames->presented = 0;
+	frames->duplicated = 0;
+}
+
+/* Release ordering makes the writes to the back buffer visible to the reader acquiring it */
+void
+space_invaders_frames_publish(struct space_invaders_frames *frames) {
+	const unsigned previous = atomic_exchange_explicit(&frames->middle,
+		frames->back | SPACE_INVADERS_FRAMES_FRESH, memory_order_acq_rel);
+
+	if(previous & SPACE_INVADERS_FRAMES_FRESH) {
+		frames->dropped++;
+	}
+
+	frames->back = previous & ~SPACE_INVADERS_FRAMES_FRESH;
+	frames->published++;
+}
+
+const uint8_t *
+space_invaders_frames_acquire(struct space_invaders_frames *frames) {
+
+	if(atomic_load_explicit(&frames->middle, memory_order_relaxed) & SPACE_INVADERS_FRAMES_FRESH) {
+		const unsigned previous = atomic_exchange_explicit(&frames->middle, frames->front, memory_order_acq_rel);
+
+		frames->front = previous & ~SPACE_INVADERS_FRAMES_FRESH;
+	} else {
+		frames->duplicated++;
+	}
+
+	frames->presented++;
+
+	return frames->vram[frames->front];
+}
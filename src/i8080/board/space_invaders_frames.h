@@ -0,0 +1,39 @@
+#ifndef I8080_BOARD_SPACE_INVADERS_FRAMES_H
+#define I8080_BOARD_SPACE_INVADERS_FRAMES_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "space_invaders_machine.h"
+
+/* Lock-free triple buffer of video memory snapshots, from the emulation (writer) to the renderer (reader).
+ * Each side owns one buffer, and the third one is exchanged atomically along with whether it holds an unread frame.
+ * Neither side ever waits on the other: frames published twice before being read are dropped,
+ * and frames acquired while no new one was published are duplicated */
+struct space_invaders_frames {
+	uint8_t vram[3][SPACE_INVADERS_VRAM_SIZE];
+	atomic_uint middle;
+	unsigned back;  /* Owned by the writer */
+	unsigned front; /* Owned by the reader */
+	uint64_t published, dropped; /* Counted by the writer */
+	uint64_t presented, duplicated; /* Counted by the reader */
+};
+
+void
+space_invaders_frames_init(struct space_invaders_frames *frames);
+
+/* Buffer the writer fills before publishing it */
+static inline uint8_t *
+space_invaders_frames_back(struct space_invaders_frames *frames) {
+	return frames->vram[frames->back];
+}
+
+void
+space_invaders_frames_publish(struct space_invaders_frames *frames);
+
+/* Latest published frame, or the last one acquired if none was published since */
+const uint8_t *
+space_invaders_frames_acquire(struct space_invaders_frames *frames);
+
+/* I8080_BOARD_SPACE_INVADERS_FRAMES_H */
+#endif
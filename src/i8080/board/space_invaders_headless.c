@@ -0,0 +1,50 @@
+#include <inttypes.h>
+
+#include "space_invaders.h"
+#include "space_invaders_machine.h"
+
+static void
+space_invaders_headless_draw(const uint8_t *vram, bool vblank) {
+}
+
+static void
+space_invaders_headless_board_setup(struct i8080_cpu *cpu, const char *filename) {
+
+	space_invaders_machine_setup(cpu, filename, space_invaders_headless_draw);
+}
+
+static void
+space_invaders_headless_board_teardown(struct i8080_cpu *cpu) {
+
+	if(space_invaders_machine.replay != NULL) {
+		fprintf(stderr, "space-invaders-headless: %" PRIu64 " frames digest 0x%016" PRIX64 "\n",
+			space_invaders_machine.interrupt_frame / 2, space_invaders_machine.digest);
+	}
+}
+
+/* Without interrupts, a halted cpu would never wake up again */
+static bool
+space_invaders_headless_board_isonline(struct i8080_cpu *cpu) {
+	return !cpu->stopped || cpu->inte;
+}
+
+static void
+space_invaders_headless_board_poll(struct i8080_cpu *cpu) {
+}
+
+/* Interrupts are scheduled events, nothing waits for the host clock */
+static void
+space_invaders_headless_board_sync(struct i8080_cpu *cpu) {
+}
+
+const struct i8080_board space_invaders_headless_board = {
+	.io = &space_invaders_machine_io,
+	.quantum = SPACE_INVADERS_FRAME_CYCLES / 2, /* Half a frame */
+	.frame = SPACE_INVADERS_FRAME_CYCLES,
+	.setup = space_invaders_headless_board_setup,
+	.teardown = space_invaders_headless_board_teardown,
+	.isonline = space_invaders_headless_board_isonline,
+	.poll = space_invaders_headless_board_poll,
+	.sync = space_invaders_headless_board_sync,
+	.replay = space_invaders_machine_replay,
+};
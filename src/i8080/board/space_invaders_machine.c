@@ -0,0 +1,185 @@
+#include <inttypes.h>
+#include <string.h>
+
+#include "space_invaders_machine.h"
+
+#include "../ram.h"
+
+struct space_invaders_machine space_invaders_machine;
+
+static void
+space_invaders_machine_input(struct i8080_cpu *cpu, uint8_t device) {
+	switch(device) {
+	case 0:
+	case 1:
+	case 2:
+		cpu->registers.a = space_invaders_machine.inputs >> device * 8;
+		break;
+	case 3:
+		cpu->registers.a = space_invaders_machine.shift_register >> space_invaders_machine.shift_amount;
+		break;
+	}
+}
+
+static void
+space_invaders_machine_output(struct i8080_cpu *cpu, uint8_t device) {
+	switch(device) {
+	case 2:
+		space_invaders_machine.shift_amount = cpu->registers.a & 0x7;
+		return;
+	case 3:
+		return;
+	case 4:
+		space_invaders_machine.shift_register = space_invaders_machine.shift_register << 8 | cpu->registers.a;
+		return;
+	case 5:
+		return;
+	case 6:
+		return;
+	}
+}
+
+const struct i8080_io space_invaders_machine_io = {
+	.input = space_invaders_machine_input, .output = space_invaders_machine_output,
+};
+
+#define SPACE_INVADERS_DIGEST_OFFSET 0xCBF29CE484222325
+#define SPACE_INVADERS_DIGEST_PRIME  0x00000100000001B3
+
+/* FNV-1a, a word at a time */
+static uint64_t
+space_invaders_machine_digest(uint64_t digest, const uint8_t *vram) {
+
+	for(size_t offset = 0; offset < SPACE_INVADERS_VRAM_SIZE; offset += sizeof(uint64_t)) {
+		uint64_t word;
+
+		memcpy(&word, vram + offset, sizeof(word));
+		digest = (digest ^ word) * SPACE_INVADERS_DIGEST_PRIME;
+	}
+
+	return digest;
+}
+
+static void
+space_invaders_machine_interrupt(struct i8080_cpu *cpu, void *data) {
+	const uint8_t * const vram = cpu->memory + 0x2400;
+
+	if(space_invaders_machine.interrupt_frame & 1) { /* VBLANK (high) */
+		i8080_cpu_interrupt_restart(cpu, 2); /* RST 10 */
+		space_invaders_machine.draw(vram, true);
+		if(space_invaders_machine.record != NULL || space_invaders_machine.replay != NULL) {
+			space_invaders_machine.digest = space_invaders_machine_digest(space_invaders_machine.digest, vram);
+		}
+	} else { /* (low) */
+		i8080_cpu_interrupt_restart(cpu, 1); /* RST 8 */
+		space_invaders_machine.draw(vram, false);
+	}
+
+	space_invaders_machine.interrupt_frame++;
+
+	i8080_cpu_schedule(cpu, (space_invaders_machine.interrupt_frame + 1) * (SPACE_INVADERS_FRAME_CYCLES / 2),
+		space_invaders_machine_interrupt, NULL);
+}
+
+void
+space_invaders_machine_setup(struct i8080_cpu *cpu, const char *filename, void (*draw)(const uint8_t *, bool)) {
+	static const struct i8080_rom_section space_invaders_rom_map[] = {
+		{ .begin = 0x1000, .end = 0x2000 },
+		{ },
+	};
+
+	i8080_ram_load_file(cpu, filename, 0x0000);
+	i8080_cpu_set_rom_map(cpu, space_invaders_rom_map);
+	/* RAM is mirrored right above itself */
+	i8080_cpu_map(cpu, 0x4000, 0x2000, cpu->memory + 0x2000, cpu->memory + 0x2000);
+
+	space_invaders_machine = (struct space_invaders_machine) {
+		.inputs = SPACE_INVADERS_MASK_INPUT_DEFAULT,
+		.draw = draw,
+	};
+
+	i8080_cpu_schedule(cpu, SPACE_INVADERS_FRAME_CYCLES / 2, space_invaders_machine_interrupt, NULL);
+}
+
+void
+space_invaders_machine_teardown(struct i8080_cpu *cpu) {
+
+	if(space_invaders_machine.record != NULL) {
+		fprintf(space_invaders_machine.record, "%" PRIu64 " 0x%06" PRIX64 "\n", cpu->uptime_cycles, space_invaders_machine.inputs);
+	}
+}
+
+void
+space_invaders_machine_inputs(struct i8080_cpu *cpu, uint64_t inputs) {
+
+	if(space_invaders_machine.replay != NULL || inputs == space_invaders_machine.inputs) {
+		return;
+	}
+
+	space_invaders_machine.inputs = inputs;
+
+	if(space_invaders_machine.record != NULL) {
+		fprintf(space_invaders_machine.record, "%" PRIu64 " 0x%06" PRIX64 "\n", cpu->uptime_cycles, inputs);
+	}
+}
+
+int
+space_invaders_machine_record(struct i8080_cpu *cpu, FILE *output) {
+
+	space_invaders_machine.record = output;
+	space_invaders_machine.digest = SPACE_INVADERS_DIGEST_OFFSET;
+
+	/* Inputs held since the start */
+	fprintf(output, "%" PRIu64 " 0x%06" PRIX64 "\n", cpu->uptime_cycles, space_invaders_machine.inputs);
+
+	return ferror(output) ? -1 : 0;
+}
+
+static void
+space_invaders_machine_replay_next(struct i8080_cpu *cpu);
+
+/* The inputs are carried by the event itself, only the next change is read ahead */
+static void
+space_invaders_machine_replay_change(struct i8080_cpu *cpu, void *data) {
+
+	space_invaders_machine.inputs = (uintptr_t)data;
+
+	space_invaders_machine_replay_next(cpu);
+}
+
+static void
+space_invaders_machine_replay_next(struct i8080_cpu *cpu) {
+	char line[64];
+
+	while(fgets(line, sizeof(line), space_invaders_machine.replay) != NULL) {
+		uint64_t cycles, inputs;
+
+		if(*line == '#' || *line == '\n') {
+			if(strchr(line, '\n') == NULL) { /* Rest of a long comment */
+				int c;
+
+				while(c = fgetc(space_invaders_machine.replay), c != '\n' && c != EOF);
+			}
+			continue;
+		}
+
+		if(sscanf(line, "%" SCNu64 " %" SCNx64, &cycles, &inputs) != 2) {
+			fprintf(stderr, "space-invaders: Invalid input change in replay: %s", line);
+			return;
+		}
+
+		i8080_cpu_schedule(cpu, cycles, space_invaders_machine_replay_change, (void *)(uintptr_t)inputs);
+		return;
+	}
+}
+
+int
+space_invaders_machine_replay(struct i8080_cpu *cpu, FILE *input) {
+
+	space_invaders_machine.replay = input;
+	space_invaders_machine.digest = SPACE_INVADERS_DIGEST_OFFSET;
+
+	space_invaders_machine_replay_next(cpu);
+
+	return ferror(input) ? -1 : 0;
+}
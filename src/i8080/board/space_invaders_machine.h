@@ -0,0 +1,81 @@
+#ifndef I8080_BOARD_SPACE_INVADERS_MACHINE_H
+#define I8080_BOARD_SPACE_INVADERS_MACHINE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "i8080/cpu.h"
+
+#define SPACE_INVADERS_SCREEN_WIDTH  256
+#define SPACE_INVADERS_SCREEN_HEIGHT 224
+#define SPACE_INVADERS_VRAM_SIZE (SPACE_INVADERS_SCREEN_WIDTH / 8 * SPACE_INVADERS_SCREEN_HEIGHT)
+
+#define SPACE_INVADERS_CPU_FREQUENCY 3000000
+#define SPACE_INVADERS_VBLANK_FREQUENCY 60
+#define SPACE_INVADERS_FRAME_CYCLES (SPACE_INVADERS_CPU_FREQUENCY / SPACE_INVADERS_VBLANK_FREQUENCY)
+
+#define SPACE_INVADERS_BIT_INPUT_CREDIT   8
+#define SPACE_INVADERS_BIT_INPUT_2P_START 9
+#define SPACE_INVADERS_BIT_INPUT_1P_START 10
+#define SPACE_INVADERS_BIT_INPUT_P1_SHOT  12
+#define SPACE_INVADERS_BIT_INPUT_P1_LEFT  13
+#define SPACE_INVADERS_BIT_INPUT_P1_RIGHT 14
+#define SPACE_INVADERS_BIT_INPUT_P2_SHOT  20
+#define SPACE_INVADERS_BIT_INPUT_P2_LEFT  21
+#define SPACE_INVADERS_BIT_INPUT_P2_RIGHT 22
+
+#define SPACE_INVADERS_MASK_INPUT_DEFAULT  0x080E
+#define SPACE_INVADERS_MASK_INPUT_CREDIT   (1 << SPACE_INVADERS_BIT_INPUT_CREDIT)
+#define SPACE_INVADERS_MASK_INPUT_2P_START (1 << SPACE_INVADERS_BIT_INPUT_2P_START)
+#define SPACE_INVADERS_MASK_INPUT_1P_START (1 << SPACE_INVADERS_BIT_INPUT_1P_START)
+#define SPACE_INVADERS_MASK_INPUT_P1_SHOT  (1 << SPACE_INVADERS_BIT_INPUT_P1_SHOT)
+#define SPACE_INVADERS_MASK_INPUT_P1_LEFT  (1 << SPACE_INVADERS_BIT_INPUT_P1_LEFT)
+#define SPACE_INVADERS_MASK_INPUT_P1_RIGHT (1 << SPACE_INVADERS_BIT_INPUT_P1_RIGHT)
+#define SPACE_INVADERS_MASK_INPUT_P2_SHOT  (1 << SPACE_INVADERS_BIT_INPUT_P2_SHOT)
+#define SPACE_INVADERS_MASK_INPUT_P2_LEFT  (1 << SPACE_INVADERS_BIT_INPUT_P2_LEFT)
+#define SPACE_INVADERS_MASK_INPUT_P2_RIGHT (1 << SPACE_INVADERS_BIT_INPUT_P2_RIGHT)
+
+/* The hardware of the cabinet around the cpu, shared by the frontends of the board and independent of SDL */
+struct space_invaders_machine {
+	uint64_t inputs;
+	uint64_t interrupt_frame; /* Half frames elapsed, each one ends with an interrupt */
+	void (*draw)(const uint8_t *, bool);
+
+	/* Dedicated shift HW */
+	uint16_t shift_register;
+	unsigned shift_amount;
+
+	/* Input changes, logged or replayed at the cycle they happened */
+	FILE *record, *replay;
+	uint64_t digest; /* Of the video memory at each VBLANK, while recording or replaying */
+};
+
+extern struct space_invaders_machine space_invaders_machine;
+
+extern const struct i8080_io space_invaders_machine_io;
+
+/* Loads the ROM, installs the memory map and schedules the interrupt ending the first half frame.
+ * Each half frame ends exactly SPACE_INVADERS_FRAME_CYCLES / 2 cycles after the previous one, then draw is called
+ * with the video memory and whether the lower (false) or upper (true, VBLANK) half of the screen completed */
+void
+space_invaders_machine_setup(struct i8080_cpu *cpu, const char *filename, void (*draw)(const uint8_t *, bool));
+
+/* Ends the recording with the last cycle run, so replays know how long the session was */
+void
+space_invaders_machine_teardown(struct i8080_cpu *cpu);
+
+/* Inputs sampled by a frontend, ignored while replaying */
+void
+space_invaders_machine_inputs(struct i8080_cpu *cpu, uint64_t inputs);
+
+/* Recordings are text, one line per input change: the cycle it happened at and the inputs in hexadecimal.
+ * Frontends sample inputs between runs of the cpu, so replaying them as events at the same cycles
+ * stops the cpu at the same instruction boundaries, and the session runs exactly the same */
+int
+space_invaders_machine_record(struct i8080_cpu *cpu, FILE *output);
+
+int
+space_invaders_machine_replay(struct i8080_cpu *cpu, FILE *input);
+
+/* I8080_BOARD_SPACE_INVADERS_MACHINE_H */
+#endif
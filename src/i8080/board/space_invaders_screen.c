@@ -0,0 +1,100 @@
+#include "space_invaders_screen.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define SPACE_INVADERS_SCREEN_ROW_SIZE (SPACE_INVADERS_SCREEN_WIDTH / 8)
+
+/* Colour overlay of a display row */
+static inline uint8_t
+space_invaders_screen_colour(unsigned y) {
+	const unsigned x = SPACE_INVADERS_DISPLAY_HEIGHT - 1 - y;
+
+	if(x >= 192 && x < 224) { /* Red */
+		return 0xE0;
+	}
+
+	if(x < 64) { /* Green */
+		return 0x1C;
+	}
+
+	return 0xFF;
+}
+
+void
+space_invaders_screen_expand_scalar(const uint8_t *vram, unsigned first, unsigned count, uint8_t *pixels, size_t pitch) {
+
+	for(unsigned y = 0; y < SPACE_INVADERS_DISPLAY_HEIGHT; y++) {
+		const unsigned bit = SPACE_INVADERS_DISPLAY_HEIGHT - 1 - y;
+		const uint8_t colour = space_invaders_screen_colour(y);
+		uint8_t * const row = pixels + y * pitch;
+
+		for(unsigned x = 0; x < count; x++) {
+			const uint8_t byte = vram[(first + x) * SPACE_INVADERS_SCREEN_ROW_SIZE + bit / 8];
+
+			row[x] = -(byte >> bit % 8 & 1) & colour;
+		}
+	}
+}
+
+#ifdef __SSE2__
+
+/* Transposes a 16x16 matrix of bytes, four rounds of interleaving rows i and i + 8 */
+static inline void
+space_invaders_screen_transpose(__m128i rows[16]) {
+
+	for(unsigned round = 0; round < 4; round++) {
+		__m128i interleaved[16];
+
+		for(unsigned i = 0; i < 8; i++) {
+			interleaved[2 * i] = _mm_unpacklo_epi8(rows[i], rows[i + 8]);
+			interleaved[2 * i + 1] = _mm_unpackhi_epi8(rows[i], rows[i + 8]);
+		}
+
+		for(unsigned i = 0; i < 16; i++) {
+			rows[i] = interleaved[i];
+		}
+	}
+}
+
+/* Video memory is taken by blocks of 16 rows and 16 bytes. Once transposed, each vector holds the same byte
+ * of 16 consecutive rows, and each of its bits is 16 consecutive pixels of a display row */
+void
+space_invaders_screen_expand(const uint8_t *vram, unsigned first, unsigned count, uint8_t *pixels, size_t pitch) {
+
+	for(unsigned x = 0; x < count; x += 16) {
+		const uint8_t * const block = vram + (first + x) * SPACE_INVADERS_SCREEN_ROW_SIZE;
+
+		for(unsigned half = 0; half < SPACE_INVADERS_SCREEN_ROW_SIZE; half += 16) {
+			__m128i rows[16];
+
+			for(unsigned i = 0; i < 16; i++) {
+				rows[i] = _mm_loadu_si128((const __m128i *)(block + i * SPACE_INVADERS_SCREEN_ROW_SIZE + half));
+			}
+
+			space_invaders_screen_transpose(rows);
+
+			for(unsigned byte = 0; byte < 16; byte++) {
+				for(unsigned bit = 0; bit < 8; bit++) {
+					const unsigned y = SPACE_INVADERS_DISPLAY_HEIGHT - 1 - (half + byte) * 8 - bit;
+					const __m128i mask = _mm_set1_epi8(1 << bit),
+						set = _mm_cmpeq_epi8(_mm_and_si128(rows[byte], mask), mask);
+
+					_mm_storeu_si128((__m128i *)(pixels + y * pitch + x),
+						_mm_and_si128(set, _mm_set1_epi8(space_invaders_screen_colour(y))));
+				}
+			}
+		}
+	}
+}
+
+#else
+
+void
+space_invaders_screen_expand(const uint8_t *vram, unsigned first, unsigned count, uint8_t *pixels, size_t pitch) {
+
+	space_invaders_screen_expand_scalar(vram, first, count, pixels, pitch);
+}
+
+#endif
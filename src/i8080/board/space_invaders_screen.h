@@ -0,0 +1,26 @@
+#ifndef I8080_BOARD_SPACE_INVADERS_SCREEN_H
+#define I8080_BOARD_SPACE_INVADERS_SCREEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "space_invaders_machine.h"
+
+/* Video memory holds one bit per pixel, SPACE_INVADERS_SCREEN_HEIGHT rows of SPACE_INVADERS_SCREEN_WIDTH pixels,
+ * and the monitor is mounted rotated by 90 degrees counter clockwise. Pixels are expanded to RGB332 in display
+ * orientation: row x of video memory becomes display column x, and its bit y becomes display row 255 - y.
+ * The colour overlay of the cabinet is applied, red over display rows 32 to 63 and green over the 64 last ones */
+#define SPACE_INVADERS_DISPLAY_WIDTH  SPACE_INVADERS_SCREEN_HEIGHT
+#define SPACE_INVADERS_DISPLAY_HEIGHT SPACE_INVADERS_SCREEN_WIDTH
+
+/* Expands count rows of video memory starting at row first, count and first must be multiples of 16.
+ * pixels points to display column first of display row 0, and pitch is the size in bytes of a display row */
+void
+space_invaders_screen_expand(const uint8_t *vram, unsigned first, unsigned count, uint8_t *pixels, size_t pitch);
+
+/* Pixel by pixel reference of space_invaders_screen_expand */
+void
+space_invaders_screen_expand_scalar(const uint8_t *vram, unsigned first, unsigned count, uint8_t *pixels, size_t pitch);
+
+/* I8080_BOARD_SPACE_INVADERS_SCREEN_H */
+#endif
@@ -1,6 +1,8 @@
 #include <stdio.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <getopt.h>
 
 #include "i8080/cpu.h"
@@ -9,9 +11,17 @@
 #include "board/cpm.h"
 #include "board/space_invaders.h"
 
+/* Pairs of opcodes printed by -histogram */
+#define I8080_HISTOGRAM_PAIRS 64
+
 struct i8080_args {
 	const struct i8080_board *board;
 	const char *preset;
+	enum i8080_engine engine;
+	uint64_t cycles, frames;
+	bool idle, histogram;
+	const char *profile, *trace;
+	const char *record, *replay;
 };
 
 static const struct i8080_preset {
@@ -19,14 +29,36 @@ static const struct i8080_preset {
 	const struct i8080_board *board;
 } presets[] = {
 	{ "CP/M", &cpm_board },
+	{ "CP/M-2.2", &cpm_bios_board },
+#ifdef I8080_SDL
 	{ "space-invaders", &space_invaders_board },
+#endif
+	{ "space-invaders-headless", &space_invaders_headless_board },
 };
 
 static const struct option longopts[] = {
 	{ "board", required_argument },
+	{ "engine", required_argument },
+	{ "cycles", required_argument },
+	{ "frames", required_argument },
+	{ "idle", no_argument },
+	{ "profile", required_argument },
+	{ "histogram", no_argument },
+	{ "trace", required_argument },
+	{ "record", required_argument },
+	{ "replay", required_argument },
 	{ },
 };
 
+static double
+i8080_now(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
 static const struct i8080_board *
 i8080_preset_find(const char *preset) {
 	const struct i8080_preset *current = presets, *end = presets + sizeof(presets) / sizeof(*presets);
@@ -50,9 +82,136 @@ i8080_preset_find(const char *preset) {
 	return current->board;
 }
 
+static enum i8080_engine
+i8080_engine_parse(const char *name) {
+	enum i8080_engine engine;
+
+	if(i8080_engine_find(name, &engine) != 0) {
+		fprintf(stderr, "Unable to find engine named '%s', available engines are:\n", name);
+
+		for(engine = I8080_ENGINE_TABLE; i8080_engine_name(engine) != NULL; engine++) {
+			printf("  - %s\n", i8080_engine_name(engine));
+		}
+
+		exit(EXIT_FAILURE);
+	}
+
+	return engine;
+}
+
+/* Writes the collapsed call stacks, and prints the hottest addresses */
+static void
+i8080_profile_report(const struct i8080_cpu *cpu, const char *output, const char *i8080name) {
+	const uint64_t * const cycles = i8080_cpu_profile_cycles(cpu);
+	uint16_t hottest[10];
+	unsigned count = 0;
+	uint64_t total = 0;
+	FILE *file;
+
+	file = fopen(output, "w");
+	if(file == NULL || i8080_cpu_profile_write(cpu, file) != 0) {
+		fprintf(stderr, "%s: Unable to write profile to %s\n", i8080name, output);
+	}
+
+	if(file != NULL) {
+		fclose(file);
+	}
+
+	for(unsigned address = 0; address < I8080_MEMORY_SIZE; address++) {
+		unsigned rank = count;
+
+		if(cycles[address] == 0) {
+			continue;
+		}
+
+		total += cycles[address];
+		if(rank == sizeof(hottest) / sizeof(*hottest)) {
+			if(cycles[address] <= cycles[hottest[rank - 1]]) {
+				continue;
+			}
+			rank--;
+		} else {
+			count++;
+		}
+
+		while(rank != 0 && cycles[address] > cycles[hottest[rank - 1]]) {
+			hottest[rank] = hottest[rank - 1];
+			rank--;
+		}
+
+		hottest[rank] = address;
+	}
+
+	fprintf(stderr, "%s: Hottest addresses:\n", i8080name);
+	for(unsigned rank = 0; rank < count; rank++) {
+		const uint16_t address = hottest[rank];
+
+		fprintf(stderr, "  0x%04X %6.2f%% %s\n", address, 100.0 * cycles[address] / total,
+			i8080_instruction_info(cpu->memory[address])->mnemonic);
+	}
+}
+
+/* Counts indexed by the entries being sorted, qsort has no context argument */
+static const uint64_t *i8080_histogram_counts;
+
+static int
+i8080_histogram_compare(const void *lhs, const void *rhs) {
+	const uint64_t left = i8080_histogram_counts[*(const uint16_t *)lhs],
+		right = i8080_histogram_counts[*(const uint16_t *)rhs];
+
+	return (left < right) - (left > right);
+}
+
+/* Sorts the indexes of the non-zero counts by decreasing count, returns how many there are */
+static unsigned
+i8080_histogram_sort(const uint64_t *counts, unsigned size, uint16_t *sorted, uint64_t *total) {
+	unsigned count = 0;
+
+	*total = 0;
+	for(unsigned index = 0; index < size; index++) {
+		*total += counts[index];
+		if(counts[index] != 0) {
+			sorted[count++] = index;
+		}
+	}
+
+	i8080_histogram_counts = counts;
+	qsort(sorted, count, sizeof(*sorted), i8080_histogram_compare);
+
+	return count;
+}
+
+/* Prints the opcodes executed and the most frequent pairs of consecutive opcodes, by decreasing counts */
+static void
+i8080_histogram_report(const struct i8080_histogram *histogram, const char *i8080name) {
+	static uint16_t sorted[0x10000];
+	const uint64_t * const pairs = &histogram->pairs[0][0];
+	uint64_t total;
+	unsigned count;
+
+	count = i8080_histogram_sort(histogram->opcodes, 0x100, sorted, &total);
+	fprintf(stderr, "%s: Opcodes executed (%" PRIu64 "):\n", i8080name, total);
+	for(unsigned i = 0; i < count; i++) {
+		const uint8_t opcode = sorted[i];
+
+		fprintf(stderr, "  0x%02X       %-12s              %14" PRIu64 " %6.2f%%\n", opcode,
+			i8080_instruction_info(opcode)->mnemonic, histogram->opcodes[opcode], 100.0 * histogram->opcodes[opcode] / total);
+	}
+
+	count = i8080_histogram_sort(pairs, 0x10000, sorted, &total);
+	fprintf(stderr, "%s: Most frequent opcode pairs (%" PRIu64 "):\n", i8080name, total);
+	for(unsigned i = 0; i < count && i < I8080_HISTOGRAM_PAIRS; i++) {
+		const uint8_t first = sorted[i] >> 8, second = sorted[i];
+
+		fprintf(stderr, "  0x%02X 0x%02X  %-12s %-12s %14" PRIu64 " %6.2f%%\n", first, second,
+			i8080_instruction_info(first)->mnemonic, i8080_instruction_info(second)->mnemonic,
+			pairs[sorted[i]], 100.0 * pairs[sorted[i]] / total);
+	}
+}
+
 static void
 i8080_usage(const char *i8080name) {
-	fprintf(stderr, "usage: %s [-board <preset>] program\n", i8080name);
+	fprintf(stderr, "usage: %s [-board <preset>] [-engine <engine>] [-cycles <limit>] [-frames <limit>] [-idle] [-profile <output>] [-histogram] [-trace <output>] [-record <output>] [-replay <input>] program\n", i8080name);
 	exit(EXIT_FAILURE);
 }
 
@@ -61,14 +220,59 @@ i8080_parse_args(int argc, char **argv) {
 	struct i8080_args args = {
 		.board = &cpm_board,
 		.preset = NULL,
+		.engine = I8080_ENGINE_THREADED,
+		.cycles = UINT64_MAX,
+		.frames = UINT64_MAX,
+		.profile = NULL,
+		.trace = NULL,
+		.record = NULL,
+		.replay = NULL,
 	};
 	int longindex, c;
+	char *end;
 
 	while(c = getopt_long_only(argc, argv, ":", longopts, &longindex), c != -1) {
 		switch(c) {
 		case 0:
-			if(longindex == 0) {
+			switch(longindex) {
+			case 0:
 				args.preset = optarg;
+				break;
+			case 1:
+				args.engine = i8080_engine_parse(optarg);
+				break;
+			case 2:
+				args.cycles = strtoull(optarg, &end, 0);
+				if(*optarg == '\0' || *end != '\0') {
+					fprintf(stderr, "%s: Invalid cycle limit %s\n", *argv, optarg);
+					i8080_usage(*argv);
+				}
+				break;
+			case 3:
+				args.frames = strtoull(optarg, &end, 0);
+				if(*optarg == '\0' || *end != '\0') {
+					fprintf(stderr, "%s: Invalid frame limit %s\n", *argv, optarg);
+					i8080_usage(*argv);
+				}
+				break;
+			case 4:
+				args.idle = true;
+				break;
+			case 5:
+				args.profile = optarg;
+				break;
+			case 6:
+				args.histogram = true;
+				break;
+			case 7:
+				args.trace = optarg;
+				break;
+			case 8:
+				args.record = optarg;
+				break;
+			case 9:
+				args.replay = optarg;
+				break;
 			}
 			break;
 		case '?':
@@ -84,6 +288,28 @@ i8080_parse_args(int argc, char **argv) {
 		args.board = i8080_preset_find(args.preset);
 	}
 
+	if((args.record != NULL && args.board->record == NULL) || (args.replay != NULL && args.board->replay == NULL)) {
+		fprintf(stderr, "%s: Board cannot record nor replay its inputs\n", *argv);
+		i8080_usage(*argv);
+	}
+
+	if(args.record != NULL && args.replay != NULL) {
+		fprintf(stderr, "%s: Inputs are either recorded or replayed\n", *argv);
+		i8080_usage(*argv);
+	}
+
+	if(args.frames != UINT64_MAX) {
+		if(args.board->frame == 0) {
+			fprintf(stderr, "%s: Board has no display to count frames of\n", *argv);
+			i8080_usage(*argv);
+		}
+
+		/* Frames are counted in emulated time, whichever limit comes first stops the board */
+		if(args.frames < args.cycles / args.board->frame) {
+			args.cycles = args.frames * args.board->frame;
+		}
+	}
+
 	if(argc - optind != 1) {
 		fprintf(stderr, "%s: Expected one program file\n", *argv);
 		i8080_usage(*argv);
@@ -97,22 +323,115 @@ main(int argc, char **argv) {
 	const struct i8080_args args = i8080_parse_args(argc, argv);
 	const struct i8080_board * const board = args.board;
 	const char * const program = argv[optind];
+	struct i8080_block_stats stats;
 	struct i8080_cpu cpu;
+	FILE *trace = NULL, *inputs = NULL;
+	double start, elapsed;
 
 	i8080_cpu_init(&cpu, board->io);
+	if(i8080_cpu_set_engine(&cpu, args.engine) != 0) {
+		fprintf(stderr, "%s: Unable to set execution engine\n", *argv);
+		return EXIT_FAILURE;
+	}
+
+	if(args.idle && i8080_cpu_set_idle_skip(&cpu, true) != 0) {
+		fprintf(stderr, "%s: Idle loops can only be skipped by the block and jit engines\n", *argv);
+		return EXIT_FAILURE;
+	}
 
 	board->setup(&cpu, program);
 
-	while(board->isonline(&cpu)) {
+	if(args.record != NULL) {
+		inputs = fopen(args.record, "w");
+		if(inputs == NULL || board->record(&cpu, inputs) != 0) {
+			fprintf(stderr, "%s: Unable to record inputs to %s\n", *argv, args.record);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(args.replay != NULL) {
+		inputs = fopen(args.replay, "r");
+		if(inputs == NULL || board->replay(&cpu, inputs) != 0) {
+			fprintf(stderr, "%s: Unable to replay inputs from %s\n", *argv, args.replay);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(args.profile != NULL && i8080_cpu_profile_start(&cpu) != 0) {
+		fprintf(stderr, "%s: Unable to profile, built without I8080_PROFILE\n", *argv);
+		return EXIT_FAILURE;
+	}
+
+	if(args.histogram && i8080_cpu_histogram_start(&cpu) != 0) {
+		fprintf(stderr, "%s: Unable to count opcodes, built without I8080_HISTOGRAM\n", *argv);
+		return EXIT_FAILURE;
+	}
+
+	if(args.trace != NULL) {
+		trace = fopen(args.trace, "wb");
+		if(trace == NULL) {
+			fprintf(stderr, "%s: Unable to open trace %s\n", *argv, args.trace);
+			return EXIT_FAILURE;
+		}
+
+		if(i8080_cpu_trace_start(&cpu, trace) != 0) {
+			fprintf(stderr, "%s: Unable to trace, built without I8080_TRACE\n", *argv);
+			return EXIT_FAILURE;
+		}
+	}
+
+	start = i8080_now();
+	while(board->isonline(&cpu) && cpu.uptime_cycles < args.cycles) {
+		const uint64_t left = args.cycles - cpu.uptime_cycles;
+
 		board->poll(&cpu);
 
-		i8080_cpu_next(&cpu);
+		i8080_cpu_run(&cpu, left < board->quantum ? left : board->quantum);
 
 		board->sync(&cpu);
 	}
+	elapsed = i8080_now() - start;
 
 	board->teardown(&cpu);
 
+	if(inputs != NULL && fclose(inputs) != 0 && args.record != NULL) {
+		fprintf(stderr, "%s: Unable to record inputs to %s\n", *argv, args.record);
+	}
+
+	if(args.cycles != UINT64_MAX) {
+		fprintf(stderr, "%s: %" PRIu64 " cycles in %.3f seconds (%.2f MHz)", *argv,
+			cpu.uptime_cycles, elapsed, elapsed != 0.0 ? cpu.uptime_cycles / elapsed / 1e6 : 0.0);
+		if(board->frame != 0) {
+			const uint64_t frames = cpu.uptime_cycles / board->frame;
+
+			fprintf(stderr, ", %" PRIu64 " frames (%.2f frames/s)", frames, elapsed != 0.0 ? frames / elapsed : 0.0);
+		}
+		fputc('\n', stderr);
+	}
+
+	if(i8080_cpu_block_stats(&cpu, &stats) == 0) {
+		const uint64_t lookups = stats.hits + stats.misses;
+
+		fprintf(stderr, "%s: Block cache: %" PRIu64 " hits, %" PRIu64 " misses (%.2f%% hit rate), %" PRIu64 " invalidations\n",
+			*argv, stats.hits, stats.misses, lookups != 0 ? 100.0 * stats.hits / lookups : 0.0, stats.invalidations);
+		if(args.idle) {
+			fprintf(stderr, "%s: Idle loops: %" PRIu64 " cycles skipped (%.2f%% of uptime)\n", *argv,
+				stats.skipped, cpu.uptime_cycles != 0 ? 100.0 * stats.skipped / cpu.uptime_cycles : 0.0);
+		}
+	}
+
+	if(args.profile != NULL) {
+		i8080_profile_report(&cpu, args.profile, *argv);
+	}
+
+	if(args.histogram) {
+		i8080_histogram_report(i8080_cpu_histogram(&cpu), *argv);
+	}
+
+	if(trace != NULL && (i8080_cpu_trace_stop(&cpu) != 0 || fclose(trace) != 0)) {
+		fprintf(stderr, "%s: Unable to write trace to %s\n", *argv, args.trace);
+	}
+
 	i8080_cpu_deinit(&cpu);
 
 	return EXIT_SUCCESS;
@@ -0,0 +1,455 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "block.h"
+#include "memory.h"
+#include "profile.h"
+#include "histogram.h"
+#include "trace.h"
+#include "jit.h"
+
+static void
+i8080_block_code_store(struct i8080_cpu *cpu, uint16_t address, uint8_t src);
+
+static const struct i8080_mmio i8080_block_code = {
+	.store = i8080_block_code_store,
+};
+
+static void
+i8080_block_invalidate_page(struct i8080_cpu *cpu, struct i8080_block_cache *cache, unsigned page) {
+	struct i8080_block ** const begin = cache->blocks + page * I8080_PAGE_SIZE,
+		** const end = begin + I8080_PAGE_SIZE;
+
+	for(struct i8080_block **current = begin; current != end; current++) {
+		if(*current != NULL) {
+			(*current)->next = cache->garbage;
+			cache->garbage = *current;
+			*current = NULL;
+		}
+	}
+
+	memset(cache->code + page * I8080_PAGE_SIZE / 8, 0, I8080_PAGE_SIZE / 8);
+	cache->decoded[page] = false;
+
+	for(unsigned protected = 0; protected < I8080_PAGE_COUNT; protected++) {
+		if(cache->store[protected] != NULL && cache->target[protected] == page) {
+			/* Pages still clean since the last snapshot stay write protected by it */
+			if(cpu->snapshot != NULL && !cpu->dirty[protected]) {
+				cpu->clean[protected] = cache->store[protected];
+			} else {
+				cpu->pages[protected].store = cache->store[protected];
+			}
+			cpu->pages[protected].mmio = NULL;
+			cache->store[protected] = NULL;
+		}
+	}
+
+	cache->stats.invalidations++;
+}
+
+static void
+i8080_block_collect(struct i8080_block_cache *cache) {
+
+	while(cache->garbage != NULL) {
+		struct i8080_block * const next = cache->garbage->next;
+
+		free(cache->garbage);
+		cache->garbage = next;
+	}
+}
+
+static void
+i8080_block_code_store(struct i8080_cpu *cpu, uint16_t address, uint8_t src) {
+	struct i8080_block_cache * const cache = cpu->blocks;
+	const unsigned page = address / I8080_PAGE_SIZE, offset = address % I8080_PAGE_SIZE,
+		code = cache->target[page] * I8080_PAGE_SIZE + offset;
+	uint8_t * const store = cache->store[page];
+
+	if(cache->code[code / 8] >> code % 8 & 1) {
+#ifdef I8080_JIT
+		if(cache->rewrites[cache->target[page]] < I8080_JIT_REWRITES_MAX) {
+			cache->rewrites[cache->target[page]]++;
+		}
+#endif
+		i8080_block_invalidate_page(cpu, cache, cache->target[page]);
+	}
+
+	store[offset] = src;
+}
+
+/* Blocks are only decoded from pages directly backed by host memory, and whose writes can all be caught.
+ * Pages sharing their host memory with an already decoded page are left to the interpreter */
+static bool
+i8080_block_protect(struct i8080_cpu *cpu, struct i8080_block_cache *cache, unsigned page) {
+	uint8_t * const load = cpu->pages[page].load;
+
+	if(cache->decoded[page]) {
+		return true;
+	}
+
+	if(load == NULL || cpu->pages[page].mmio != NULL) {
+		return false;
+	}
+
+	for(unsigned other = 0; other < I8080_PAGE_COUNT; other++) {
+		if(cache->decoded[other] && cpu->pages[other].load == load) {
+			return false;
+		}
+	}
+
+	/* Pages write protected by a snapshot are taken over, their writes mark them dirty through the mmio path all the same */
+	for(unsigned protected = 0; protected < I8080_PAGE_COUNT; protected++) {
+		if(cpu->pages[protected].store == load || cpu->clean[protected] == load) {
+			cache->store[protected] = load;
+			cache->target[protected] = page;
+			cpu->pages[protected].store = NULL;
+			cpu->pages[protected].mmio = &i8080_block_code;
+			cpu->clean[protected] = NULL;
+		}
+	}
+
+	cache->decoded[page] = true;
+
+	return true;
+}
+
+/* Polling loops: blocks jumping back to their own start, whose other instructions are pure. As memory is never written,
+ * an iteration which leaves the registers as they were at the start will be repeated identically until an event */
+static bool
+i8080_block_is_idle(const struct i8080_block_instruction *instructions, unsigned count, uint16_t address) {
+	const struct i8080_block_instruction * const last = instructions + count - 1;
+
+	if(last->opcode != 0xC3 && last->opcode != 0xCB && (last->opcode & 0xC7) != 0xC2) { /* JMP and conditional jumps */
+		return false;
+	}
+
+	if(last->imm.a16 != address) {
+		return false;
+	}
+
+	for(const struct i8080_block_instruction *current = instructions; current != last; current++) {
+		if(!i8080_block_is_pure(current->opcode)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static struct i8080_block *
+i8080_block_translate(struct i8080_cpu *cpu, struct i8080_block_cache *cache) {
+	struct i8080_block_instruction instructions[I8080_PAGE_SIZE];
+	const unsigned page = cpu->pc / I8080_PAGE_SIZE, begin = cpu->pc % I8080_PAGE_SIZE;
+	const uint8_t * const load = cpu->pages[page].load;
+	unsigned offset = begin, count = 0, cycles = 0, head = 0;
+	struct i8080_block *block;
+
+	if(!i8080_block_protect(cpu, cache, page)) {
+		return NULL;
+	}
+
+	while(offset < I8080_PAGE_SIZE) {
+		const uint8_t opcode = load[offset];
+		const struct i8080_instruction * const instruction = i8080_instruction_info(opcode);
+		struct i8080_block_instruction * const current = instructions + count;
+
+		if(offset + instruction->length > I8080_PAGE_SIZE) {
+			break;
+		}
+
+		current->execute = instruction->execute;
+		current->opcode = opcode;
+		current->length = instruction->length;
+		current->nojump = instruction->nojump;
+		current->onjump = instruction->onjump;
+
+		switch(instruction->length) {
+		case 2:
+			current->imm.d8 = load[offset + 1];
+			break;
+		case 3:
+			current->imm.d16 = (uint16_t)load[offset + 2] << 8 | load[offset + 1];
+			break;
+		default:
+			current->imm.d16 = 0;
+			break;
+		}
+
+		head = cycles;
+		cycles += instruction->nojump;
+		offset += instruction->length;
+		count++;
+
+		if(i8080_block_is_terminator(opcode, instruction)) {
+			break;
+		}
+	}
+
+	if(count == 0) { /* First instruction crosses the page end */
+		return NULL;
+	}
+
+	block = malloc(sizeof(*block) + count * sizeof(*instructions));
+	if(block == NULL) {
+		return NULL;
+	}
+
+	block->next = NULL;
+	block->cycles = cycles;
+	block->head = head;
+	block->idle = i8080_block_is_idle(instructions, count, cpu->pc);
+#ifdef I8080_JIT
+	block->executions = 0;
+	block->native = NULL;
+	block->chain = NULL;
+#endif
+	block->count = count;
+	memcpy(block->instructions, instructions, count * sizeof(*instructions));
+
+	for(unsigned byte = page * I8080_PAGE_SIZE + begin; byte < page * I8080_PAGE_SIZE + offset; byte++) {
+		cache->code[byte / 8] |= 1 << byte % 8;
+	}
+
+	cache->blocks[cpu->pc] = block;
+
+	return block;
+}
+
+/* Translated code does not profile, count nor trace instructions, interpreted blocks do */
+static inline bool
+i8080_block_is_instrumented(const struct i8080_cpu *cpu) {
+	return cpu->profile != NULL || cpu->histogram != NULL || cpu->trace != NULL;
+}
+
+/* Single instruction fallback, for code which cannot be cached or blocks which would overrun the deadline */
+static void
+i8080_block_step(struct i8080_cpu *cpu) {
+	const struct i8080_instruction *instruction;
+	const uint16_t address = cpu->pc;
+	union i8080_imm imm = { };
+	unsigned cycles;
+	uint8_t opcode;
+
+	i8080_cpu_load8(cpu, address, &opcode);
+	instruction = i8080_instruction_info(opcode);
+
+	switch(instruction->length) {
+	case 2:
+		i8080_cpu_load8(cpu, address + 1, &imm.d8);
+		break;
+	case 3:
+		i8080_cpu_load16(cpu, address + 1, &imm.d16);
+		break;
+	default:
+		break;
+	}
+
+	cpu->pc += instruction->length;
+
+	if(!instruction->execute(cpu, imm)) { /* nojump */
+		cycles = instruction->nojump;
+	} else { /* onjump */
+		cycles = instruction->onjump;
+	}
+
+	cpu->uptime_cycles += cycles;
+
+	I8080_PROFILE_ACCOUNT(cpu, address, opcode, cpu->pc, cpu->sp, cycles);
+	I8080_HISTOGRAM_COUNT(cpu, opcode);
+	I8080_TRACE_STEP(cpu, address, opcode, instruction->length, imm, cycles);
+}
+
+static inline void
+i8080_block_execute(struct i8080_cpu *cpu, struct i8080_block_cache *cache, const struct i8080_block *block) {
+	const struct i8080_block_instruction *current = block->instructions,
+		* const last = current + block->count - 1;
+	uint16_t address;
+
+	cpu->uptime_cycles += block->cycles;
+
+	while(current != last) {
+		cpu->pc += current->length;
+		current->execute(cpu, current->imm);
+		I8080_PROFILE_ACCOUNT(cpu, cpu->pc - current->length, current->opcode, cpu->pc, cpu->sp, current->nojump);
+		I8080_HISTOGRAM_COUNT(cpu, current->opcode);
+		I8080_TRACE_STEP(cpu, cpu->pc - current->length, current->opcode, current->length, current->imm, current->nojump);
+		current++;
+
+		if(cache->garbage != NULL) { /* The block modified decoded code, remaining instructions are stale */
+			while(current <= last) {
+				cpu->uptime_cycles -= current->nojump;
+				current++;
+			}
+			return;
+		}
+	}
+
+	I8080_HISTOGRAM_COUNT(cpu, last->opcode);
+
+	/* Io handlers may drop the block, but it is only freed between blocks, so its last instruction is still read once run */
+	address = cpu->pc;
+	cpu->pc += last->length;
+	if(last->execute(cpu, last->imm)) {
+		cpu->uptime_cycles += last->onjump - last->nojump;
+		I8080_PROFILE_ACCOUNT(cpu, address, last->opcode, cpu->pc, cpu->sp, last->onjump);
+		I8080_TRACE_STEP(cpu, address, last->opcode, last->length, last->imm, last->onjump);
+	} else {
+		I8080_PROFILE_ACCOUNT(cpu, address, last->opcode, cpu->pc, cpu->sp, last->nojump);
+		I8080_TRACE_STEP(cpu, address, last->opcode, last->length, last->imm, last->nojump);
+	}
+}
+
+/* Runs one iteration of an idle block. If it left the registers unchanged, every following iteration
+ * would too, so the iterations ending before the deadline are skipped at once. Direct reads of pages without
+ * host memory may have side effects, loops doing them are always run */
+static void
+i8080_block_idle(struct i8080_cpu *cpu, struct i8080_block_cache *cache, const struct i8080_block *block, uint64_t deadline) {
+	const uint16_t address = cpu->pc, b = cpu->registers.pair.b, d = cpu->registers.pair.d,
+		h = cpu->registers.pair.h, psw = cpu->registers.pair.psw, sp = cpu->sp;
+	const uint64_t start = cpu->uptime_cycles;
+	uint64_t iteration, iterations;
+
+	for(unsigned i = 0; i < block->count; i++) {
+		const struct i8080_block_instruction * const instruction = block->instructions + i;
+
+		if((instruction->opcode == 0x2A || instruction->opcode == 0x3A)
+			&& (cpu->pages[instruction->imm.a16 / I8080_PAGE_SIZE].load == NULL
+				|| cpu->pages[(uint16_t)(instruction->imm.a16 + 1) / I8080_PAGE_SIZE].load == NULL)) {
+			i8080_block_execute(cpu, cache, block);
+			return;
+		}
+	}
+
+	i8080_block_execute(cpu, cache, block);
+
+	if(cpu->pc != address || cpu->uptime_cycles >= deadline || cache->garbage != NULL
+		|| cpu->registers.pair.b != b || cpu->registers.pair.d != d || cpu->registers.pair.h != h
+		|| cpu->registers.pair.psw != psw || cpu->sp != sp) {
+		return;
+	}
+
+	iteration = cpu->uptime_cycles - start;
+	iterations = (deadline - cpu->uptime_cycles) / iteration;
+
+	cpu->uptime_cycles += iterations * iteration;
+	cache->stats.skipped += iterations * iteration;
+	I8080_TRACE_SKIP(cpu);
+}
+
+int
+i8080_block_cache_create(struct i8080_cpu *cpu, bool jit) {
+	struct i8080_block_cache *cache;
+
+#ifndef I8080_JIT
+	if(jit) {
+		return -1;
+	}
+#endif
+
+	cache = calloc(1, sizeof(*cache));
+	if(cache == NULL) {
+		return -1;
+	}
+
+#ifdef I8080_JIT
+	if(jit && (cache->jit = i8080_jit_create()) == NULL) {
+		free(cache);
+		return -1;
+	}
+#endif
+
+	cpu->blocks = cache;
+
+	return 0;
+}
+
+void
+i8080_block_cache_destroy(struct i8080_cpu *cpu) {
+
+	i8080_block_invalidate(cpu, 0x0000, I8080_MEMORY_SIZE);
+	i8080_block_collect(cpu->blocks);
+
+#ifdef I8080_JIT
+	if(cpu->blocks->jit != NULL) {
+		i8080_jit_destroy(cpu->blocks->jit);
+	}
+#endif
+
+	free(cpu->blocks);
+	cpu->blocks = NULL;
+}
+
+void
+i8080_block_cache_stats(const struct i8080_cpu *cpu, struct i8080_block_stats *stats) {
+	*stats = cpu->blocks->stats;
+}
+
+void
+i8080_block_set_idle_skip(struct i8080_cpu *cpu, bool enabled) {
+	cpu->blocks->idle_skip = enabled;
+}
+
+void
+i8080_block_invalidate(struct i8080_cpu *cpu, uint16_t address, size_t size) {
+	struct i8080_block_cache * const cache = cpu->blocks;
+
+	if(size == 0) {
+		return;
+	}
+
+	for(unsigned page = address / I8080_PAGE_SIZE; page <= (address + size - 1) / I8080_PAGE_SIZE && page < I8080_PAGE_COUNT; page++) {
+		if(cache->decoded[page]) {
+			i8080_block_invalidate_page(cpu, cache, page);
+		}
+	}
+}
+
+void
+i8080_block_run(struct i8080_cpu *cpu, uint64_t deadline) {
+	struct i8080_block_cache * const cache = cpu->blocks;
+
+	while(!cpu->stopped && !cpu->yield && cpu->uptime_cycles < deadline) {
+		struct i8080_block *block;
+
+		if(cache->garbage != NULL) {
+			i8080_block_collect(cache);
+		}
+
+		block = cache->blocks[cpu->pc];
+		if(block != NULL) {
+			cache->stats.hits++;
+		} else {
+			cache->stats.misses++;
+			block = i8080_block_translate(cpu, cache);
+		}
+
+		/* The last instruction of a block is started before the deadline, as with the other engines */
+		if(block == NULL || cpu->uptime_cycles + block->head >= deadline) {
+			i8080_block_step(cpu);
+			continue;
+		}
+
+		if(block->idle && cache->idle_skip) { /* Never translated, native code would spin in it */
+			i8080_block_idle(cpu, cache, block, deadline);
+			continue;
+		}
+
+#ifdef I8080_JIT
+		if(cache->jit != NULL && !i8080_block_is_instrumented(cpu) && block->native == NULL && ++block->executions == I8080_JIT_THRESHOLD
+			&& cache->rewrites[cpu->pc / I8080_PAGE_SIZE] < I8080_JIT_REWRITES_MAX
+			&& i8080_jit_translate(cache, block, cpu->pc) != 0) {
+			/* Code buffer is full, drop every block to start over */
+			i8080_block_invalidate(cpu, 0x0000, I8080_MEMORY_SIZE);
+			i8080_jit_reset(cache->jit);
+			continue;
+		}
+
+		if(block->native != NULL && !i8080_block_is_instrumented(cpu)) {
+			block->native(cpu, deadline);
+			continue;
+		}
+#endif
+
+		i8080_block_execute(cpu, cache, block);
+	}
+}
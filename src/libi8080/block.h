@@ -0,0 +1,101 @@
+#ifndef I8080_BLOCK_H
+#define I8080_BLOCK_H
+
+#include "i8080/cpu.h"
+
+/* A block is a straight-line run of instructions predecoded from a single page. Only its last
+ * instruction may jump, halt or call io handlers. Blocks are keyed by their start address, and
+ * the pages their code is read from are write protected: the stores are redirected to an mmio handler
+ * which drops the blocks of the page when a decoded byte is written. */
+
+struct i8080_block_instruction {
+	bool (*execute)(struct i8080_cpu *, union i8080_imm);
+	union i8080_imm imm;
+	uint8_t opcode, length, nojump, onjump;
+};
+
+struct i8080_block {
+	struct i8080_block *next; /* Garbage list link once invalidated */
+	unsigned cycles;          /* Sum of the nojump cycles of all instructions */
+	unsigned head;            /* Sum of the nojump cycles of all instructions but the last */
+	bool idle;                /* Polling loop, see i8080_block_is_idle */
+#ifdef I8080_JIT
+	unsigned executions;
+	void (*native)(struct i8080_cpu *, uint64_t deadline);
+	const void *chain; /* Body of the native code, entered from other translated blocks */
+#endif
+	unsigned count;
+	struct i8080_block_instruction instructions[];
+};
+
+struct i8080_block_cache {
+	struct i8080_block_stats stats;
+	struct i8080_block *garbage;         /* Invalidated blocks, freed once none of them can be executing */
+	bool idle_skip;                      /* Idle blocks are skipped up to the deadline */
+#ifdef I8080_JIT
+	struct i8080_jit *jit;               /* Translator of hot blocks, if enabled */
+	uint8_t rewrites[I8080_PAGE_COUNT];  /* Invalidations by self-modifying stores, saturating */
+#endif
+	uint8_t *store[I8080_PAGE_COUNT];    /* Original store mapping of write protected pages */
+	uint8_t target[I8080_PAGE_COUNT];    /* Code page written through a write protected page */
+	bool decoded[I8080_PAGE_COUNT];      /* Pages with at least one cached block */
+	uint8_t code[I8080_MEMORY_SIZE / 8]; /* Bytes decoded in cached blocks */
+	struct i8080_block *blocks[I8080_MEMORY_SIZE];
+};
+
+static inline bool
+i8080_block_is_terminator(uint8_t opcode, const struct i8080_instruction *instruction) {
+	return instruction->onjump != 0 /* Jumps, calls, returns and restarts */
+		|| opcode == 0x76 /* HLT */
+		|| opcode == 0xD3 || opcode == 0xDB; /* OUT and IN may yield */
+}
+
+/* Instructions which neither write memory nor call io handlers, and only read memory at a direct address */
+static inline bool
+i8080_block_is_pure(uint8_t opcode) {
+	const unsigned destination = opcode >> 3 & 0x07, source = opcode & 0x07;
+
+	switch(opcode >> 6) {
+	case 0:
+		switch(source) {
+		case 2: /* Only LHLD and LDA, no STAX, LDAX, SHLD nor STA */
+			return opcode == 0x2A || opcode == 0x3A;
+		case 4: /* INR */
+		case 5: /* DCR */
+		case 6: /* MVI */
+			return destination != 6;
+		default: /* NOP, LXI, DAD, INX, DCX, rotates, DAA, CMA, STC, CMC */
+			return true;
+		}
+	case 1: /* MOV, HLT included in MOV M M */
+		return destination != 6 && source != 6;
+	case 2: /* Arithmetic and logic on registers */
+		return source != 6;
+	default: /* Arithmetic and logic on immediates, XCHG and SPHL */
+		return source == 6 || opcode == 0xEB || opcode == 0xF9;
+	}
+}
+
+/* Creates the block cache of the cpu, with a translator of hot blocks to native code if jit is set */
+int
+i8080_block_cache_create(struct i8080_cpu *cpu, bool jit);
+
+void
+i8080_block_cache_destroy(struct i8080_cpu *cpu);
+
+void
+i8080_block_cache_stats(const struct i8080_cpu *cpu, struct i8080_block_stats *stats);
+
+/* Drops the blocks decoded from the given address range. They may still be executing, so they are only freed by the next run */
+void
+i8080_block_invalidate(struct i8080_cpu *cpu, uint16_t address, size_t size);
+
+void
+i8080_block_set_idle_skip(struct i8080_cpu *cpu, bool enabled);
+
+/* Executes cached blocks until the cpu stops, yields or its uptime reaches deadline */
+void
+i8080_block_run(struct i8080_cpu *cpu, uint64_t deadline);
+
+/* I8080_BLOCK_H */
+#endif
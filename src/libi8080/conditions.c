@@ -0,0 +1,19 @@
+#include "conditions.h"
+
+/* The following macros expand, at build time, the sign, zero, parity and carry conditions
+ * of every 9 bits result, the ninth bit being the carry (or borrow) out of the operation */
+#define I8080_CONDITIONS_SZPC(res) (\
+	I8080_CONDITION_SIGN((uint8_t)(res))\
+	| I8080_CONDITION_ZERO((uint8_t)(res))\
+	| I8080_CONDITION_PARITY((uint8_t)(res))\
+	| ((res) >> 8) << I8080_BIT_CONDITION_CARRY)
+
+#define I8080_CONDITIONS_SZPC_4(res)   I8080_CONDITIONS_SZPC(res), I8080_CONDITIONS_SZPC((res) + 1), I8080_CONDITIONS_SZPC((res) + 2), I8080_CONDITIONS_SZPC((res) + 3)
+#define I8080_CONDITIONS_SZPC_16(res)  I8080_CONDITIONS_SZPC_4(res), I8080_CONDITIONS_SZPC_4((res) + 4), I8080_CONDITIONS_SZPC_4((res) + 8), I8080_CONDITIONS_SZPC_4((res) + 12)
+#define I8080_CONDITIONS_SZPC_64(res)  I8080_CONDITIONS_SZPC_16(res), I8080_CONDITIONS_SZPC_16((res) + 16), I8080_CONDITIONS_SZPC_16((res) + 32), I8080_CONDITIONS_SZPC_16((res) + 48)
+#define I8080_CONDITIONS_SZPC_256(res) I8080_CONDITIONS_SZPC_64(res), I8080_CONDITIONS_SZPC_64((res) + 64), I8080_CONDITIONS_SZPC_64((res) + 128), I8080_CONDITIONS_SZPC_64((res) + 192)
+
+const uint8_t i8080_conditions_szpc[0x200] = {
+	I8080_CONDITIONS_SZPC_256(0x000),
+	I8080_CONDITIONS_SZPC_256(0x100),
+};
@@ -0,0 +1,80 @@
+#ifndef I8080_CONDITIONS_H
+#define I8080_CONDITIONS_H
+
+#include "i8080/cpu.h"
+
+/* The following macros are the reference definitions of conditions, they generate the lookup tables
+ * declared below, which are used by the engines */
+
+/* The following macro detects if a carry was emitted at bit during the addition of lhs and rhs which lead to res */
+#define I8080_CARRY_OUT(lhs, rhs, res, bit) ((~(res) & ((lhs) | (rhs)) | (lhs) & (rhs)) >> (bit) & 1)
+
+/* The following macros generate the condition bit if the condition is met for the given operand */
+#define I8080_CONDITION_CARRY(lhs, rhs, res)           (I8080_CARRY_OUT(lhs, rhs, res, sizeof(res) * 8 - 1) << I8080_BIT_CONDITION_CARRY)
+#define I8080_CONDITION_PARITY(res)                    (!__builtin_parity(res) << I8080_BIT_CONDITION_PARITY)
+#define I8080_CONDITION_AUXILIARY_CARRY(lhs, rhs, res) (I8080_CARRY_OUT(lhs, rhs, res, 3) << I8080_BIT_CONDITION_AUXILIARY_CARRY)
+#define I8080_CONDITION_ZERO(res)                      (!(res) << I8080_BIT_CONDITION_ZERO)
+#define I8080_CONDITION_SIGN(res)                      (((res) >> (sizeof(res) * 8 - 1)) << I8080_BIT_CONDITION_SIGN)
+
+#define I8080_CONDITION_AUXILIARY_BORROW(lhs, rhs, res) I8080_CONDITION_AUXILIARY_CARRY(lhs, ~(rhs), res)
+#define I8080_CONDITION_BORROW(lhs, rhs, res) (I8080_CONDITION_CARRY(lhs, ~(rhs), res) ^ I8080_MASK_CONDITION_CARRY)
+
+/* The following masks help erase condition flags in several instruction (eg. INR, DCR...) */
+#define I8080_MASK_CONDITIONS_SZ_A_P__ (I8080_MASK_CONDITION_SIGN |\
+                                        I8080_MASK_CONDITION_ZERO |\
+                                        I8080_MASK_CONDITION_AUXILIARY_CARRY |\
+                                        I8080_MASK_CONDITION_PARITY)
+
+#define I8080_MASK_CONDITIONS_SZ_A_P_C (I8080_MASK_CONDITIONS_SZ_A_P__ | I8080_MASK_CONDITION_CARRY)
+
+/* Sign, zero, parity and carry conditions indexed by a 9 bits result, generated at build time */
+extern const uint8_t i8080_conditions_szpc[0x200];
+
+/* The following functions compute conditions through i8080_conditions_szpc, the auxiliary carry
+ * is the carry into bit 4, recovered from the operands and result without the need for a table */
+
+static inline uint8_t
+i8080_conditions_szp(uint8_t res) {
+	return i8080_conditions_szpc[res];
+}
+
+static inline uint8_t
+i8080_conditions_add(uint8_t lhs, uint8_t rhs, unsigned carry) {
+	const unsigned res = lhs + rhs + carry;
+
+	return i8080_conditions_szpc[res]
+		| (lhs ^ rhs ^ res) & I8080_MASK_CONDITION_AUXILIARY_CARRY;
+}
+
+static inline uint8_t
+i8080_conditions_sub(uint8_t lhs, uint8_t rhs, unsigned borrow) {
+	const unsigned res = lhs - rhs - borrow;
+
+	return i8080_conditions_szpc[res & 0x1FF]
+		| ~(lhs ^ rhs ^ res) & I8080_MASK_CONDITION_AUXILIARY_CARRY;
+}
+
+static inline uint8_t
+i8080_conditions_inr(uint8_t dst) {
+	const uint8_t res = dst + 1;
+
+	return i8080_conditions_szpc[res]
+		| (dst ^ res) & I8080_MASK_CONDITION_AUXILIARY_CARRY;
+}
+
+static inline uint8_t
+i8080_conditions_dcr(uint8_t dst) {
+	const uint8_t res = dst - 1;
+
+	return i8080_conditions_szpc[res]
+		| ~(dst ^ res) & I8080_MASK_CONDITION_AUXILIARY_CARRY;
+}
+
+static inline uint8_t
+i8080_conditions_ana(uint8_t lhs, uint8_t rhs) {
+	return i8080_conditions_szpc[lhs & rhs]
+		| (lhs | rhs) << (I8080_BIT_CONDITION_AUXILIARY_CARRY - 3) & I8080_MASK_CONDITION_AUXILIARY_CARRY;
+}
+
+/* I8080_CONDITIONS_H */
+#endif
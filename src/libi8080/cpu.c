@@ -1,88 +1,18 @@
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 #include "i8080/cpu.h"
 
-/* The following macro detects if a carry was emitted at bit during the addition of lhs and rhs which lead to res */
-#define I8080_CARRY_OUT(lhs, rhs, res, bit) ((~(res) & ((lhs) | (rhs)) | (lhs) & (rhs)) >> (bit) & 1)
-
-/* The following macros generate the condition bit if the condition is met for the given operand */
-#define I8080_CONDITION_CARRY(lhs, rhs, res)           (I8080_CARRY_OUT(lhs, rhs, res, sizeof(res) * 8 - 1) << I8080_BIT_CONDITION_CARRY)
-#define I8080_CONDITION_PARITY(res)                    (!__builtin_parity(res) << I8080_BIT_CONDITION_PARITY)
-#define I8080_CONDITION_AUXILIARY_CARRY(lhs, rhs, res) (I8080_CARRY_OUT(lhs, rhs, res, 3) << I8080_BIT_CONDITION_AUXILIARY_CARRY)
-#define I8080_CONDITION_ZERO(res)                      (!(res) << I8080_BIT_CONDITION_ZERO)
-#define I8080_CONDITION_SIGN(res)                      (((res) >> (sizeof(res) * 8 - 1)) << I8080_BIT_CONDITION_SIGN)
-
-#define I8080_CONDITION_AUXILIARY_BORROW(lhs, rhs, res) I8080_CONDITION_AUXILIARY_CARRY(lhs, ~(rhs), res)
-#define I8080_CONDITION_BORROW(lhs, rhs, res) (I8080_CONDITION_CARRY(lhs, ~(rhs), res) ^ I8080_MASK_CONDITION_CARRY)
-
-/* The following masks help erase condition flags in several instruction (eg. INR, DCR...) */
-#define I8080_MASK_CONDITIONS_SZ_A_P__ (I8080_MASK_CONDITION_SIGN |\
-                                        I8080_MASK_CONDITION_ZERO |\
-                                        I8080_MASK_CONDITION_AUXILIARY_CARRY |\
-                                        I8080_MASK_CONDITION_PARITY)
-
-#define I8080_MASK_CONDITIONS_SZ_A_P_C (I8080_MASK_CONDITIONS_SZ_A_P__ | I8080_MASK_CONDITION_CARRY)
-
-/*****************
- * Memory access *
- *****************/
-
-static inline void
-i8080_cpu_store8(struct i8080_cpu *cpu, uint16_t address, uint8_t src) {
-	const struct i8080_rom_section *section = cpu->rom_map;
-
-	if(section != NULL) {
-		while(section->begin != section->end
-			&& (address < section->begin || address >= section->end)) {
-			section++;
-		}
-
-		if(section->begin != section->end) {
-			return;
-		}
-	}
-
-	cpu->memory[address] = src;
-}
-
-static inline void
-i8080_cpu_store16(struct i8080_cpu *cpu, uint16_t address, uint16_t src) {
-	const struct i8080_rom_section *section = cpu->rom_map;
-
-	if(section != NULL) {
-		while(section->begin != section->end
-			&& (address < section->begin - 1 || address >= section->end)) {
-			section++;
-		}
-
-		if(section->begin != section->end) {
-			if(address < section->begin) {
-				cpu->memory[address] = src;
-			}
-			if(address == section->end - 1) {
-				cpu->memory[address + 1] = src >> 8;
-			}
-			return;
-		}
-	}
-
-	cpu->memory[address] = src;
-	cpu->memory[address + 1] = src >> 8;
-}
-
-static inline void
-i8080_cpu_load8(const struct i8080_cpu *cpu, uint16_t address, uint8_t *dst) {
-	*dst = cpu->memory[address];
-}
-
-static inline void
-i8080_cpu_load16(const struct i8080_cpu *cpu, uint16_t address, uint16_t *dst) {
-	if(address != 0xFFFF) {
-		*dst = (uint16_t)cpu->memory[address + 1] << 8 | cpu->memory[address];
-	} else {
-		*dst = cpu->memory[address];
-	}
-}
+#include "threaded.h"
+#include "block.h"
+#include "lockstep.h"
+#include "events.h"
+#include "profile.h"
+#include "histogram.h"
+#include "trace.h"
+#include "conditions.h"
+#include "memory.h"
 
 /*********************************
  * Instructions and opcode table *
@@ -185,14 +115,10 @@ i8080_cpu_instruction_inx_sp(struct i8080_cpu *cpu, union i8080_imm imm) {
 
 static inline bool
 i8080_cpu_instruction_inr(struct i8080_cpu *cpu, uint8_t *dst) {
-	const uint8_t res = *dst + 1;
 
 	cpu->registers.f = cpu->registers.f & ~I8080_MASK_CONDITIONS_SZ_A_P__
-		| I8080_CONDITION_SIGN(res)
-		| I8080_CONDITION_ZERO(res)
-		| I8080_CONDITION_AUXILIARY_CARRY(*dst, 1, res)
-		| I8080_CONDITION_PARITY(res);
-	*dst = res;
+		| i8080_conditions_inr(*dst);
+	*dst += 1;
 
 	return false;
 }
@@ -248,14 +174,10 @@ i8080_cpu_instruction_inr_a(struct i8080_cpu *cpu, union i8080_imm imm) {
 
 static inline bool
 i8080_cpu_instruction_dcr(struct i8080_cpu *cpu, uint8_t *dst) {
-	const uint8_t res = *dst - 1;
 
 	cpu->registers.f = cpu->registers.f & ~I8080_MASK_CONDITIONS_SZ_A_P__
-		| I8080_CONDITION_SIGN(res)
-		| I8080_CONDITION_ZERO(res)
-		| I8080_CONDITION_AUXILIARY_BORROW(*dst, 1, res)
-		| I8080_CONDITION_PARITY(res);
-	*dst = res;
+		| i8080_conditions_dcr(*dst);
+	*dst -= 1;
 
 	return false;
 }
@@ -390,10 +312,10 @@ i8080_cpu_instruction_rlc(struct i8080_cpu *cpu, union i8080_imm imm) {
 
 static inline bool
 i8080_cpu_instruction_dad(struct i8080_cpu *cpu, uint16_t src) {
-	const uint16_t sum = cpu->registers.pair.h + src;
+	const uint32_t sum = (uint32_t)cpu->registers.pair.h + src;
 
 	cpu->registers.f = cpu->registers.f & ~I8080_MASK_CONDITION_CARRY
-		| I8080_CONDITION_CARRY(cpu->registers.pair.h, src, sum);
+		| sum >> 16 << I8080_BIT_CONDITION_CARRY;
 	cpu->registers.pair.h = sum;
 
 	return false;
@@ -543,10 +465,8 @@ i8080_cpu_instruction_daa(struct i8080_cpu *cpu, union i8080_imm imm) {
 	const uint8_t res = cpu->registers.a + src;
 
 	cpu->registers.f = cpu->registers.f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
-		| I8080_CONDITION_SIGN(res)
-		| I8080_CONDITION_ZERO(res)
-		| I8080_CONDITION_AUXILIARY_CARRY(cpu->registers.a, src, res)
-		| I8080_CONDITION_PARITY(res)
+		| i8080_conditions_szp(res)
+		| (cpu->registers.a ^ src ^ res) & I8080_MASK_CONDITION_AUXILIARY_CARRY
 		| carry;
 	cpu->registers.a = res;
 
@@ -1133,15 +1053,10 @@ i8080_cpu_instruction_hlt(struct i8080_cpu *cpu, union i8080_imm imm) {
 
 static inline bool
 i8080_cpu_instruction_add(struct i8080_cpu *cpu, uint8_t src) {
-	const uint8_t res = cpu->registers.a + src;
 
 	cpu->registers.f = cpu->registers.f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
-		| I8080_CONDITION_SIGN(res)
-		| I8080_CONDITION_ZERO(res)
-		| I8080_CONDITION_AUXILIARY_CARRY(cpu->registers.a, src, res)
-		| I8080_CONDITION_PARITY(res)
-		| I8080_CONDITION_CARRY(cpu->registers.a, src, res);
-	cpu->registers.a = res;
+		| i8080_conditions_add(cpu->registers.a, src, 0);
+	cpu->registers.a += src;
 
 	return false;
 }
@@ -1201,19 +1116,11 @@ i8080_cpu_instruction_adi_d8(struct i8080_cpu *cpu, union i8080_imm imm) {
 
 static inline bool
 i8080_cpu_instruction_adc(struct i8080_cpu *cpu, uint8_t src) {
-	const uint8_t carry = !!(cpu->registers.f & I8080_MASK_CONDITION_CARRY);
-	const uint8_t propagated = src + carry;
-	const uint8_t res = cpu->registers.a + propagated;
+	const uint8_t carry = (cpu->registers.f & I8080_MASK_CONDITION_CARRY) >> I8080_BIT_CONDITION_CARRY;
 
 	cpu->registers.f = cpu->registers.f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
-		| I8080_CONDITION_SIGN(res)
-		| I8080_CONDITION_ZERO(res)
-		| I8080_CONDITION_AUXILIARY_CARRY(cpu->registers.a, propagated, res)
-			^ I8080_CONDITION_AUXILIARY_CARRY(src, carry, propagated)
-		| I8080_CONDITION_PARITY(res)
-		| I8080_CONDITION_CARRY(cpu->registers.a, propagated, res)
-			^ I8080_CONDITION_CARRY(src, carry, propagated);
-	cpu->registers.a = res;
+		| i8080_conditions_add(cpu->registers.a, src, carry);
+	cpu->registers.a += src + carry;
 
 	return false;
 }
@@ -1273,15 +1180,10 @@ i8080_cpu_instruction_aci_d8(struct i8080_cpu *cpu, union i8080_imm imm) {
 
 static inline bool
 i8080_cpu_instruction_sub(struct i8080_cpu *cpu, uint8_t src) {
-	const uint8_t res = cpu->registers.a - src;
 
 	cpu->registers.f = cpu->registers.f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
-		| I8080_CONDITION_SIGN(res)
-		| I8080_CONDITION_ZERO(res)
-		| I8080_CONDITION_AUXILIARY_BORROW(cpu->registers.a, src, res)
-		| I8080_CONDITION_PARITY(res)
-		| I8080_CONDITION_BORROW(cpu->registers.a, src, res);
-	cpu->registers.a = res;
+		| i8080_conditions_sub(cpu->registers.a, src, 0);
+	cpu->registers.a -= src;
 
 	return false;
 }
@@ -1341,19 +1243,11 @@ i8080_cpu_instruction_sui_d8(struct i8080_cpu *cpu, union i8080_imm imm) {
 
 static inline bool
 i8080_cpu_instruction_sbb(struct i8080_cpu *cpu, uint8_t src) {
-	const uint8_t carry = !!(cpu->registers.f & I8080_MASK_CONDITION_CARRY);
-	const uint8_t propagated = src + carry;
-	const uint8_t res = cpu->registers.a - propagated;
+	const uint8_t borrow = (cpu->registers.f & I8080_MASK_CONDITION_CARRY) >> I8080_BIT_CONDITION_CARRY;
 
 	cpu->registers.f = cpu->registers.f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
-		| I8080_CONDITION_SIGN(res)
-		| I8080_CONDITION_ZERO(res)
-		| I8080_CONDITION_AUXILIARY_BORROW(cpu->registers.a, propagated, res)
-			^ I8080_CONDITION_AUXILIARY_CARRY(src, carry, propagated)
-		| I8080_CONDITION_PARITY(res)
-		| I8080_CONDITION_BORROW(cpu->registers.a, propagated, res)
-			^ I8080_CONDITION_CARRY(src, carry, propagated);
-	cpu->registers.a = res;
+		| i8080_conditions_sub(cpu->registers.a, src, borrow);
+	cpu->registers.a -= src + borrow;
 
 	return false;
 }
@@ -1413,14 +1307,10 @@ i8080_cpu_instruction_sbi_d8(struct i8080_cpu *cpu, union i8080_imm imm) {
 
 static inline bool
 i8080_cpu_instruction_ana(struct i8080_cpu *cpu, uint8_t src) {
-	const uint8_t res = cpu->registers.a & src;
 
 	cpu->registers.f = cpu->registers.f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
-		| I8080_CONDITION_SIGN(res)
-		| I8080_CONDITION_ZERO(res)
-		| I8080_CONDITION_AUXILIARY_CARRY(cpu->registers.a, src, res)
-		| I8080_CONDITION_PARITY(res);
-	cpu->registers.a = res;
+		| i8080_conditions_ana(cpu->registers.a, src);
+	cpu->registers.a &= src;
 
 	return false;
 }
@@ -1483,9 +1373,7 @@ i8080_cpu_instruction_xra(struct i8080_cpu *cpu, uint8_t src) {
 	const uint8_t res = cpu->registers.a ^ src;
 
 	cpu->registers.f = cpu->registers.f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
-		| I8080_CONDITION_SIGN(res)
-		| I8080_CONDITION_ZERO(res)
-		| I8080_CONDITION_PARITY(res);
+		| i8080_conditions_szp(res);
 	cpu->registers.a = res;
 
 	return false;
@@ -1549,9 +1437,7 @@ i8080_cpu_instruction_ora(struct i8080_cpu *cpu, uint8_t src) {
 	const uint8_t res = cpu->registers.a | src;
 
 	cpu->registers.f = cpu->registers.f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
-		| I8080_CONDITION_SIGN(res)
-		| I8080_CONDITION_ZERO(res)
-		| I8080_CONDITION_PARITY(res);
+		| i8080_conditions_szp(res);
 	cpu->registers.a = res;
 
 	return false;
@@ -1612,14 +1498,9 @@ i8080_cpu_instruction_ori_d8(struct i8080_cpu *cpu, union i8080_imm imm) {
 
 static inline bool
 i8080_cpu_instruction_cmp(struct i8080_cpu *cpu, uint8_t src) {
-	const uint8_t res = cpu->registers.a - src;
 
 	cpu->registers.f = cpu->registers.f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
-		| I8080_CONDITION_SIGN(res)
-		| I8080_CONDITION_ZERO(res)
-		| I8080_CONDITION_AUXILIARY_BORROW(cpu->registers.a, src, res)
-		| I8080_CONDITION_PARITY(res)
-		| I8080_CONDITION_BORROW(cpu->registers.a, src, res);
+		| i8080_conditions_sub(cpu->registers.a, src, 0);
 
 	return false;
 }
@@ -2424,61 +2305,679 @@ i8080_cpu_init(struct i8080_cpu *cpu, const struct i8080_io *io) {
 	cpu->registers.f = I8080_MASK_CONDITION_UNUSED1;
 	cpu->io = io;
 
+	i8080_cpu_map(cpu, 0x0000, I8080_MEMORY_SIZE, cpu->memory, cpu->memory);
+
 	return 0;
 }
 
 int
 i8080_cpu_deinit(struct i8080_cpu *cpu) {
+
+	if(cpu->blocks != NULL) {
+		i8080_block_cache_destroy(cpu);
+	}
+
+	i8080_cpu_profile_stop(cpu);
+	i8080_cpu_histogram_stop(cpu);
+	i8080_cpu_trace_stop(cpu);
+
 	return 0;
 }
 
 int
-i8080_cpu_next(struct i8080_cpu *cpu) {
-	const struct i8080_instruction *instruction = instructions + cpu->memory[cpu->pc];
+i8080_cpu_set_engine(struct i8080_cpu *cpu, enum i8080_engine engine) {
+
+	switch(engine) {
+	case I8080_ENGINE_TABLE:
+	case I8080_ENGINE_THREADED:
+	case I8080_ENGINE_BLOCK:
+	case I8080_ENGINE_JIT:
+		break;
+	default:
+		return -1;
+	}
+
+	if(cpu->blocks != NULL) {
+		i8080_block_cache_destroy(cpu);
+	}
+
+	if((engine == I8080_ENGINE_BLOCK || engine == I8080_ENGINE_JIT)
+		&& i8080_block_cache_create(cpu, engine == I8080_ENGINE_JIT) != 0) {
+		return -1;
+	}
+
+	cpu->engine = engine;
+
+	return 0;
+}
+
+static const char * const i8080_engine_names[] = {
+	[I8080_ENGINE_TABLE] = "table",
+	[I8080_ENGINE_THREADED] = "threaded",
+	[I8080_ENGINE_BLOCK] = "block",
+	[I8080_ENGINE_JIT] = "jit",
+};
+
+const char *
+i8080_engine_name(enum i8080_engine engine) {
+	return (unsigned)engine < sizeof(i8080_engine_names) / sizeof(*i8080_engine_names) ? i8080_engine_names[engine] : NULL;
+}
+
+int
+i8080_engine_find(const char *name, enum i8080_engine *engine) {
+
+	for(unsigned current = 0; current < sizeof(i8080_engine_names) / sizeof(*i8080_engine_names); current++) {
+		if(strcasecmp(i8080_engine_names[current], name) == 0) {
+			*engine = current;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+int
+i8080_cpu_set_idle_skip(struct i8080_cpu *cpu, bool enabled) {
+
+	if(cpu->blocks == NULL) {
+		return -1;
+	}
+
+	i8080_block_set_idle_skip(cpu, enabled);
+
+	return 0;
+}
+
+/* Stores to pages partially covered by ROM sections check the section bitmap */
+static void
+i8080_cpu_rom_partial_store(struct i8080_cpu *cpu, uint16_t address, uint8_t src) {
+
+	if(!(cpu->rom_bytes[address / 8] >> address % 8 & 1)) {
+		cpu->mapping[address / I8080_PAGE_SIZE].store[address % I8080_PAGE_SIZE] = src;
+	}
+}
+
+static const struct i8080_mmio i8080_cpu_rom_partial = {
+	.store = i8080_cpu_rom_partial_store,
+};
+
+/* ROM bytes in a page */
+static unsigned
+i8080_cpu_rom_count(const struct i8080_cpu *cpu, unsigned page) {
+	const uint8_t * const begin = cpu->rom_bytes + page * I8080_PAGE_SIZE / 8;
+	unsigned count = 0;
+
+	for(const uint8_t *current = begin; current != begin + I8080_PAGE_SIZE / 8; current++) {
+		count += __builtin_popcount(*current);
+	}
+
+	return count;
+}
+
+/* Pages are derived from their mapping by the board, with the stores to ROM sections dropped.
+ * Pages of mmio devices are left to their handlers */
+static void
+i8080_cpu_remap(struct i8080_cpu *cpu, unsigned page) {
+	const unsigned count = i8080_cpu_rom_count(cpu, page);
+
+	cpu->pages[page] = cpu->mapping[page];
+	cpu->clean[page] = NULL;
+
+	if(cpu->mapping[page].store == NULL || count == 0) {
+		return;
+	}
+
+	cpu->pages[page].store = NULL;
+	if(count != I8080_PAGE_SIZE) {
+		cpu->pages[page].mmio = &i8080_cpu_rom_partial;
+	}
+}
+
+int
+i8080_cpu_set_rom_map(struct i8080_cpu *cpu, const struct i8080_rom_section *rom_map) {
+	uint8_t rom_bytes[I8080_MEMORY_SIZE / 8] = { };
+
+	if(rom_map != NULL) {
+		for(const struct i8080_rom_section *section = rom_map; section->begin != section->end; section++) {
+			for(unsigned address = section->begin; address < section->end; address++) {
+				if(cpu->mapping[address / I8080_PAGE_SIZE].mmio != NULL) {
+					return -1;
+				}
+				rom_bytes[address / 8] |= 1 << address % 8;
+			}
+		}
+	}
+
+	i8080_cpu_invalidate(cpu, 0x0000, I8080_MEMORY_SIZE);
+
+	memcpy(cpu->rom_bytes, rom_bytes, sizeof(rom_bytes));
+
+	for(unsigned page = 0; page < I8080_PAGE_COUNT; page++) {
+		i8080_cpu_remap(cpu, page);
+	}
+
+	return 0;
+}
+
+int
+i8080_cpu_map(struct i8080_cpu *cpu, uint16_t address, size_t size, uint8_t *load, uint8_t *store) {
+
+	if(address % I8080_PAGE_SIZE != 0 || size % I8080_PAGE_SIZE != 0
+		|| size > I8080_MEMORY_SIZE - address) {
+		return -1;
+	}
+
+	i8080_cpu_invalidate(cpu, 0x0000, I8080_MEMORY_SIZE);
+
+	for(size_t offset = 0; offset < size; offset += I8080_PAGE_SIZE) {
+		const unsigned page = (address + offset) / I8080_PAGE_SIZE;
+
+		cpu->mapping[page].load = load != NULL ? load + offset : NULL;
+		cpu->mapping[page].store = store != NULL ? store + offset : NULL;
+		cpu->mapping[page].mmio = NULL;
+		i8080_cpu_remap(cpu, page);
+	}
+
+	return 0;
+}
+
+int
+i8080_cpu_map_mmio(struct i8080_cpu *cpu, uint16_t address, size_t size, const struct i8080_mmio *mmio) {
+
+	if(address % I8080_PAGE_SIZE != 0 || size % I8080_PAGE_SIZE != 0
+		|| size > I8080_MEMORY_SIZE - address) {
+		return -1;
+	}
+
+	for(size_t offset = 0; offset < size; offset += I8080_PAGE_SIZE) {
+		if(i8080_cpu_rom_count(cpu, (address + offset) / I8080_PAGE_SIZE) != 0) {
+			return -1;
+		}
+	}
+
+	i8080_cpu_invalidate(cpu, 0x0000, I8080_MEMORY_SIZE);
+
+	for(size_t offset = 0; offset < size; offset += I8080_PAGE_SIZE) {
+		const unsigned page = (address + offset) / I8080_PAGE_SIZE;
+
+		cpu->mapping[page].load = NULL;
+		cpu->mapping[page].store = NULL;
+		cpu->mapping[page].mmio = mmio;
+		i8080_cpu_remap(cpu, page);
+	}
+
+	return 0;
+}
+
+int
+i8080_cpu_invalidate(struct i8080_cpu *cpu, uint16_t address, size_t size) {
+
+	if(size != 0) {
+		const unsigned last = (address + size - 1) / I8080_PAGE_SIZE;
+
+		for(unsigned page = address / I8080_PAGE_SIZE; page <= last && page < I8080_PAGE_COUNT; page++) {
+			cpu->dirty[page] = true;
+		}
+	}
+
+	if(cpu->blocks != NULL) {
+		i8080_block_invalidate(cpu, address, size);
+	}
+
+	return 0;
+}
+
+/* Write protects the pages with a store mapping, their first write then marks them dirty */
+static void
+i8080_cpu_protect(struct i8080_cpu *cpu) {
+
+	memset(cpu->dirty, 0, sizeof(cpu->dirty));
+
+	for(unsigned page = 0; page < I8080_PAGE_COUNT; page++) {
+		if(cpu->pages[page].store != NULL) {
+			cpu->clean[page] = cpu->pages[page].store;
+			cpu->pages[page].store = NULL;
+		}
+	}
+}
+
+int
+i8080_cpu_snapshot(struct i8080_cpu *cpu, struct i8080_snapshot *snapshot) {
+
+	snapshot->stopped = cpu->stopped;
+	snapshot->inte = cpu->inte;
+	snapshot->b = cpu->registers.pair.b;
+	snapshot->d = cpu->registers.pair.d;
+	snapshot->h = cpu->registers.pair.h;
+	snapshot->psw = cpu->registers.pair.psw;
+	snapshot->pc = cpu->pc;
+	snapshot->sp = cpu->sp;
+	snapshot->uptime_cycles = cpu->uptime_cycles;
+	snapshot->event_count = cpu->event_count;
+	memcpy(snapshot->events, cpu->events, cpu->event_count * sizeof(*cpu->events));
+
+	for(unsigned page = 0; page < I8080_PAGE_COUNT; page++) {
+		const uint8_t * const load = cpu->pages[page].load;
+
+		if(load != NULL) {
+			memcpy(snapshot->memory + page * I8080_PAGE_SIZE, load, I8080_PAGE_SIZE);
+		}
+	}
+
+	i8080_cpu_protect(cpu);
+	cpu->snapshot = snapshot;
+
+	return 0;
+}
+
+/* Pages are copied back through their load pointer, as their store pointer may be withheld by the block engine or the last snapshot,
+ * and blocks decoded from any page sharing their host memory are dropped. Restoring another snapshot than the last one copies all pages */
+int
+i8080_cpu_restore(struct i8080_cpu *cpu, const struct i8080_snapshot *snapshot) {
+	const bool all = snapshot != cpu->snapshot;
+
+	cpu->stopped = snapshot->stopped;
+	cpu->inte = snapshot->inte;
+	cpu->yield = 0;
+	cpu->registers.pair.b = snapshot->b;
+	cpu->registers.pair.d = snapshot->d;
+	cpu->registers.pair.h = snapshot->h;
+	cpu->registers.pair.psw = snapshot->psw;
+	cpu->pc = snapshot->pc;
+	cpu->sp = snapshot->sp;
+	cpu->uptime_cycles = snapshot->uptime_cycles;
+	cpu->event_count = snapshot->event_count;
+	memcpy(cpu->events, snapshot->events, snapshot->event_count * sizeof(*snapshot->events));
+	I8080_TRACE_SKIP(cpu);
+
+	for(unsigned page = 0; page < I8080_PAGE_COUNT; page++) {
+		uint8_t * const load = cpu->pages[page].load;
+
+		if((all || cpu->dirty[page]) && load != NULL) {
+			memcpy(load, snapshot->memory + page * I8080_PAGE_SIZE, I8080_PAGE_SIZE);
+
+			for(unsigned other = 0; cpu->blocks != NULL && other < I8080_PAGE_COUNT; other++) {
+				if(cpu->pages[other].load == load) {
+					i8080_block_invalidate(cpu, other * I8080_PAGE_SIZE, I8080_PAGE_SIZE);
+				}
+			}
+		}
+	}
+
+	i8080_cpu_protect(cpu);
+	cpu->snapshot = snapshot;
+
+	return 0;
+}
+
+int
+i8080_cpu_block_stats(const struct i8080_cpu *cpu, struct i8080_block_stats *stats) {
+
+	if(cpu->blocks == NULL) {
+		return -1;
+	}
+
+	i8080_block_cache_stats(cpu, stats);
+
+	return 0;
+}
+
+/* Opcodes and immediates are fetched through the host memory of the current code page, looked up only when pc leaves it.
+ * Io handlers may remap memory, so the page is looked up again after IN and OUT */
+static inline void
+i8080_cpu_next_table(struct i8080_cpu *cpu, const uint8_t **code, unsigned *code_page) {
+	const struct i8080_instruction *instruction;
+	const uint16_t address = cpu->pc;
+	const unsigned offset = address % I8080_PAGE_SIZE;
 	union i8080_imm imm = { };
+	unsigned cycles;
+	uint8_t opcode;
 
 	if(cpu->stopped) {
-		return 0;
+		return;
 	}
 
-	switch(instruction->length) {
-	case 2:
-		i8080_cpu_load8(cpu, cpu->pc + 1, &imm.d8);
-		break;
-	case 3:
-		i8080_cpu_load16(cpu, cpu->pc + 1, &imm.d16);
-		break;
-	default:
-		break;
+	if(address / I8080_PAGE_SIZE != *code_page) {
+		*code_page = address / I8080_PAGE_SIZE;
+		*code = cpu->pages[*code_page].load;
+	}
+
+	if(*code != NULL && offset < I8080_PAGE_SIZE - 2) {
+		opcode = (*code)[offset];
+		instruction = instructions + opcode;
+
+		switch(instruction->length) {
+		case 2:
+			imm.d8 = (*code)[offset + 1];
+			break;
+		case 3:
+			imm.d16 = (uint16_t)(*code)[offset + 2] << 8 | (*code)[offset + 1];
+			break;
+		default:
+			break;
+		}
+	} else {
+		i8080_cpu_load8(cpu, address, &opcode);
+		instruction = instructions + opcode;
+
+		switch(instruction->length) {
+		case 2:
+			i8080_cpu_load8(cpu, address + 1, &imm.d8);
+			break;
+		case 3:
+			i8080_cpu_load16(cpu, address + 1, &imm.d16);
+			break;
+		default:
+			break;
+		}
 	}
 
 	cpu->pc += instruction->length;
 
 	if(!instruction->execute(cpu, imm)) { /* nojump */
-		cpu->uptime_cycles += instruction->nojump;
+		cycles = instruction->nojump;
 	} else { /* onjump */
-		cpu->uptime_cycles += instruction->onjump;
+		cycles = instruction->onjump;
+	}
+
+	cpu->uptime_cycles += cycles;
+
+	if(opcode == 0xD3 || opcode == 0xDB) { /* OUT and IN */
+		*code_page = I8080_PAGE_COUNT;
+	}
+
+	I8080_PROFILE_ACCOUNT(cpu, address, opcode, cpu->pc, cpu->sp, cycles);
+	I8080_HISTOGRAM_COUNT(cpu, opcode);
+	I8080_TRACE_STEP(cpu, address, opcode, instruction->length, imm, cycles);
+}
+
+int
+i8080_cpu_profile_start(struct i8080_cpu *cpu) {
+#ifdef I8080_PROFILE
+
+	if(cpu->profile != NULL) {
+		return -1;
+	}
+
+	cpu->profile = i8080_profile_create(cpu->pc);
+	if(cpu->profile == NULL) {
+		return -1;
+	}
+
+	/* Translated code does not account instructions */
+	if(cpu->engine == I8080_ENGINE_JIT) {
+		i8080_block_invalidate(cpu, 0x0000, I8080_MEMORY_SIZE);
+	}
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+int
+i8080_cpu_profile_stop(struct i8080_cpu *cpu) {
+#ifdef I8080_PROFILE
+
+	if(cpu->profile != NULL) {
+		i8080_profile_destroy(cpu->profile);
+		cpu->profile = NULL;
+	}
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+const uint64_t *
+i8080_cpu_profile_cycles(const struct i8080_cpu *cpu) {
+#ifdef I8080_PROFILE
+	return cpu->profile != NULL ? cpu->profile->cycles : NULL;
+#else
+	return NULL;
+#endif
+}
+
+int
+i8080_cpu_profile_write(const struct i8080_cpu *cpu, FILE *output) {
+#ifdef I8080_PROFILE
+	return cpu->profile != NULL ? i8080_profile_write(cpu->profile, output) : -1;
+#else
+	return -1;
+#endif
+}
+
+int
+i8080_cpu_histogram_start(struct i8080_cpu *cpu) {
+#ifdef I8080_HISTOGRAM
+
+	if(cpu->histogram != NULL) {
+		return -1;
+	}
+
+	cpu->histogram = calloc(1, sizeof(*cpu->histogram));
+	if(cpu->histogram == NULL) {
+		return -1;
+	}
+
+	cpu->histogram->previous = 0x100;
+
+	/* Translated code does not count opcodes */
+	if(cpu->engine == I8080_ENGINE_JIT) {
+		i8080_block_invalidate(cpu, 0x0000, I8080_MEMORY_SIZE);
+	}
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+int
+i8080_cpu_histogram_stop(struct i8080_cpu *cpu) {
+#ifdef I8080_HISTOGRAM
+
+	free(cpu->histogram);
+	cpu->histogram = NULL;
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+const struct i8080_histogram *
+i8080_cpu_histogram(const struct i8080_cpu *cpu) {
+	return cpu->histogram;
+}
+
+int
+i8080_cpu_trace_start(struct i8080_cpu *cpu, FILE *output) {
+#ifdef I8080_TRACE
+
+	if(cpu->trace != NULL) {
+		return -1;
+	}
+
+	cpu->trace = i8080_trace_create(cpu, output);
+	if(cpu->trace == NULL) {
+		return -1;
+	}
+
+	/* Translated code does not record instructions */
+	if(cpu->engine == I8080_ENGINE_JIT) {
+		i8080_block_invalidate(cpu, 0x0000, I8080_MEMORY_SIZE);
+	}
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+int
+i8080_cpu_trace_stop(struct i8080_cpu *cpu) {
+#ifdef I8080_TRACE
+	struct i8080_trace * const trace = cpu->trace;
+
+	if(trace == NULL) {
+		return 0;
+	}
+
+	cpu->trace = NULL;
+
+	return i8080_trace_destroy(trace);
+#else
+	return -1;
+#endif
+}
+
+int
+i8080_cpu_schedule(struct i8080_cpu *cpu, uint64_t timestamp, void (*handler)(struct i8080_cpu *, void *), void *data) {
+	const struct i8080_event event = {
+		.timestamp = timestamp, .handler = handler, .data = data,
+	};
+
+	return i8080_events_push(cpu, &event);
+}
+
+int
+i8080_cpu_unschedule(struct i8080_cpu *cpu, void (*handler)(struct i8080_cpu *, void *), void *data) {
+
+	i8080_events_remove(cpu, handler, data);
+
+	return 0;
+}
+
+int
+i8080_cpu_next(struct i8080_cpu *cpu) {
+
+	switch(cpu->engine) {
+	case I8080_ENGINE_BLOCK:
+	case I8080_ENGINE_JIT:
+		i8080_block_run(cpu, cpu->uptime_cycles + 1);
+		break;
+	case I8080_ENGINE_THREADED:
+		if(cpu->trace == NULL) { /* Registers live in locals, traced through the table engine instead */
+			i8080_threaded_run(cpu, cpu->uptime_cycles + 1);
+			break;
+		}
+		/* fallthrough */
+	default: {
+		unsigned code_page = I8080_PAGE_COUNT;
+		const uint8_t *code = NULL;
+
+		i8080_cpu_next_table(cpu, &code, &code_page);
+	}	break;
+	}
+
+	i8080_events_halt(cpu, UINT64_MAX);
+	i8080_events_dispatch(cpu);
+
+	return 0;
+}
+
+/* Engines are run up to the earliest event, so they never check for events themselves.
+ * A halted cpu skips the cycles until the event which wakes it up */
+uint64_t
+i8080_cpu_run(struct i8080_cpu *cpu, uint64_t cycle_budget) {
+	const uint64_t start = cpu->uptime_cycles,
+		deadline = cycle_budget < UINT64_MAX - start ? start + cycle_budget : UINT64_MAX;
+
+	cpu->yield = 0;
+
+	do {
+		const uint64_t next = i8080_events_next(cpu), until = next < deadline ? next : deadline;
+
+		switch(cpu->engine) {
+		case I8080_ENGINE_BLOCK:
+		case I8080_ENGINE_JIT:
+			i8080_block_run(cpu, until);
+			break;
+		case I8080_ENGINE_THREADED:
+			if(cpu->trace == NULL) { /* Registers live in locals, traced through the table engine instead */
+				i8080_threaded_run(cpu, until);
+				break;
+			}
+			/* fallthrough */
+		default: {
+			unsigned code_page = I8080_PAGE_COUNT;
+			const uint8_t *code = NULL;
+
+			while(!cpu->stopped && !cpu->yield && cpu->uptime_cycles < until) {
+				i8080_cpu_next_table(cpu, &code, &code_page);
+			}
+		}	break;
+		}
+
+		i8080_events_halt(cpu, deadline);
+		i8080_events_dispatch(cpu);
+	} while(!cpu->stopped && !cpu->yield && cpu->uptime_cycles < deadline);
+
+	return cpu->uptime_cycles - start;
+}
+
+int
+i8080_cpu_next_batch(struct i8080_cpu * const *cpus, size_t count) {
+
+	i8080_lockstep_run(cpus, count, 1);
+
+	return 0;
+}
+
+uint64_t
+i8080_cpu_run_batch(struct i8080_cpu * const *cpus, size_t count, uint64_t cycle_budget) {
+	uint64_t cycles = 0;
+
+	for(size_t i = 0; i < count; i++) {
+		cpus[i]->yield = 0;
+		cycles -= cpus[i]->uptime_cycles;
 	}
 
+	i8080_lockstep_run(cpus, count, cycle_budget);
+
+	for(size_t i = 0; i < count; i++) {
+		cycles += cpus[i]->uptime_cycles;
+	}
+
+	return cycles;
+}
+
+int
+i8080_cpu_yield(struct i8080_cpu *cpu) {
+
+	cpu->yield = 1;
+
 	return 0;
 }
 
 inline int
 i8080_cpu_interrupt(struct i8080_cpu *cpu, uint8_t opcode, union i8080_imm imm) {
 	const struct i8080_instruction *instruction = instructions + opcode;
+	const uint16_t address = cpu->pc;
+	unsigned cycles;
 
 	if(!cpu->inte) {
 		return 0;
 	}
 
+	cpu->stopped = 0;
 	cpu->inte = 0;
+	cpu->yield = 1;
 
 	if(!instruction->execute(cpu, imm)) { /* nojump */
-		cpu->uptime_cycles += instruction->nojump;
+		cycles = instruction->nojump;
 	} else { /* onjump */
-		cpu->uptime_cycles += instruction->onjump;
+		cycles = instruction->onjump;
 	}
 
+	cpu->uptime_cycles += cycles;
+
+	I8080_PROFILE_ACCOUNT(cpu, address, opcode, cpu->pc, cpu->sp, cycles);
+	I8080_HISTOGRAM_COUNT(cpu, opcode);
+	I8080_TRACE_STEP(cpu, address, opcode, 0, imm, cycles);
+
 	return 0;
 }
 
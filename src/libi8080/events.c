@@ -0,0 +1,83 @@
+#include "events.h"
+
+static void
+i8080_events_sift_up(struct i8080_event *events, unsigned index) {
+	const struct i8080_event event = events[index];
+
+	while(index != 0 && events[(index - 1) / 2].timestamp > event.timestamp) {
+		events[index] = events[(index - 1) / 2];
+		index = (index - 1) / 2;
+	}
+
+	events[index] = event;
+}
+
+static void
+i8080_events_sift_down(struct i8080_event *events, unsigned count, unsigned index) {
+	const struct i8080_event event = events[index];
+
+	while(2 * index + 1 < count) {
+		unsigned child = 2 * index + 1;
+
+		if(child + 1 < count && events[child + 1].timestamp < events[child].timestamp) {
+			child++;
+		}
+
+		if(event.timestamp <= events[child].timestamp) {
+			break;
+		}
+
+		events[index] = events[child];
+		index = child;
+	}
+
+	events[index] = event;
+}
+
+int
+i8080_events_push(struct i8080_cpu *cpu, const struct i8080_event *event) {
+
+	if(cpu->event_count == I8080_EVENT_COUNT) {
+		return -1;
+	}
+
+	cpu->events[cpu->event_count] = *event;
+	i8080_events_sift_up(cpu->events, cpu->event_count);
+	cpu->event_count++;
+
+	return 0;
+}
+
+void
+i8080_events_remove(struct i8080_cpu *cpu, void (*handler)(struct i8080_cpu *, void *), void *data) {
+	unsigned count = 0;
+
+	for(unsigned i = 0; i < cpu->event_count; i++) {
+		if(cpu->events[i].handler != handler || cpu->events[i].data != data) {
+			cpu->events[count++] = cpu->events[i];
+		}
+	}
+
+	cpu->event_count = count;
+
+	for(unsigned i = count / 2; i-- != 0;) {
+		i8080_events_sift_down(cpu->events, count, i);
+	}
+}
+
+/* The event is taken out of the heap before its handler is called, so the handler can post it again */
+void
+i8080_events_dispatch(struct i8080_cpu *cpu) {
+
+	while(cpu->event_count != 0 && cpu->events[0].timestamp <= cpu->uptime_cycles) {
+		const struct i8080_event event = cpu->events[0];
+
+		cpu->event_count--;
+		if(cpu->event_count != 0) {
+			cpu->events[0] = cpu->events[cpu->event_count];
+			i8080_events_sift_down(cpu->events, cpu->event_count, 0);
+		}
+
+		event.handler(cpu, event.data);
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef I8080_EVENTS_H
+#define I8080_EVENTS_H
+
+#include "i8080/cpu.h"
+
+#include "trace.h"
+
+/* Timestamp of the earliest pending event, engines are run up to it */
+static inline uint64_t
+i8080_events_next(const struct i8080_cpu *cpu) {
+	return cpu->event_count != 0 ? cpu->events[0].timestamp : UINT64_MAX;
+}
+
+/* A cpu halted with interrupts enabled can only be woken up by an event, so its clock
+ * jumps straight to the earliest one, or to until if it comes first */
+static inline void
+i8080_events_halt(struct i8080_cpu *cpu, uint64_t until) {
+
+	if(cpu->stopped && cpu->inte && cpu->event_count != 0) {
+		const uint64_t next = i8080_events_next(cpu), wakeup = next < until ? next : until;
+
+		if(cpu->uptime_cycles < wakeup) {
+			cpu->uptime_cycles = wakeup;
+			I8080_TRACE_SKIP(cpu);
+		}
+	}
+}
+
+int
+i8080_events_push(struct i8080_cpu *cpu, const struct i8080_event *event);
+
+void
+i8080_events_remove(struct i8080_cpu *cpu, void (*handler)(struct i8080_cpu *, void *), void *data);
+
+/* Calls the handlers of all events whose timestamp was reached */
+void
+i8080_events_dispatch(struct i8080_cpu *cpu);
+
+/* I8080_EVENTS_H */
+#endif
@@ -0,0 +1,29 @@
+#ifndef I8080_HISTOGRAM_H
+#define I8080_HISTOGRAM_H
+
+#include "i8080/cpu.h"
+
+/* Engines count each opcode executed, including the ones of interrupts.
+ * Compiled out entirely without I8080_HISTOGRAM, and a single test while the cpu is not counting */
+#ifdef I8080_HISTOGRAM
+#define I8080_HISTOGRAM_COUNT(cpu, opcode) do {\
+	if((cpu)->histogram != NULL) {\
+		i8080_histogram_count((cpu)->histogram, (opcode));\
+	}\
+} while(0)
+#else
+#define I8080_HISTOGRAM_COUNT(cpu, opcode) do { } while(0)
+#endif
+
+static inline void
+i8080_histogram_count(struct i8080_histogram *histogram, uint8_t opcode) {
+
+	histogram->opcodes[opcode]++;
+	if(histogram->previous < 0x100) {
+		histogram->pairs[histogram->previous][opcode]++;
+	}
+	histogram->previous = opcode;
+}
+
+/* I8080_HISTOGRAM_H */
+#endif
@@ -0,0 +1,749 @@
+#ifdef I8080_JIT
+
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "jit.h"
+#include "memory.h"
+
+/* x86-64 translation of hot blocks. While a translated block runs, the 8080 registers live in the legacy
+ * byte registers: bh:bl is BC, dh:dl is DE, ch:cl is HL, al is A and ah holds the conditions, which share
+ * the layout lahf and sahf use for the host flags. rbp points to the cpu and r12 holds the deadline.
+ * Memory accesses inline the page table lookup, other pages and instructions without a translation
+ * call back into C. Exits update the cpu state as if the block had been interpreted.
+ * The code buffer is never writable and executable at once: the pages a block is emitted to are
+ * made writable while it is translated, then executable again. */
+
+#define I8080_JIT_BUFFER_SIZE     (32 << 20)
+#define I8080_JIT_INSTRUCTION_MAX 256 /* Upper bound of the size of a translated instruction */
+
+#define I8080_JIT_MODRM(mod, reg, rm) ((mod) << 6 | (reg) << 3 | (rm))
+#define I8080_JIT_CPU(field) offsetof(struct i8080_cpu, field)
+
+#define I8080_JIT_EMIT(code, ...) do {\
+	const uint8_t bytes[] = { __VA_ARGS__ };\
+	i8080_jit_emit_bytes(code, bytes, sizeof(bytes));\
+} while(0)
+
+/* Byte registers addressable without a REX prefix, instructions using them cannot encode r8 to r15 */
+enum i8080_jit_register {
+	I8080_JIT_AL, I8080_JIT_CL, I8080_JIT_DL, I8080_JIT_BL,
+	I8080_JIT_AH, I8080_JIT_CH, I8080_JIT_DH, I8080_JIT_BH,
+};
+
+/* Word, double word and quad word registers share their encoding */
+#define I8080_JIT_CX  1
+#define I8080_JIT_DX  2
+#define I8080_JIT_BX  3
+#define I8080_JIT_EDX 2
+#define I8080_JIT_EBP 5
+#define I8080_JIT_ESI 6
+#define I8080_JIT_EDI 7
+
+/* Second byte of the near conditional jumps, zero for an unconditional jump */
+#define I8080_JIT_JMP 0x00
+#define I8080_JIT_JB  0x82
+#define I8080_JIT_JAE 0x83
+#define I8080_JIT_JZ  0x84
+#define I8080_JIT_JNZ 0x85
+
+enum i8080_jit_operand {
+	I8080_JIT_REGISTER,
+	I8080_JIT_MEMORY,    /* Byte pointed to by rsi */
+	I8080_JIT_IMMEDIATE,
+};
+
+struct i8080_jit {
+	uint8_t *buffer, *next, *end;
+	uintptr_t page_size;
+	uint8_t scratch; /* Destination of slow path loads */
+};
+
+struct i8080_jit_code {
+	uint8_t *current;
+	const uint8_t *exit;  /* Writes back registers and returns */
+	const uint8_t *leave; /* Returns */
+	const uint8_t *top;   /* Start of the block body, registers loaded */
+	struct i8080_block_cache *cache;
+	uint16_t address;
+};
+
+_Static_assert(sizeof(struct i8080_page) == 24, "Page table entries are indexed as rdi * 3 * 8");
+
+/* Registers by 8080 encoding, M has no host register */
+static const int8_t i8080_jit_registers[] = {
+	I8080_JIT_BH, I8080_JIT_BL, I8080_JIT_DH, I8080_JIT_DL,
+	I8080_JIT_CH, I8080_JIT_CL, -1, I8080_JIT_AL,
+};
+
+/* Register pairs by 8080 encoding, SP stays in memory */
+static const int8_t i8080_jit_pairs[] = {
+	I8080_JIT_BX, I8080_JIT_DX, I8080_JIT_CX, -1,
+};
+
+/* ADD, ADC, SUB, SBB, ANA, XRA, ORA and CMP host opcodes, in their r/m8, r8 form */
+static const uint8_t i8080_jit_alu[] = {
+	0x00, 0x10, 0x28, 0x18, 0x20, 0x30, 0x08, 0x38,
+};
+
+/* Masks of the NZ/Z, NC/C, PO/PE and P/M conditions */
+static const uint8_t i8080_jit_conditions[] = {
+	I8080_MASK_CONDITION_ZERO, I8080_MASK_CONDITION_CARRY,
+	I8080_MASK_CONDITION_PARITY, I8080_MASK_CONDITION_SIGN,
+};
+
+/*****************************
+ * Callbacks from translated *
+ *****************************/
+
+static inline int
+i8080_jit_stop(const struct i8080_cpu *cpu) {
+	return cpu->blocks->garbage != NULL || cpu->yield || cpu->stopped;
+}
+
+static uint8_t *
+i8080_jit_load(struct i8080_cpu *cpu, uint16_t address) {
+	struct i8080_jit * const jit = cpu->blocks->jit;
+
+	jit->scratch = i8080_cpu_load_mmio(cpu, address);
+
+	return &jit->scratch;
+}
+
+static int
+i8080_jit_store(struct i8080_cpu *cpu, uint16_t address, uint8_t src) {
+
+	i8080_cpu_store_mmio(cpu, address, src);
+
+	return i8080_jit_stop(cpu);
+}
+
+static int
+i8080_jit_fallback(struct i8080_cpu *cpu, const struct i8080_block_instruction *instruction) {
+
+	instruction->execute(cpu, instruction->imm);
+
+	return i8080_jit_stop(cpu);
+}
+
+static void
+i8080_jit_terminate(struct i8080_cpu *cpu, const struct i8080_block_instruction *instruction) {
+
+	if(instruction->execute(cpu, instruction->imm)) {
+		cpu->uptime_cycles += instruction->onjump - instruction->nojump;
+	}
+}
+
+/*************
+ * Emission *
+ *************/
+
+static inline void
+i8080_jit_emit_bytes(struct i8080_jit_code *code, const uint8_t *bytes, size_t count) {
+	memcpy(code->current, bytes, count);
+	code->current += count;
+}
+
+static inline void
+i8080_jit_emit16(struct i8080_jit_code *code, uint16_t value) {
+	I8080_JIT_EMIT(code, value, value >> 8);
+}
+
+static inline void
+i8080_jit_emit32(struct i8080_jit_code *code, uint32_t value) {
+	I8080_JIT_EMIT(code, value, value >> 8, value >> 16, value >> 24);
+}
+
+static inline void
+i8080_jit_emit64(struct i8080_jit_code *code, uint64_t value) {
+	i8080_jit_emit32(code, value);
+	i8080_jit_emit32(code, value >> 32);
+}
+
+/* opcode reg, [rbp + offset] */
+static void
+i8080_jit_emit_rbp(struct i8080_jit_code *code, uint8_t opcode, unsigned reg, size_t offset) {
+	I8080_JIT_EMIT(code, opcode, I8080_JIT_MODRM(2, reg, I8080_JIT_EBP));
+	i8080_jit_emit32(code, offset);
+}
+
+/* Emits a jump, returns its displacement to be patched */
+static uint8_t *
+i8080_jit_emit_jump(struct i8080_jit_code *code, uint8_t condition) {
+
+	if(condition == I8080_JIT_JMP) {
+		I8080_JIT_EMIT(code, 0xE9);
+	} else {
+		I8080_JIT_EMIT(code, 0x0F, condition);
+	}
+
+	code->current += 4;
+
+	return code->current - 4;
+}
+
+static void
+i8080_jit_patch(uint8_t *displacement, const uint8_t *target) {
+	const int32_t relative = target - (displacement + 4);
+
+	memcpy(displacement, &relative, sizeof(relative));
+}
+
+static void
+i8080_jit_emit_jump_to(struct i8080_jit_code *code, uint8_t condition, const uint8_t *target) {
+	i8080_jit_patch(i8080_jit_emit_jump(code, condition), target);
+}
+
+static void
+i8080_jit_emit_call(struct i8080_jit_code *code, const void *function) {
+
+	I8080_JIT_EMIT(code, 0x48, 0x89, 0xEF); /* mov rdi, rbp */
+	I8080_JIT_EMIT(code, 0x48, 0xB8);       /* movabs rax, function */
+	i8080_jit_emit64(code, (uintptr_t)function);
+	I8080_JIT_EMIT(code, 0xFF, 0xD0);       /* call rax */
+}
+
+/* Writes the host registers back to the cpu */
+static void
+i8080_jit_emit_spill(struct i8080_jit_code *code) {
+
+	i8080_jit_emit_rbp(code, 0x88, I8080_JIT_AL, I8080_JIT_CPU(registers.a));
+	i8080_jit_emit_rbp(code, 0x88, I8080_JIT_AH, I8080_JIT_CPU(registers.f));
+	I8080_JIT_EMIT(code, 0x66);
+	i8080_jit_emit_rbp(code, 0x89, I8080_JIT_BX, I8080_JIT_CPU(registers.pair.b));
+	I8080_JIT_EMIT(code, 0x66);
+	i8080_jit_emit_rbp(code, 0x89, I8080_JIT_DX, I8080_JIT_CPU(registers.pair.d));
+	I8080_JIT_EMIT(code, 0x66);
+	i8080_jit_emit_rbp(code, 0x89, I8080_JIT_CX, I8080_JIT_CPU(registers.pair.h));
+}
+
+/* Loads the host registers from the cpu */
+static void
+i8080_jit_emit_reload(struct i8080_jit_code *code) {
+
+	i8080_jit_emit_rbp(code, 0x8A, I8080_JIT_AL, I8080_JIT_CPU(registers.a));
+	i8080_jit_emit_rbp(code, 0x8A, I8080_JIT_AH, I8080_JIT_CPU(registers.f));
+	I8080_JIT_EMIT(code, 0x66);
+	i8080_jit_emit_rbp(code, 0x8B, I8080_JIT_BX, I8080_JIT_CPU(registers.pair.b));
+	I8080_JIT_EMIT(code, 0x66);
+	i8080_jit_emit_rbp(code, 0x8B, I8080_JIT_DX, I8080_JIT_CPU(registers.pair.d));
+	I8080_JIT_EMIT(code, 0x66);
+	i8080_jit_emit_rbp(code, 0x8B, I8080_JIT_CX, I8080_JIT_CPU(registers.pair.h));
+}
+
+static void
+i8080_jit_emit_set_pc(struct i8080_jit_code *code, uint16_t address) {
+
+	I8080_JIT_EMIT(code, 0x66);
+	i8080_jit_emit_rbp(code, 0xC7, 0, I8080_JIT_CPU(pc));
+	i8080_jit_emit16(code, address);
+}
+
+/* add (or sub if reg is 5) qword [rbp + uptime_cycles], cycles */
+static void
+i8080_jit_emit_uptime(struct i8080_jit_code *code, unsigned reg, uint32_t cycles) {
+
+	if(cycles != 0) {
+		I8080_JIT_EMIT(code, 0x48);
+		i8080_jit_emit_rbp(code, 0x81, reg, I8080_JIT_CPU(uptime_cycles));
+		i8080_jit_emit32(code, cycles);
+	}
+}
+
+/* Leaves the block after the instruction ending at next, when a callback asked to stop,
+ * the cycles of the instructions which will not be executed are given back */
+static void
+i8080_jit_emit_bail(struct i8080_jit_code *code, unsigned remaining, uint16_t next) {
+
+	i8080_jit_emit_uptime(code, 5, remaining);
+	i8080_jit_emit_set_pc(code, next);
+	i8080_jit_emit_jump_to(code, I8080_JIT_JMP, code->exit);
+}
+
+/* Callbacks returning non-zero in eax ask to leave the block */
+static void
+i8080_jit_emit_check(struct i8080_jit_code *code, unsigned remaining, uint16_t next) {
+	uint8_t *resume;
+
+	I8080_JIT_EMIT(code, 0x85, 0xC0); /* test eax, eax */
+	i8080_jit_emit_reload(code);
+	resume = i8080_jit_emit_jump(code, I8080_JIT_JZ);
+	i8080_jit_emit_bail(code, remaining, next);
+	i8080_jit_patch(resume, code->current);
+}
+
+/* Moves the 8080 address of an operand to esi */
+static void
+i8080_jit_emit_address(struct i8080_jit_code *code, int pair, uint16_t address) {
+
+	if(pair >= 0) {
+		I8080_JIT_EMIT(code, 0x0F, 0xB7, I8080_JIT_MODRM(3, I8080_JIT_ESI, pair)); /* movzx esi, pair */
+	} else {
+		I8080_JIT_EMIT(code, 0xBE); /* mov esi, address */
+		i8080_jit_emit32(code, address);
+	}
+}
+
+/* Turns the 8080 address in esi into a host pointer in rsi through the page table,
+ * returns the jump to patch to the slow path, taken for pages without host memory */
+static uint8_t *
+i8080_jit_emit_page(struct i8080_jit_code *code, size_t field) {
+	uint8_t *slow;
+
+	I8080_JIT_EMIT(code, 0x89, 0xF7);             /* mov edi, esi */
+	I8080_JIT_EMIT(code, 0xC1, 0xEF, 0x08);       /* shr edi, 8 */
+	I8080_JIT_EMIT(code, 0x48, 0x8D, 0x3C, 0x7F); /* lea rdi, [rdi + rdi * 2] */
+	I8080_JIT_EMIT(code, 0x48, 0x8B, 0xBC, 0xFD); /* mov rdi, [rbp + rdi * 8 + pages + field] */
+	i8080_jit_emit32(code, I8080_JIT_CPU(pages) + field);
+	I8080_JIT_EMIT(code, 0x48, 0x85, 0xFF);       /* test rdi, rdi */
+	slow = i8080_jit_emit_jump(code, I8080_JIT_JZ);
+	I8080_JIT_EMIT(code, 0x81, 0xE6);             /* and esi, 0xFF */
+	i8080_jit_emit32(code, 0xFF);
+	I8080_JIT_EMIT(code, 0x48, 0x01, 0xFE);       /* add rsi, rdi */
+
+	return slow;
+}
+
+/* Points rsi to the byte at the 8080 address in esi */
+static void
+i8080_jit_emit_load(struct i8080_jit_code *code) {
+	uint8_t * const slow = i8080_jit_emit_page(code, offsetof(struct i8080_page, load)), *done;
+
+	done = i8080_jit_emit_jump(code, I8080_JIT_JMP);
+
+	i8080_jit_patch(slow, code->current);
+	i8080_jit_emit_spill(code);
+	i8080_jit_emit_call(code, i8080_jit_load);
+	I8080_JIT_EMIT(code, 0x48, 0x89, 0xC6); /* mov rsi, rax */
+	i8080_jit_emit_reload(code);
+
+	i8080_jit_patch(done, code->current);
+}
+
+/* Stores a register or an immediate at the 8080 address in esi, stores through mmio may invalidate the block */
+static void
+i8080_jit_emit_store(struct i8080_jit_code *code, enum i8080_jit_operand operand, uint8_t value,
+	unsigned remaining, uint16_t next) {
+	uint8_t *slow, *done;
+
+	slow = i8080_jit_emit_page(code, offsetof(struct i8080_page, store));
+
+	if(operand == I8080_JIT_IMMEDIATE) {
+		I8080_JIT_EMIT(code, 0xC6, 0x06, value); /* mov byte [rsi], value */
+	} else {
+		I8080_JIT_EMIT(code, 0x88, I8080_JIT_MODRM(0, value, I8080_JIT_ESI)); /* mov [rsi], value */
+	}
+	done = i8080_jit_emit_jump(code, I8080_JIT_JMP);
+
+	i8080_jit_patch(slow, code->current);
+	i8080_jit_emit_spill(code);
+	if(operand == I8080_JIT_IMMEDIATE) {
+		I8080_JIT_EMIT(code, 0xBA); /* mov edx, value */
+		i8080_jit_emit32(code, value);
+	} else {
+		I8080_JIT_EMIT(code, 0x0F, 0xB6, I8080_JIT_MODRM(3, I8080_JIT_EDX, value)); /* movzx edx, value */
+	}
+	i8080_jit_emit_call(code, i8080_jit_store);
+	i8080_jit_emit_check(code, remaining, next);
+
+	i8080_jit_patch(done, code->current);
+}
+
+/* Arithmetic and logic on the accumulator, conditions are recovered from the host flags */
+static void
+i8080_jit_emit_alu(struct i8080_jit_code *code, unsigned operation, enum i8080_jit_operand operand, uint8_t value) {
+	const uint8_t opcode = i8080_jit_alu[operation];
+
+	if(operation == 4) { /* ANA: auxiliary carry is the bit 3 of either operand, computed in r8d */
+		switch(operand) {
+		case I8080_JIT_REGISTER:
+			I8080_JIT_EMIT(code, 0x0F, 0xB6, I8080_JIT_MODRM(3, I8080_JIT_EDI, value)); /* movzx edi, value */
+			break;
+		case I8080_JIT_MEMORY:
+			I8080_JIT_EMIT(code, 0x0F, 0xB6, 0x3E); /* movzx edi, byte [rsi] */
+			break;
+		case I8080_JIT_IMMEDIATE:
+			I8080_JIT_EMIT(code, 0xBF); /* mov edi, value */
+			i8080_jit_emit32(code, value);
+			break;
+		}
+		I8080_JIT_EMIT(code, 0x44, 0x0F, 0xB6, 0xC0); /* movzx r8d, al */
+		I8080_JIT_EMIT(code, 0x41, 0x09, 0xF8);       /* or r8d, edi */
+		I8080_JIT_EMIT(code, 0x41, 0x83, 0xE0, 0x08); /* and r8d, 8 */
+		I8080_JIT_EMIT(code, 0x41, 0xC1, 0xE0, 0x09); /* shl r8d, 9 */
+	} else if(operation == 1 || operation == 3) { /* ADC and SBB use the carry */
+		I8080_JIT_EMIT(code, 0x9E); /* sahf */
+	}
+
+	switch(operand) {
+	case I8080_JIT_REGISTER:
+		I8080_JIT_EMIT(code, opcode, I8080_JIT_MODRM(3, value, I8080_JIT_AL));
+		break;
+	case I8080_JIT_MEMORY:
+		I8080_JIT_EMIT(code, opcode + 2, I8080_JIT_MODRM(0, I8080_JIT_AL, I8080_JIT_ESI));
+		break;
+	case I8080_JIT_IMMEDIATE:
+		I8080_JIT_EMIT(code, opcode + 4, value);
+		break;
+	}
+
+	I8080_JIT_EMIT(code, 0x9F); /* lahf */
+
+	switch(operation) {
+	case 2: case 3: case 7: /* Auxiliary carry is inverted for subtractions */
+		I8080_JIT_EMIT(code, 0x80, 0xF4, I8080_MASK_CONDITION_AUXILIARY_CARRY); /* xor ah, AC */
+		break;
+	case 4:
+		I8080_JIT_EMIT(code, 0x25); /* and eax, ~(AC << 8) */
+		i8080_jit_emit32(code, ~(I8080_MASK_CONDITION_AUXILIARY_CARRY << 8));
+		I8080_JIT_EMIT(code, 0x44, 0x09, 0xC0); /* or eax, r8d */
+		break;
+	case 5: case 6:
+		I8080_JIT_EMIT(code, 0x80, 0xE4, ~I8080_MASK_CONDITION_AUXILIARY_CARRY & 0xFF); /* and ah, ~AC */
+		break;
+	default:
+		break;
+	}
+}
+
+/* Translates an instruction which is not the end of the block, returns false if it has no translation */
+static bool
+i8080_jit_emit_instruction(struct i8080_jit_code *code, const struct i8080_block_instruction *instruction,
+	unsigned remaining, uint16_t next) {
+	const uint8_t opcode = instruction->opcode;
+	const int dst = i8080_jit_registers[opcode >> 3 & 0x07], src = i8080_jit_registers[opcode & 0x07],
+		pair = i8080_jit_pairs[opcode >> 4 & 0x03];
+
+	switch(opcode) {
+	case 0x00: case 0x08: case 0x10: case 0x18: /* NOP */
+	case 0x20: case 0x28: case 0x30: case 0x38:
+		return true;
+	case 0x01: case 0x11: case 0x21: /* LXI */
+		I8080_JIT_EMIT(code, 0x66, 0xB8 + pair);
+		i8080_jit_emit16(code, instruction->imm.d16);
+		return true;
+	case 0x31:
+		I8080_JIT_EMIT(code, 0x66);
+		i8080_jit_emit_rbp(code, 0xC7, 0, I8080_JIT_CPU(sp));
+		i8080_jit_emit16(code, instruction->imm.d16);
+		return true;
+	case 0x02: case 0x12: /* STAX */
+		i8080_jit_emit_address(code, pair, 0);
+		i8080_jit_emit_store(code, I8080_JIT_REGISTER, I8080_JIT_AL, remaining, next);
+		return true;
+	case 0x0A: case 0x1A: /* LDAX */
+		i8080_jit_emit_address(code, pair, 0);
+		i8080_jit_emit_load(code);
+		I8080_JIT_EMIT(code, 0x8A, I8080_JIT_MODRM(0, I8080_JIT_AL, I8080_JIT_ESI));
+		return true;
+	case 0x32: /* STA */
+		i8080_jit_emit_address(code, -1, instruction->imm.a16);
+		i8080_jit_emit_store(code, I8080_JIT_REGISTER, I8080_JIT_AL, remaining, next);
+		return true;
+	case 0x3A: /* LDA */
+		i8080_jit_emit_address(code, -1, instruction->imm.a16);
+		i8080_jit_emit_load(code);
+		I8080_JIT_EMIT(code, 0x8A, I8080_JIT_MODRM(0, I8080_JIT_AL, I8080_JIT_ESI));
+		return true;
+	case 0x03: case 0x13: case 0x23: /* INX */
+		I8080_JIT_EMIT(code, 0x66, 0xFF, I8080_JIT_MODRM(3, 0, pair));
+		return true;
+	case 0x33:
+		I8080_JIT_EMIT(code, 0x66);
+		i8080_jit_emit_rbp(code, 0xFF, 0, I8080_JIT_CPU(sp));
+		return true;
+	case 0x0B: case 0x1B: case 0x2B: /* DCX */
+		I8080_JIT_EMIT(code, 0x66, 0xFF, I8080_JIT_MODRM(3, 1, pair));
+		return true;
+	case 0x3B:
+		I8080_JIT_EMIT(code, 0x66);
+		i8080_jit_emit_rbp(code, 0xFF, 1, I8080_JIT_CPU(sp));
+		return true;
+	case 0x04: case 0x0C: case 0x14: case 0x1C: case 0x24: case 0x2C: case 0x3C: /* INR, carry is preserved */
+		I8080_JIT_EMIT(code, 0x9E, 0xFE, I8080_JIT_MODRM(3, 0, dst), 0x9F);
+		return true;
+	case 0x05: case 0x0D: case 0x15: case 0x1D: case 0x25: case 0x2D: case 0x3D: /* DCR */
+		I8080_JIT_EMIT(code, 0x9E, 0xFE, I8080_JIT_MODRM(3, 1, dst), 0x9F);
+		I8080_JIT_EMIT(code, 0x80, 0xF4, I8080_MASK_CONDITION_AUXILIARY_CARRY);
+		return true;
+	case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x3E: /* MVI */
+		I8080_JIT_EMIT(code, 0xB0 + dst, instruction->imm.d8);
+		return true;
+	case 0x36:
+		i8080_jit_emit_address(code, I8080_JIT_CX, 0);
+		i8080_jit_emit_store(code, I8080_JIT_IMMEDIATE, instruction->imm.d8, remaining, next);
+		return true;
+	case 0x07: case 0x0F: case 0x17: case 0x1F: /* RLC, RRC, RAL and RAR only update the carry */
+		I8080_JIT_EMIT(code, 0x9E, 0xD0, I8080_JIT_MODRM(3, opcode >> 3, I8080_JIT_AL), 0x9F);
+		return true;
+	case 0x09: case 0x19: case 0x29: /* DAD */
+		I8080_JIT_EMIT(code, 0x80, 0xE4, ~I8080_MASK_CONDITION_CARRY & 0xFF);
+		I8080_JIT_EMIT(code, 0x66, 0x01, I8080_JIT_MODRM(3, pair, I8080_JIT_CX));
+		I8080_JIT_EMIT(code, 0x80, 0xD4, 0x00);
+		return true;
+	case 0x39:
+		I8080_JIT_EMIT(code, 0x80, 0xE4, ~I8080_MASK_CONDITION_CARRY & 0xFF);
+		I8080_JIT_EMIT(code, 0x66);
+		i8080_jit_emit_rbp(code, 0x03, I8080_JIT_CX, I8080_JIT_CPU(sp));
+		I8080_JIT_EMIT(code, 0x80, 0xD4, 0x00);
+		return true;
+	case 0x2F: /* CMA */
+		I8080_JIT_EMIT(code, 0xF6, 0xD0);
+		return true;
+	case 0x37: /* STC */
+		I8080_JIT_EMIT(code, 0x80, 0xCC, I8080_MASK_CONDITION_CARRY);
+		return true;
+	case 0x3F: /* CMC */
+		I8080_JIT_EMIT(code, 0x80, 0xF4, I8080_MASK_CONDITION_CARRY);
+		return true;
+	case 0xEB: /* XCHG */
+		I8080_JIT_EMIT(code, 0x66, 0x87, I8080_JIT_MODRM(3, I8080_JIT_DX, I8080_JIT_CX));
+		return true;
+	case 0xF9: /* SPHL */
+		I8080_JIT_EMIT(code, 0x66);
+		i8080_jit_emit_rbp(code, 0x89, I8080_JIT_CX, I8080_JIT_CPU(sp));
+		return true;
+	case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE: /* Immediate arithmetic and logic */
+		i8080_jit_emit_alu(code, opcode >> 3 & 0x07, I8080_JIT_IMMEDIATE, instruction->imm.d8);
+		return true;
+	default:
+		break;
+	}
+
+	if(opcode >= 0x40 && opcode < 0x80 && opcode != 0x76) { /* MOV */
+		if(dst < 0) {
+			i8080_jit_emit_address(code, I8080_JIT_CX, 0);
+			i8080_jit_emit_store(code, I8080_JIT_REGISTER, src, remaining, next);
+		} else if(src < 0) {
+			i8080_jit_emit_address(code, I8080_JIT_CX, 0);
+			i8080_jit_emit_load(code);
+			I8080_JIT_EMIT(code, 0x8A, I8080_JIT_MODRM(0, dst, I8080_JIT_ESI));
+		} else if(src != dst) {
+			I8080_JIT_EMIT(code, 0x88, I8080_JIT_MODRM(3, src, dst));
+		}
+		return true;
+	}
+
+	if(opcode >= 0x80 && opcode < 0xC0) { /* Arithmetic and logic */
+		if(src < 0) {
+			i8080_jit_emit_address(code, I8080_JIT_CX, 0);
+			i8080_jit_emit_load(code);
+			i8080_jit_emit_alu(code, opcode >> 3 & 0x07, I8080_JIT_MEMORY, 0);
+		} else {
+			i8080_jit_emit_alu(code, opcode >> 3 & 0x07, I8080_JIT_REGISTER, src);
+		}
+		return true;
+	}
+
+	return false;
+}
+
+/* Instructions without translation are executed by their handler with the registers written back */
+static void
+i8080_jit_emit_fallback(struct i8080_jit_code *code, const struct i8080_block_instruction *instruction,
+	unsigned remaining, uint16_t next) {
+
+	i8080_jit_emit_set_pc(code, next);
+	i8080_jit_emit_spill(code);
+	I8080_JIT_EMIT(code, 0x48, 0xBE); /* movabs rsi, instruction */
+	i8080_jit_emit64(code, (uintptr_t)instruction);
+	i8080_jit_emit_call(code, i8080_jit_fallback);
+	i8080_jit_emit_check(code, remaining, next);
+}
+
+/* Leaves the block for a known address: when a translated block starts there and
+ * the deadline allows it, jumps directly to its body with the registers still loaded */
+static void
+i8080_jit_emit_chain(struct i8080_jit_code *code, uint16_t target) {
+	uint8_t *missing, *untranslated, *late;
+
+	I8080_JIT_EMIT(code, 0x48, 0xBF); /* movabs rdi, &blocks[target] */
+	i8080_jit_emit64(code, (uintptr_t)(code->cache->blocks + target));
+	I8080_JIT_EMIT(code, 0x48, 0x8B, 0x3F); /* mov rdi, [rdi] */
+	I8080_JIT_EMIT(code, 0x48, 0x85, 0xFF); /* test rdi, rdi */
+	missing = i8080_jit_emit_jump(code, I8080_JIT_JZ);
+	I8080_JIT_EMIT(code, 0x48, 0x8B, 0xB7); /* mov rsi, [rdi + chain] */
+	i8080_jit_emit32(code, offsetof(struct i8080_block, chain));
+	I8080_JIT_EMIT(code, 0x48, 0x85, 0xF6); /* test rsi, rsi */
+	untranslated = i8080_jit_emit_jump(code, I8080_JIT_JZ);
+	I8080_JIT_EMIT(code, 0x44, 0x8B, 0x87); /* mov r8d, [rdi + head] */
+	i8080_jit_emit32(code, offsetof(struct i8080_block, head));
+	I8080_JIT_EMIT(code, 0x4C);             /* add r8, uptime_cycles */
+	i8080_jit_emit_rbp(code, 0x03, 0, I8080_JIT_CPU(uptime_cycles));
+	I8080_JIT_EMIT(code, 0x4D, 0x39, 0xE0); /* cmp r8, r12 */
+	late = i8080_jit_emit_jump(code, I8080_JIT_JAE);
+	I8080_JIT_EMIT(code, 0x48, 0xBF);       /* movabs rdi, &stats.hits */
+	i8080_jit_emit64(code, (uintptr_t)&code->cache->stats.hits);
+	I8080_JIT_EMIT(code, 0x48, 0xFF, 0x07); /* inc qword [rdi] */
+	I8080_JIT_EMIT(code, 0xFF, 0xE6);       /* jmp rsi */
+
+	i8080_jit_patch(missing, code->current);
+	i8080_jit_patch(untranslated, code->current);
+	i8080_jit_patch(late, code->current);
+	i8080_jit_emit_set_pc(code, target);
+	i8080_jit_emit_jump_to(code, I8080_JIT_JMP, code->exit);
+}
+
+/* Jumps back to the start of the block are followed without leaving while the deadline allows it */
+static void
+i8080_jit_emit_jump_taken(struct i8080_jit_code *code, const struct i8080_block *block, uint16_t target) {
+
+	if(target == code->address) {
+		I8080_JIT_EMIT(code, 0x48);
+		i8080_jit_emit_rbp(code, 0x8B, I8080_JIT_ESI, I8080_JIT_CPU(uptime_cycles)); /* mov rsi, uptime_cycles */
+		I8080_JIT_EMIT(code, 0x48, 0x81, 0xC6); /* add rsi, head */
+		i8080_jit_emit32(code, block->head);
+		I8080_JIT_EMIT(code, 0x4C, 0x39, 0xE6); /* cmp rsi, r12 */
+		i8080_jit_emit_jump_to(code, I8080_JIT_JB, code->top);
+	}
+
+	i8080_jit_emit_chain(code, target);
+}
+
+static void
+i8080_jit_emit_terminator(struct i8080_jit_code *code, const struct i8080_block *block,
+	const struct i8080_block_instruction *instruction, uint16_t next) {
+	const uint8_t opcode = instruction->opcode;
+
+	if(opcode == 0xC3 || opcode == 0xCB) { /* JMP */
+		i8080_jit_emit_uptime(code, 0, instruction->onjump - instruction->nojump);
+		i8080_jit_emit_jump_taken(code, block, instruction->imm.a16);
+	} else if((opcode & 0xC7) == 0xC2) { /* Conditional jumps, same duration either way */
+		const unsigned condition = opcode >> 3 & 0x07;
+		uint8_t *taken;
+
+		I8080_JIT_EMIT(code, 0xF6, 0xC4, i8080_jit_conditions[condition >> 1]); /* test ah, condition */
+		taken = i8080_jit_emit_jump(code, condition & 1 ? I8080_JIT_JNZ : I8080_JIT_JZ);
+		i8080_jit_emit_chain(code, next);
+
+		i8080_jit_patch(taken, code->current);
+		i8080_jit_emit_jump_taken(code, block, instruction->imm.a16);
+	} else {
+		i8080_jit_emit_set_pc(code, next);
+		i8080_jit_emit_spill(code);
+		I8080_JIT_EMIT(code, 0x48, 0xBE); /* movabs rsi, instruction */
+		i8080_jit_emit64(code, (uintptr_t)instruction);
+		i8080_jit_emit_call(code, i8080_jit_terminate);
+		i8080_jit_emit_jump_to(code, I8080_JIT_JMP, code->leave);
+	}
+}
+
+/**************
+ * Translator *
+ **************/
+
+/* Changes the protection of the host pages spanning [begin, end) */
+static int
+i8080_jit_protect(const struct i8080_jit *jit, const uint8_t *begin, const uint8_t *end, int protection) {
+	const uintptr_t first = (uintptr_t)begin & ~(jit->page_size - 1),
+		last = ((uintptr_t)end + jit->page_size - 1) & ~(jit->page_size - 1);
+
+	return mprotect((void *)first, last - first, protection);
+}
+
+struct i8080_jit *
+i8080_jit_create(void) {
+	struct i8080_jit * const jit = malloc(sizeof(*jit));
+
+	if(jit == NULL) {
+		return NULL;
+	}
+
+	jit->page_size = sysconf(_SC_PAGESIZE);
+	jit->buffer = mmap(NULL, I8080_JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(jit->buffer == MAP_FAILED) {
+		free(jit);
+		return NULL;
+	}
+
+	jit->next = jit->buffer;
+	jit->end = jit->buffer + I8080_JIT_BUFFER_SIZE;
+
+	return jit;
+}
+
+void
+i8080_jit_destroy(struct i8080_jit *jit) {
+
+	munmap(jit->buffer, I8080_JIT_BUFFER_SIZE);
+	free(jit);
+}
+
+int
+i8080_jit_translate(struct i8080_block_cache *cache, struct i8080_block *block, uint16_t address) {
+	struct i8080_jit * const jit = cache->jit;
+	const struct i8080_block_instruction *current = block->instructions,
+		* const last = current + block->count - 1;
+	struct i8080_jit_code code = { .current = jit->next, .cache = cache, .address = address };
+	unsigned remaining = block->cycles;
+	const size_t size = (block->count + 2) * I8080_JIT_INSTRUCTION_MAX;
+	uint16_t next = address;
+	const uint8_t *entry;
+
+	if((size_t)(jit->end - jit->next) < size) {
+		return -1;
+	}
+
+	/* Blocks which cannot be emitted are left to the interpreter */
+	if(i8080_jit_protect(jit, jit->next, jit->next + size, PROT_READ | PROT_WRITE) != 0) {
+		return 0;
+	}
+
+	code.exit = code.current;
+	i8080_jit_emit_spill(&code);
+	code.leave = code.current;
+	I8080_JIT_EMIT(&code, 0x41, 0x5C, 0x5B, 0x5D, 0xC3); /* pop r12; pop rbx; pop rbp; ret */
+
+	entry = code.current;
+	I8080_JIT_EMIT(&code, 0x55, 0x53, 0x41, 0x54); /* push rbp; push rbx; push r12 */
+	I8080_JIT_EMIT(&code, 0x48, 0x89, 0xFD);       /* mov rbp, rdi */
+	I8080_JIT_EMIT(&code, 0x49, 0x89, 0xF4);       /* mov r12, rsi */
+	i8080_jit_emit_reload(&code);
+
+	code.top = code.current;
+	i8080_jit_emit_uptime(&code, 0, block->cycles);
+
+	while(current != last) {
+		next += current->length;
+		remaining -= current->nojump;
+
+		if(!i8080_jit_emit_instruction(&code, current, remaining, next)) {
+			i8080_jit_emit_fallback(&code, current, remaining, next);
+		}
+
+		current++;
+	}
+
+	next += last->length;
+	if(i8080_block_is_terminator(last->opcode, i8080_instruction_info(last->opcode))) {
+		i8080_jit_emit_terminator(&code, block, last, next);
+	} else {
+		if(!i8080_jit_emit_instruction(&code, last, 0, next)) {
+			i8080_jit_emit_fallback(&code, last, 0, next);
+		}
+		i8080_jit_emit_chain(&code, next);
+	}
+
+	/* Code already translated may share these pages, it must all be dropped */
+	if(i8080_jit_protect(jit, jit->next, jit->next + size, PROT_READ | PROT_EXEC) != 0) {
+		return -1;
+	}
+
+	jit->next = code.current;
+	block->native = (void (*)(struct i8080_cpu *, uint64_t))entry;
+	block->chain = code.top;
+
+	return 0;
+}
+
+void
+i8080_jit_reset(struct i8080_jit *jit) {
+	jit->next = jit->buffer;
+}
+
+/* I8080_JIT */
+#endif
@@ -0,0 +1,28 @@
+#ifndef I8080_JIT_H
+#define I8080_JIT_H
+
+#include "block.h"
+
+/* Blocks are translated once they have been executed that many times */
+#define I8080_JIT_THRESHOLD 16
+
+/* Pages whose code was rewritten that many times are left to the block interpreter */
+#define I8080_JIT_REWRITES_MAX 4
+
+struct i8080_jit *
+i8080_jit_create(void);
+
+void
+i8080_jit_destroy(struct i8080_jit *jit);
+
+/* Translates a block starting at address to native code, sets its entry points on success. Returns -1 when
+ * the code buffer is full or could not be made executable again, it must then be reset once all blocks have been dropped.
+ * Blocks are left untranslated if the buffer cannot be made writable */
+int
+i8080_jit_translate(struct i8080_block_cache *cache, struct i8080_block *block, uint16_t address);
+
+void
+i8080_jit_reset(struct i8080_jit *jit);
+
+/* I8080_JIT_H */
+#endif
@@ -0,0 +1,666 @@
+#include "lockstep.h"
+#include "conditions.h"
+#include "memory.h"
+#include "events.h"
+
+/* Lanes are written with vector extensions, on x86-64 the group runner is compiled
+ * both for AVX2 and the baseline, and the best one is selected when the library is loaded */
+#if defined(__x86_64__)
+#define I8080_LOCKSTEP_TARGET __attribute__((target_clones("avx2", "default")))
+#else
+#define I8080_LOCKSTEP_TARGET
+#endif
+
+/* Helpers must be inlined in each clone of the group runner, lanes are not passed the same way by AVX2 and baseline code */
+#define I8080_LOCKSTEP_INLINE static inline __attribute__((always_inline))
+
+/* A cpu alone at the lowest pc runs by itself for that many cycles before lanes are regrouped */
+#define I8080_LOCKSTEP_SLICE 64
+
+typedef uint16_t i8080_lanes __attribute__((vector_size(I8080_LOCKSTEP_LANES * sizeof(uint16_t))));
+typedef uint64_t i8080_lanes_words __attribute__((vector_size(I8080_LOCKSTEP_LANES * sizeof(uint16_t))));
+typedef uint64_t i8080_lanes_cycles __attribute__((vector_size(I8080_LOCKSTEP_LANES * sizeof(uint64_t))));
+typedef int16_t i8080_lanes_compare __attribute__((vector_size(I8080_LOCKSTEP_LANES * sizeof(int16_t))));
+
+/* Registers of each lane, 8 bits registers only use the low byte of their lane.
+ * Code points to the host memory of each lane's copy of codepage, if any */
+struct i8080_lockstep {
+	i8080_lanes a, f, bc, de, hl, sp, pc;
+	i8080_lanes_cycles uptimes, deadlines; /* Deadlines stop at the earliest event of each cpu, before finals */
+	i8080_lanes_cycles finals;
+	struct i8080_cpu *cpus[I8080_LOCKSTEP_LANES];
+	const uint8_t *code[I8080_LOCKSTEP_LANES];
+	unsigned codepage;
+	unsigned mmio; /* Lanes which called an mmio handler during the current step */
+	unsigned count;
+};
+
+static const i8080_lanes i8080_lockstep_bits = {
+	0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080,
+	0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000, 0x8000,
+};
+
+I8080_LOCKSTEP_INLINE i8080_lanes
+i8080_lockstep_mask(unsigned lanes) {
+	return (i8080_lanes)((i8080_lockstep_bits & (uint16_t)lanes) != 0);
+}
+
+/* Each lane keeps its own bit, which are then folded together */
+I8080_LOCKSTEP_INLINE unsigned
+i8080_lockstep_lanes(i8080_lanes mask) {
+	const i8080_lanes_words words = (i8080_lanes_words)(mask & i8080_lockstep_bits);
+	uint64_t lanes = words[0] | words[1] | words[2] | words[3];
+
+	lanes |= lanes >> 32;
+
+	return (lanes | lanes >> 16) & 0xFFFF;
+}
+
+I8080_LOCKSTEP_INLINE i8080_lanes
+i8080_lockstep_select(i8080_lanes mask, i8080_lanes lhs, i8080_lanes rhs) {
+	return lhs & mask | rhs & ~mask;
+}
+
+I8080_LOCKSTEP_INLINE void
+i8080_lockstep_load(struct i8080_lockstep *lanes, unsigned lane) {
+	const struct i8080_cpu * const cpu = lanes->cpus[lane];
+
+	lanes->a[lane] = cpu->registers.a;
+	lanes->f[lane] = cpu->registers.f;
+	lanes->bc[lane] = cpu->registers.pair.b;
+	lanes->de[lane] = cpu->registers.pair.d;
+	lanes->hl[lane] = cpu->registers.pair.h;
+	lanes->sp[lane] = cpu->sp;
+	lanes->pc[lane] = cpu->pc;
+	lanes->uptimes[lane] = cpu->uptime_cycles;
+}
+
+I8080_LOCKSTEP_INLINE void
+i8080_lockstep_save(const struct i8080_lockstep *lanes, unsigned lane) {
+	struct i8080_cpu * const cpu = lanes->cpus[lane];
+
+	cpu->registers.a = lanes->a[lane];
+	cpu->registers.f = lanes->f[lane];
+	cpu->registers.pair.b = lanes->bc[lane];
+	cpu->registers.pair.d = lanes->de[lane];
+	cpu->registers.pair.h = lanes->hl[lane];
+	cpu->sp = lanes->sp[lane];
+	cpu->pc = lanes->pc[lane];
+	cpu->uptime_cycles = lanes->uptimes[lane];
+}
+
+I8080_LOCKSTEP_INLINE bool
+i8080_lockstep_isrunning(const struct i8080_lockstep *lanes, unsigned lane) {
+	const struct i8080_cpu * const cpu = lanes->cpus[lane];
+
+	return !cpu->stopped && !cpu->yield && lanes->uptimes[lane] < lanes->deadlines[lane];
+}
+
+/* Dispatches the events reached by a lane which stopped running, as i8080_cpu_run would after running its engine
+ * (fast-forwarding halted lanes), then moves its deadline to its next event. Returns whether the lane can go on */
+I8080_LOCKSTEP_INLINE bool
+i8080_lockstep_events(struct i8080_lockstep *lanes, unsigned lane) {
+	struct i8080_cpu * const cpu = lanes->cpus[lane];
+	uint64_t next;
+
+	if(cpu->stopped || lanes->uptimes[lane] >= i8080_events_next(cpu)) {
+		i8080_lockstep_save(lanes, lane);
+		i8080_events_halt(cpu, lanes->finals[lane]);
+		i8080_events_dispatch(cpu);
+		i8080_lockstep_load(lanes, lane);
+	}
+
+	next = i8080_events_next(cpu);
+	lanes->deadlines[lane] = next < lanes->finals[lane] ? next : lanes->finals[lane];
+
+	return i8080_lockstep_isrunning(lanes, lane);
+}
+
+/* Memory is not shared between lanes, each access goes through the page table of its lane's cpu.
+ * Lanes calling mmio handlers are tracked, as the handlers may stop the cpu or make it yield */
+
+I8080_LOCKSTEP_INLINE uint8_t
+i8080_lockstep_load8_lane(struct i8080_lockstep *lanes, unsigned lane, uint16_t address) {
+	struct i8080_cpu * const cpu = lanes->cpus[lane];
+	const uint8_t * const load = cpu->pages[address / I8080_PAGE_SIZE].load;
+
+	if(load != NULL) {
+		return load[address % I8080_PAGE_SIZE];
+	}
+
+	lanes->mmio |= 1 << lane;
+
+	return i8080_cpu_load_mmio(cpu, address);
+}
+
+I8080_LOCKSTEP_INLINE void
+i8080_lockstep_store8_lane(struct i8080_lockstep *lanes, unsigned lane, uint16_t address, uint8_t src) {
+	struct i8080_cpu * const cpu = lanes->cpus[lane];
+	uint8_t * const store = cpu->pages[address / I8080_PAGE_SIZE].store;
+
+	if(store != NULL) {
+		store[address % I8080_PAGE_SIZE] = src;
+		return;
+	}
+
+	lanes->mmio |= 1 << lane;
+
+	i8080_cpu_store_mmio(cpu, address, src);
+}
+
+I8080_LOCKSTEP_INLINE i8080_lanes
+i8080_lockstep_load8(struct i8080_lockstep *lanes, unsigned active, i8080_lanes address) {
+	i8080_lanes value = { };
+
+	for(unsigned left = active; left != 0; left &= left - 1) {
+		const unsigned lane = __builtin_ctz(left);
+
+		value[lane] = i8080_lockstep_load8_lane(lanes, lane, address[lane]);
+	}
+
+	return value;
+}
+
+/* As i8080_cpu_load16, the high byte of a word read at 0xFFFF is at 0x0000 */
+I8080_LOCKSTEP_INLINE i8080_lanes
+i8080_lockstep_load16(struct i8080_lockstep *lanes, unsigned active, i8080_lanes address) {
+	i8080_lanes value = { };
+
+	for(unsigned left = active; left != 0; left &= left - 1) {
+		const unsigned lane = __builtin_ctz(left);
+		const uint16_t low = i8080_lockstep_load8_lane(lanes, lane, address[lane]);
+
+		value[lane] = i8080_lockstep_load8_lane(lanes, lane, (uint16_t)(address[lane] + 1)) << 8 | low;
+	}
+
+	return value;
+}
+
+I8080_LOCKSTEP_INLINE void
+i8080_lockstep_store8(struct i8080_lockstep *lanes, unsigned active, i8080_lanes address, i8080_lanes value) {
+
+	for(unsigned left = active; left != 0; left &= left - 1) {
+		const unsigned lane = __builtin_ctz(left);
+
+		i8080_lockstep_store8_lane(lanes, lane, address[lane], value[lane]);
+	}
+}
+
+I8080_LOCKSTEP_INLINE void
+i8080_lockstep_store16(struct i8080_lockstep *lanes, unsigned active, i8080_lanes address, i8080_lanes value) {
+
+	for(unsigned left = active; left != 0; left &= left - 1) {
+		const unsigned lane = __builtin_ctz(left);
+
+		i8080_lockstep_store8_lane(lanes, lane, address[lane], value[lane]);
+		i8080_lockstep_store8_lane(lanes, lane, address[lane] + 1, value[lane] >> 8);
+	}
+}
+
+/* Registers are indexed as in opcodes: B, C, D, E, H, L, M and A */
+
+I8080_LOCKSTEP_INLINE i8080_lanes
+i8080_lockstep_read(struct i8080_lockstep *lanes, unsigned active, unsigned r) {
+
+	switch(r) {
+	case 0: return lanes->bc >> 8;
+	case 1: return lanes->bc & 0xFF;
+	case 2: return lanes->de >> 8;
+	case 3: return lanes->de & 0xFF;
+	case 4: return lanes->hl >> 8;
+	case 5: return lanes->hl & 0xFF;
+	case 6: return i8080_lockstep_load8(lanes, active, lanes->hl);
+	default: return lanes->a;
+	}
+}
+
+I8080_LOCKSTEP_INLINE void
+i8080_lockstep_write(struct i8080_lockstep *lanes, unsigned active, i8080_lanes mask, unsigned r, i8080_lanes value) {
+
+	switch(r) {
+	case 0: lanes->bc = i8080_lockstep_select(mask, lanes->bc & 0x00FF | value << 8, lanes->bc); break;
+	case 1: lanes->bc = i8080_lockstep_select(mask, lanes->bc & 0xFF00 | value, lanes->bc); break;
+	case 2: lanes->de = i8080_lockstep_select(mask, lanes->de & 0x00FF | value << 8, lanes->de); break;
+	case 3: lanes->de = i8080_lockstep_select(mask, lanes->de & 0xFF00 | value, lanes->de); break;
+	case 4: lanes->hl = i8080_lockstep_select(mask, lanes->hl & 0x00FF | value << 8, lanes->hl); break;
+	case 5: lanes->hl = i8080_lockstep_select(mask, lanes->hl & 0xFF00 | value, lanes->hl); break;
+	case 6: i8080_lockstep_store8(lanes, active, lanes->hl, value); break;
+	default: lanes->a = i8080_lockstep_select(mask, value, lanes->a); break;
+	}
+}
+
+/* Register pairs are indexed as in LXI, INX, DCX and DAD: BC, DE, HL and SP */
+I8080_LOCKSTEP_INLINE i8080_lanes *
+i8080_lockstep_pair(struct i8080_lockstep *lanes, unsigned rp) {
+	i8080_lanes * const pairs[] = { &lanes->bc, &lanes->de, &lanes->hl, &lanes->sp };
+
+	return pairs[rp];
+}
+
+/* Sign, zero and parity conditions of 8 bits results */
+I8080_LOCKSTEP_INLINE i8080_lanes
+i8080_lockstep_szp(i8080_lanes res) {
+	i8080_lanes parity = res ^ res >> 4;
+
+	parity ^= parity >> 2;
+	parity ^= parity >> 1;
+
+	return res & I8080_MASK_CONDITION_SIGN
+		| (i8080_lanes)(res == 0) & I8080_MASK_CONDITION_ZERO
+		| (~parity & 1) << I8080_BIT_CONDITION_PARITY;
+}
+
+/* Lanes meeting the condition of a conditional jump, call or return, encoded as in their opcode */
+I8080_LOCKSTEP_INLINE i8080_lanes
+i8080_lockstep_condition(i8080_lanes f, unsigned condition) {
+	static const uint8_t masks[] = {
+		I8080_MASK_CONDITION_ZERO, I8080_MASK_CONDITION_CARRY,
+		I8080_MASK_CONDITION_PARITY, I8080_MASK_CONDITION_SIGN,
+	};
+	const i8080_lanes set = (i8080_lanes)((f & masks[condition >> 1]) != 0);
+
+	return condition & 1 ? set : ~set;
+}
+
+/* ADD, ADC, SUB, SBB, ANA, XRA, ORA and CMP */
+I8080_LOCKSTEP_INLINE void
+i8080_lockstep_alu(struct i8080_lockstep *lanes, i8080_lanes mask, unsigned operation, i8080_lanes src) {
+	const i8080_lanes a = lanes->a, carry = lanes->f & I8080_MASK_CONDITION_CARRY;
+	i8080_lanes res, conditions;
+
+	switch(operation) {
+	case 0:
+	case 1:
+		res = a + src + (operation == 1 ? carry : carry & 0);
+		conditions = (a ^ src ^ res) & I8080_MASK_CONDITION_AUXILIARY_CARRY | res >> 8 & 1;
+		break;
+	case 2:
+	case 3:
+	case 7:
+		res = a - src - (operation == 3 ? carry : carry & 0);
+		conditions = ~(a ^ src ^ res) & I8080_MASK_CONDITION_AUXILIARY_CARRY | res >> 8 & 1;
+		break;
+	case 4:
+		res = a & src;
+		conditions = (a | src) << (I8080_BIT_CONDITION_AUXILIARY_CARRY - 3) & I8080_MASK_CONDITION_AUXILIARY_CARRY;
+		break;
+	case 5:
+		res = a ^ src;
+		conditions = res & 0;
+		break;
+	default:
+		res = a | src;
+		conditions = res & 0;
+		break;
+	}
+
+	res &= 0xFF;
+	conditions |= i8080_lockstep_szp(res);
+
+	lanes->f = i8080_lockstep_select(mask, lanes->f & ~I8080_MASK_CONDITIONS_SZ_A_P_C | conditions, lanes->f);
+	if(operation != 7) {
+		lanes->a = i8080_lockstep_select(mask, res, lanes->a);
+	}
+}
+
+/* Executes opcode on the active lanes, whose pc was already advanced past it, and sets the lanes which took the jump.
+ * Returns false if the opcode must be executed by each cpu */
+I8080_LOCKSTEP_INLINE bool
+i8080_lockstep_execute(struct i8080_lockstep *lanes, unsigned active, uint8_t opcode, i8080_lanes imm, i8080_lanes *jumped) {
+	const unsigned x = opcode >> 6, y = opcode >> 3 & 7, z = opcode & 7, p = y >> 1, q = y & 1;
+	const i8080_lanes mask = i8080_lockstep_mask(active);
+	i8080_lanes taken = mask & 0;
+
+	switch(x) {
+	case 0:
+		switch(z) {
+		case 0: /* NOP */
+			break;
+		case 1:
+			if(q == 0) { /* LXI */
+				i8080_lanes * const pair = i8080_lockstep_pair(lanes, p);
+
+				*pair = i8080_lockstep_select(mask, imm, *pair);
+			} else { /* DAD */
+				const i8080_lanes sum = lanes->hl + *i8080_lockstep_pair(lanes, p);
+
+				lanes->f = i8080_lockstep_select(mask, lanes->f & ~I8080_MASK_CONDITION_CARRY
+					| (i8080_lanes)(sum < lanes->hl) & I8080_MASK_CONDITION_CARRY, lanes->f);
+				lanes->hl = i8080_lockstep_select(mask, sum, lanes->hl);
+			}
+			break;
+		case 2:
+			switch(y) {
+			case 0: i8080_lockstep_store8(lanes, active, lanes->bc, lanes->a); break; /* STAX B */
+			case 2: i8080_lockstep_store8(lanes, active, lanes->de, lanes->a); break; /* STAX D */
+			case 6: i8080_lockstep_store8(lanes, active, imm, lanes->a); break; /* STA */
+			case 1: i8080_lockstep_write(lanes, active, mask, 7, i8080_lockstep_load8(lanes, active, lanes->bc)); break; /* LDAX B */
+			case 3: i8080_lockstep_write(lanes, active, mask, 7, i8080_lockstep_load8(lanes, active, lanes->de)); break; /* LDAX D */
+			case 7: i8080_lockstep_write(lanes, active, mask, 7, i8080_lockstep_load8(lanes, active, imm)); break; /* LDA */
+			default: return false; /* SHLD and LHLD */
+			}
+			break;
+		case 3: { /* INX and DCX */
+			i8080_lanes * const pair = i8080_lockstep_pair(lanes, p);
+
+			*pair = i8080_lockstep_select(mask, q == 0 ? *pair + 1 : *pair - 1, *pair);
+		}	break;
+		case 4:
+		case 5: { /* INR and DCR */
+			const i8080_lanes dst = i8080_lockstep_read(lanes, active, y),
+				res = (z == 4 ? dst + 1 : dst - 1) & 0xFF,
+				carry = z == 4 ? dst ^ res : ~(dst ^ res);
+
+			lanes->f = i8080_lockstep_select(mask, lanes->f & ~I8080_MASK_CONDITIONS_SZ_A_P__
+				| i8080_lockstep_szp(res) | carry & I8080_MASK_CONDITION_AUXILIARY_CARRY, lanes->f);
+			i8080_lockstep_write(lanes, active, mask, y, res);
+		}	break;
+		case 6: /* MVI */
+			i8080_lockstep_write(lanes, active, mask, y, imm);
+			break;
+		default: {
+			const i8080_lanes a = lanes->a, f = lanes->f, carry = f & I8080_MASK_CONDITION_CARRY;
+			i8080_lanes res, conditions;
+
+			switch(y) {
+			case 0: /* RLC */
+				conditions = a >> 7;
+				res = a << 1 | conditions;
+				break;
+			case 1: /* RRC */
+				conditions = a & 1;
+				res = a >> 1 | conditions << 7;
+				break;
+			case 2: /* RAL */
+				conditions = a >> 7;
+				res = a << 1 | carry;
+				break;
+			case 3: /* RAR */
+				conditions = a & 1;
+				res = a >> 1 | carry << 7;
+				break;
+			case 5: /* CMA */
+				conditions = carry;
+				res = ~a;
+				break;
+			case 6: /* STC */
+				conditions = carry | 1;
+				res = a;
+				break;
+			case 7: /* CMC */
+				conditions = carry ^ 1;
+				res = a;
+				break;
+			default: /* DAA */
+				return false;
+			}
+
+			lanes->f = i8080_lockstep_select(mask, f & ~I8080_MASK_CONDITION_CARRY | conditions << I8080_BIT_CONDITION_CARRY, f);
+			lanes->a = i8080_lockstep_select(mask, res & 0xFF, a);
+		}	break;
+		}
+		break;
+	case 1:
+		if(opcode == 0x76) { /* HLT */
+			return false;
+		}
+		/* MOV */
+		i8080_lockstep_write(lanes, active, mask, y, i8080_lockstep_read(lanes, active, z));
+		break;
+	case 2:
+		i8080_lockstep_alu(lanes, mask, y, i8080_lockstep_read(lanes, active, z));
+		break;
+	default:
+		switch(z) {
+		case 0: /* Rcc */
+			taken = mask & i8080_lockstep_condition(lanes->f, y);
+			if(i8080_lockstep_lanes(taken) != 0) {
+				lanes->pc = i8080_lockstep_select(taken, i8080_lockstep_load16(lanes, i8080_lockstep_lanes(taken), lanes->sp), lanes->pc);
+				lanes->sp = i8080_lockstep_select(taken, lanes->sp + 2, lanes->sp);
+			}
+			break;
+		case 1:
+			if(q == 0) { /* POP */
+				const i8080_lanes value = i8080_lockstep_load16(lanes, active, lanes->sp);
+
+				if(p == 3) {
+					lanes->a = i8080_lockstep_select(mask, value >> 8, lanes->a);
+					lanes->f = i8080_lockstep_select(mask, value & I8080_MASK_CONDITIONS_SZ_A_P_C | I8080_MASK_CONDITION_UNUSED1, lanes->f);
+				} else {
+					i8080_lanes * const pair = i8080_lockstep_pair(lanes, p);
+
+					*pair = i8080_lockstep_select(mask, value, *pair);
+				}
+				lanes->sp = i8080_lockstep_select(mask, lanes->sp + 2, lanes->sp);
+			} else if(p <= 1) { /* RET */
+				taken = mask;
+				lanes->pc = i8080_lockstep_select(mask, i8080_lockstep_load16(lanes, active, lanes->sp), lanes->pc);
+				lanes->sp = i8080_lockstep_select(mask, lanes->sp + 2, lanes->sp);
+			} else if(p == 2) { /* PCHL */
+				taken = mask;
+				lanes->pc = i8080_lockstep_select(mask, lanes->hl, lanes->pc);
+			} else { /* SPHL */
+				lanes->sp = i8080_lockstep_select(mask, lanes->hl, lanes->sp);
+			}
+			break;
+		case 2: /* Jcc */
+			taken = mask & i8080_lockstep_condition(lanes->f, y);
+			lanes->pc = i8080_lockstep_select(taken, imm, lanes->pc);
+			break;
+		case 3:
+			if(y <= 1) { /* JMP */
+				taken = mask;
+				lanes->pc = i8080_lockstep_select(mask, imm, lanes->pc);
+			} else if(y == 5) { /* XCHG */
+				const i8080_lanes de = lanes->de;
+
+				lanes->de = i8080_lockstep_select(mask, lanes->hl, de);
+				lanes->hl = i8080_lockstep_select(mask, de, lanes->hl);
+			} else { /* OUT, IN, XTHL, DI and EI */
+				return false;
+			}
+			break;
+		case 4: /* Ccc */
+		case 5:
+			if(z == 5 && q == 0) { /* PUSH */
+				const i8080_lanes value = p == 3 ? lanes->a << 8 | lanes->f : *i8080_lockstep_pair(lanes, p);
+
+				lanes->sp = i8080_lockstep_select(mask, lanes->sp - 2, lanes->sp);
+				i8080_lockstep_store16(lanes, active, lanes->sp, value);
+				break;
+			}
+
+			/* CALL */
+			taken = z == 5 ? mask : mask & i8080_lockstep_condition(lanes->f, y);
+			if(i8080_lockstep_lanes(taken) != 0) {
+				lanes->sp = i8080_lockstep_select(taken, lanes->sp - 2, lanes->sp);
+				i8080_lockstep_store16(lanes, i8080_lockstep_lanes(taken), lanes->sp, lanes->pc);
+				lanes->pc = i8080_lockstep_select(taken, imm, lanes->pc);
+			}
+			break;
+		case 6:
+			i8080_lockstep_alu(lanes, mask, y, imm);
+			break;
+		default: /* RST */
+			return false;
+		}
+		break;
+	}
+
+	*jumped = taken;
+
+	return true;
+}
+
+/* Code pointers are refreshed when the lanes move to another page, as the threaded engine does */
+I8080_LOCKSTEP_INLINE void
+i8080_lockstep_code(struct i8080_lockstep *lanes, unsigned page) {
+
+	for(unsigned lane = 0; lane < lanes->count; lane++) {
+		lanes->code[lane] = lanes->cpus[lane]->pages[page].load;
+	}
+
+	lanes->codepage = page;
+}
+
+/* Lanes among candidates whose opcode at pc is the given one, their immediates are read in imm */
+I8080_LOCKSTEP_INLINE unsigned
+i8080_lockstep_fetch(struct i8080_lockstep *lanes, unsigned candidates, uint16_t pc,
+	uint8_t opcode, unsigned length, i8080_lanes *imm) {
+	const unsigned offset = pc % I8080_PAGE_SIZE;
+	unsigned active = 0;
+
+	for(unsigned left = candidates; left != 0; left &= left - 1) {
+		const unsigned lane = __builtin_ctz(left);
+		const uint8_t * const code = lanes->code[lane];
+
+		if(code != NULL && offset + length <= I8080_PAGE_SIZE) {
+			if(code[offset] != opcode) { /* Memory of the lanes differ */
+				continue;
+			}
+
+			switch(length) {
+			case 2: (*imm)[lane] = code[offset + 1]; break;
+			case 3: (*imm)[lane] = code[offset + 2] << 8 | code[offset + 1]; break;
+			}
+		} else {
+			if(i8080_lockstep_load8_lane(lanes, lane, pc) != opcode) {
+				continue;
+			}
+
+			switch(length) {
+			case 2: (*imm)[lane] = i8080_lockstep_load8_lane(lanes, lane, pc + 1); break;
+			case 3: (*imm)[lane] = i8080_lockstep_load16(lanes, 1 << lane, (i8080_lanes){ } + (uint16_t)(pc + 1))[lane]; break;
+			}
+		}
+
+		active |= 1 << lane;
+	}
+
+	return active;
+}
+
+static I8080_LOCKSTEP_TARGET void
+i8080_lockstep_run_group(struct i8080_lockstep *lanes) {
+	unsigned running = 0, candidates = 0;
+
+	for(unsigned lane = 0; lane < lanes->count; lane++) {
+		i8080_lockstep_load(lanes, lane);
+		if(i8080_lockstep_events(lanes, lane)) {
+			running |= 1 << lane;
+		}
+	}
+
+	lanes->codepage = I8080_PAGE_COUNT;
+
+	while(running != 0) {
+		const struct i8080_instruction *instruction;
+		unsigned leader = __builtin_ctz(running), active;
+		i8080_lanes imm = { };
+		uint8_t opcode;
+
+		if(candidates != running) {
+			/* Lanes diverged, those at the lowest pc go first so the ones which branched ahead are caught up with */
+			for(unsigned left = running & running - 1; left != 0; left &= left - 1) {
+				const unsigned lane = __builtin_ctz(left);
+
+				if(lanes->pc[lane] < lanes->pc[leader]) {
+					leader = lane;
+				}
+			}
+
+			candidates = i8080_lockstep_lanes((i8080_lanes)(lanes->pc == lanes->pc[leader])) & running;
+		}
+
+		if(lanes->pc[leader] / I8080_PAGE_SIZE != lanes->codepage) {
+			i8080_lockstep_code(lanes, lanes->pc[leader] / I8080_PAGE_SIZE);
+		}
+
+		opcode = i8080_lockstep_load8_lane(lanes, leader, lanes->pc[leader]);
+		instruction = i8080_instruction_info(opcode);
+		lanes->mmio = 0;
+
+		active = i8080_lockstep_fetch(lanes, candidates, lanes->pc[leader], opcode, instruction->length, &imm);
+
+		if(active == 1u << leader) { /* Split lane, run to completion if it is the last one */
+			struct i8080_cpu * const cpu = lanes->cpus[leader];
+			const uint64_t left = lanes->deadlines[leader] - lanes->uptimes[leader];
+
+			i8080_lockstep_save(lanes, leader);
+			i8080_cpu_run(cpu, left < I8080_LOCKSTEP_SLICE || running == active ? left : I8080_LOCKSTEP_SLICE);
+			i8080_lockstep_load(lanes, leader);
+
+			if(!i8080_lockstep_isrunning(lanes, leader) && !i8080_lockstep_events(lanes, leader)) {
+				running &= ~active;
+			}
+			candidates = 0;
+		} else {
+			const i8080_lanes mask = i8080_lockstep_mask(active), pc = lanes->pc;
+			i8080_lanes taken;
+
+			lanes->pc = i8080_lockstep_select(mask, pc + (uint16_t)instruction->length, pc);
+
+			if(i8080_lockstep_execute(lanes, active, opcode, imm, &taken)) {
+				const i8080_lanes cycles = i8080_lockstep_select(taken,
+					mask & (uint16_t)instruction->onjump, mask & (uint16_t)instruction->nojump);
+				const uint16_t next = lanes->pc[leader];
+
+				unsigned stopping;
+
+				lanes->uptimes += __builtin_convertvector(cycles, i8080_lanes_cycles);
+				stopping = active & ~i8080_lockstep_lanes((i8080_lanes)__builtin_convertvector(lanes->uptimes < lanes->deadlines, i8080_lanes_compare))
+					| lanes->mmio;
+
+				for(unsigned left = stopping; left != 0; left &= left - 1) {
+					const unsigned lane = __builtin_ctz(left);
+
+					if(!i8080_lockstep_isrunning(lanes, lane) && !i8080_lockstep_events(lanes, lane)) {
+						running &= ~(1 << lane);
+					}
+				}
+
+				/* Lanes still run together if none of them jumped elsewhere */
+				candidates = active == candidates ? i8080_lockstep_lanes((i8080_lanes)(lanes->pc == next)) & running : 0;
+			} else {
+				lanes->pc = pc;
+				for(unsigned left = active; left != 0; left &= left - 1) {
+					const unsigned lane = __builtin_ctz(left);
+
+					i8080_lockstep_save(lanes, lane);
+					i8080_cpu_next(lanes->cpus[lane]);
+					i8080_lockstep_load(lanes, lane);
+
+					if(!i8080_lockstep_isrunning(lanes, lane) && !i8080_lockstep_events(lanes, lane)) {
+						running &= ~(1 << lane);
+					}
+				}
+				candidates = 0;
+			}
+		}
+	}
+
+	for(unsigned lane = 0; lane < lanes->count; lane++) {
+		i8080_lockstep_save(lanes, lane);
+	}
+}
+
+void
+i8080_lockstep_run(struct i8080_cpu * const *cpus, size_t count, uint64_t cycle_budget) {
+	struct i8080_lockstep lanes = { };
+
+	while(count != 0) {
+		lanes.count = count < I8080_LOCKSTEP_LANES ? count : I8080_LOCKSTEP_LANES;
+
+		for(unsigned lane = 0; lane < I8080_LOCKSTEP_LANES; lane++) {
+			const uint64_t uptime = lane < lanes.count ? cpus[lane]->uptime_cycles : 0;
+
+			lanes.cpus[lane] = lane < lanes.count ? cpus[lane] : NULL;
+			lanes.finals[lane] = lane < lanes.count && cycle_budget < UINT64_MAX - uptime ? uptime + cycle_budget : UINT64_MAX;
+		}
+
+		i8080_lockstep_run_group(&lanes);
+
+		cpus += lanes.count;
+		count -= lanes.count;
+	}
+}
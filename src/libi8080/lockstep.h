@@ -0,0 +1,16 @@
+#ifndef I8080_LOCKSTEP_H
+#define I8080_LOCKSTEP_H
+
+#include "i8080/cpu.h"
+
+/* Number of cpus stepped together, one per 16 bits lane of a 256 bits vector */
+#define I8080_LOCKSTEP_LANES 16
+
+/* Runs each cpu as i8080_cpu_run would, for cycle_budget cycles, without clearing yield.
+ * Cpus are taken by groups of I8080_LOCKSTEP_LANES, whose registers are held in a struct-of-arrays.
+ * Lanes at the same pc executing the same opcode are stepped together, the others wait their turn */
+void
+i8080_lockstep_run(struct i8080_cpu * const *cpus, size_t count, uint64_t cycle_budget);
+
+/* I8080_LOCKSTEP_H */
+#endif
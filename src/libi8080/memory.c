@@ -0,0 +1,31 @@
+#include "memory.h"
+
+uint8_t
+i8080_cpu_load_mmio(struct i8080_cpu *cpu, uint16_t address) {
+	const struct i8080_mmio * const mmio = cpu->pages[address / I8080_PAGE_SIZE].mmio;
+
+	if(mmio == NULL || mmio->load == NULL) {
+		return 0xFF;
+	}
+
+	return mmio->load(cpu, address);
+}
+
+void
+i8080_cpu_store_mmio(struct i8080_cpu *cpu, uint16_t address, uint8_t src) {
+	const unsigned page = address / I8080_PAGE_SIZE;
+	const struct i8080_mmio * const mmio = cpu->pages[page].mmio;
+
+	cpu->dirty[page] = true;
+
+	if(cpu->clean[page] != NULL) {
+		cpu->pages[page].store = cpu->clean[page];
+		cpu->clean[page] = NULL;
+		cpu->pages[page].store[address % I8080_PAGE_SIZE] = src;
+		return;
+	}
+
+	if(mmio != NULL && mmio->store != NULL) {
+		mmio->store(cpu, address, src);
+	}
+}
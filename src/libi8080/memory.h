@@ -0,0 +1,84 @@
+#ifndef I8080_MEMORY_H
+#define I8080_MEMORY_H
+
+#include "i8080/cpu.h"
+
+#include "trace.h"
+
+/* Accesses to pages without host memory, kept out of line so the fast path stays small enough to be inlined.
+ * Stores reaching it mark their page dirty, the first store to a page write protected by a snapshot gives its mapping back */
+uint8_t
+i8080_cpu_load_mmio(struct i8080_cpu *cpu, uint16_t address);
+
+void
+i8080_cpu_store_mmio(struct i8080_cpu *cpu, uint16_t address, uint8_t src);
+
+/* Accesses return whether an mmio handler was called, for the engines caching the cpu state to check what it did */
+static inline bool
+i8080_cpu_store8(struct i8080_cpu *cpu, uint16_t address, uint8_t src) {
+	uint8_t * const store = cpu->pages[address / I8080_PAGE_SIZE].store;
+
+	I8080_TRACE_STORE(cpu, address, src);
+
+	if(store != NULL) {
+		store[address % I8080_PAGE_SIZE] = src;
+		return false;
+	}
+
+	i8080_cpu_store_mmio(cpu, address, src);
+
+	return true;
+}
+
+/* Words within a single page with host memory are accessed at once */
+static inline bool
+i8080_cpu_store16(struct i8080_cpu *cpu, uint16_t address, uint16_t src) {
+	uint8_t * const store = cpu->pages[address / I8080_PAGE_SIZE].store;
+
+	if(store != NULL && address % I8080_PAGE_SIZE != I8080_PAGE_SIZE - 1) {
+		I8080_TRACE_STORE(cpu, address, src);
+		I8080_TRACE_STORE(cpu, address + 1, src >> 8);
+		store[address % I8080_PAGE_SIZE] = src;
+		store[address % I8080_PAGE_SIZE + 1] = src >> 8;
+		return false;
+	}
+
+	return i8080_cpu_store8(cpu, address, src) | i8080_cpu_store8(cpu, address + 1, src >> 8);
+}
+
+static inline bool
+i8080_cpu_load8(struct i8080_cpu *cpu, uint16_t address, uint8_t *dst) {
+	const uint8_t * const load = cpu->pages[address / I8080_PAGE_SIZE].load;
+
+	if(load != NULL) {
+		*dst = load[address % I8080_PAGE_SIZE];
+		return false;
+	}
+
+	*dst = i8080_cpu_load_mmio(cpu, address);
+
+	return true;
+}
+
+static inline bool
+i8080_cpu_load16(struct i8080_cpu *cpu, uint16_t address, uint16_t *dst) {
+	const uint8_t * const load = cpu->pages[address / I8080_PAGE_SIZE].load;
+	uint8_t low, high;
+	bool mmio;
+
+	if(load != NULL && address % I8080_PAGE_SIZE != I8080_PAGE_SIZE - 1) {
+		*dst = (uint16_t)load[address % I8080_PAGE_SIZE + 1] << 8 | load[address % I8080_PAGE_SIZE];
+		return false;
+	}
+
+	/* As with stores, the high byte of a word at 0xFFFF is at 0x0000 */
+	mmio = i8080_cpu_load8(cpu, address, &low);
+	mmio |= i8080_cpu_load8(cpu, (uint16_t)(address + 1), &high);
+
+	*dst = (uint16_t)high << 8 | low;
+
+	return mmio;
+}
+
+/* I8080_MEMORY_H */
+#endif
@@ -0,0 +1,157 @@
+#ifdef I8080_PROFILE
+
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "profile.h"
+
+#define I8080_PROFILE_CAPACITY 1024 /* Initial number of nodes */
+
+static inline uint32_t
+i8080_profile_hash(uint32_t parent, uint16_t address) {
+	return (parent * 0x9E3779B1u) ^ address;
+}
+
+static void
+i8080_profile_insert(uint32_t *buckets, uint32_t mask, const struct i8080_profile_node *nodes, uint32_t node) {
+	uint32_t bucket = i8080_profile_hash(nodes[node].parent, nodes[node].address) & mask;
+
+	while(buckets[bucket] != 0) {
+		bucket = (bucket + 1) & mask;
+	}
+
+	buckets[bucket] = node;
+}
+
+/* Doubles the nodes and rehashes them, fails silently: new calls are then accounted to their caller */
+static bool
+i8080_profile_grow(struct i8080_profile *profile) {
+	const uint32_t capacity = profile->capacity * 2;
+	struct i8080_profile_node * const nodes = realloc(profile->nodes, capacity * sizeof(*nodes));
+	uint32_t *buckets;
+
+	if(nodes == NULL) {
+		return false;
+	}
+	profile->nodes = nodes;
+
+	buckets = calloc(capacity * 2, sizeof(*buckets));
+	if(buckets == NULL) {
+		return false;
+	}
+
+	for(uint32_t node = 1; node < profile->count; node++) {
+		i8080_profile_insert(buckets, capacity * 2 - 1, nodes, node);
+	}
+
+	free(profile->buckets);
+	profile->buckets = buckets;
+	profile->capacity = capacity;
+
+	return true;
+}
+
+static uint32_t
+i8080_profile_child(struct i8080_profile *profile, uint32_t parent, uint16_t address) {
+	const uint32_t mask = profile->capacity * 2 - 1;
+	uint32_t bucket = i8080_profile_hash(parent, address) & mask, node;
+
+	while(node = profile->buckets[bucket], node != 0) {
+		if(profile->nodes[node].parent == parent && profile->nodes[node].address == address) {
+			return node;
+		}
+		bucket = (bucket + 1) & mask;
+	}
+
+	if(profile->count == profile->capacity && !i8080_profile_grow(profile)) {
+		return parent;
+	}
+
+	node = profile->count++;
+	profile->nodes[node] = (struct i8080_profile_node) {
+		.parent = parent, .address = address,
+	};
+
+	i8080_profile_insert(profile->buckets, profile->capacity * 2 - 1, profile->nodes, node);
+
+	return node;
+}
+
+struct i8080_profile *
+i8080_profile_create(uint16_t address) {
+	struct i8080_profile * const profile = calloc(1, sizeof(*profile));
+
+	if(profile == NULL) {
+		return NULL;
+	}
+
+	profile->capacity = I8080_PROFILE_CAPACITY;
+	profile->nodes = malloc(profile->capacity * sizeof(*profile->nodes));
+	profile->buckets = calloc(profile->capacity * 2, sizeof(*profile->buckets));
+	if(profile->nodes == NULL || profile->buckets == NULL) {
+		i8080_profile_destroy(profile);
+		return NULL;
+	}
+
+	profile->nodes[0] = (struct i8080_profile_node) {
+		.address = address,
+	};
+	profile->count = 1;
+
+	return profile;
+}
+
+void
+i8080_profile_destroy(struct i8080_profile *profile) {
+
+	free(profile->buckets);
+	free(profile->nodes);
+	free(profile);
+}
+
+void
+i8080_profile_call(struct i8080_profile *profile, uint16_t next, uint16_t sp) {
+
+	if(profile->depth != I8080_PROFILE_DEPTH) {
+		profile->frames[profile->depth++] = (struct i8080_profile_frame) {
+			.node = profile->node, .sp = sp,
+		};
+		profile->node = i8080_profile_child(profile, profile->node, next);
+	}
+}
+
+void
+i8080_profile_return(struct i8080_profile *profile, uint16_t sp) {
+
+	while(profile->depth != 0 && profile->frames[profile->depth - 1].sp < sp) {
+		profile->node = profile->frames[--profile->depth].node;
+	}
+}
+
+int
+i8080_profile_write(const struct i8080_profile *profile, FILE *output) {
+	uint32_t stack[I8080_PROFILE_DEPTH + 1];
+
+	for(uint32_t node = 0; node < profile->count; node++) {
+		unsigned depth = 0;
+
+		if(profile->nodes[node].cycles == 0) {
+			continue;
+		}
+
+		for(uint32_t current = node; current != 0 && depth != I8080_PROFILE_DEPTH; current = profile->nodes[current].parent) {
+			stack[depth++] = current;
+		}
+		stack[depth++] = 0;
+
+		while(depth-- != 0) {
+			fprintf(output, depth != 0 ? "0x%04X;" : "0x%04X", profile->nodes[stack[depth]].address);
+		}
+		fprintf(output, " %" PRIu64 "\n", profile->nodes[node].cycles);
+	}
+
+	return ferror(output) ? -1 : 0;
+}
+
+/* I8080_PROFILE */
+#endif
@@ -0,0 +1,79 @@
+#ifndef I8080_PROFILE_H
+#define I8080_PROFILE_H
+
+#include <stdio.h>
+
+#include "i8080/cpu.h"
+
+/* Calls deeper than that are accounted to their caller */
+#define I8080_PROFILE_DEPTH 256
+
+/* A function in a given call stack: the node of its caller and its entry point */
+struct i8080_profile_node {
+	uint32_t parent;
+	uint16_t address;
+	uint64_t cycles; /* Cycles spent in the function itself */
+};
+
+/* Return addresses pushed by calls, with the stack pointer they were pushed at:
+ * returning above it pops the frame, along with the frames of calls which never returned */
+struct i8080_profile_frame {
+	uint32_t node;
+	uint16_t sp;
+};
+
+struct i8080_profile {
+	uint32_t node; /* Node of the function currently executing, the root is node 0 */
+	unsigned depth;
+	struct i8080_profile_frame frames[I8080_PROFILE_DEPTH];
+	uint32_t count, capacity;
+	struct i8080_profile_node *nodes;
+	uint32_t *buckets; /* Open addressing on (parent, address), twice the capacity of nodes, 0 is empty */
+	uint64_t cycles[I8080_MEMORY_SIZE];
+};
+
+/* Engines account each instruction executed, from its address to next, with the stack pointer once it executed.
+ * Compiled out entirely without I8080_PROFILE, and a single test while the cpu is not being profiled */
+#ifdef I8080_PROFILE
+#define I8080_PROFILE_ACCOUNT(cpu, address, opcode, next, sp, cycles) do {\
+	if((cpu)->profile != NULL) {\
+		i8080_profile_account((cpu)->profile, (address), (opcode), (next), (sp), (cycles));\
+	}\
+} while(0)
+#else
+/* Only references address, which engines may keep in a local just for profiling */
+#define I8080_PROFILE_ACCOUNT(cpu, address, opcode, next, sp, cycles) do { (void)sizeof(address); } while(0)
+#endif
+
+struct i8080_profile *
+i8080_profile_create(uint16_t address);
+
+void
+i8080_profile_destroy(struct i8080_profile *profile);
+
+void
+i8080_profile_call(struct i8080_profile *profile, uint16_t next, uint16_t sp);
+
+void
+i8080_profile_return(struct i8080_profile *profile, uint16_t sp);
+
+static inline void
+i8080_profile_account(struct i8080_profile *profile, uint16_t address, uint8_t opcode, uint16_t next, uint16_t sp, unsigned cycles) {
+
+	profile->cycles[address] += cycles;
+	profile->nodes[profile->node].cycles += cycles;
+
+	if((opcode & 0xC7) == 0xC7 /* RST, and interrupts */
+		|| ((opcode & 0xCF) == 0xCD || (opcode & 0xC7) == 0xC4) && next != (uint16_t)(address + 3)) { /* Calls taken */
+		i8080_profile_call(profile, next, sp);
+	} else if((opcode & 0xEF) == 0xC9 || (opcode & 0xC7) == 0xC0) { /* Returns, taken or not */
+		i8080_profile_return(profile, sp);
+	}
+}
+
+/* One line per call stack, its frames from the root separated by semicolons, and the cycles spent in its last frame */
+int
+i8080_profile_write(const struct i8080_profile *profile, FILE *output);
+
+/* I8080_PROFILE_H */
+#endif
@@ -0,0 +1,1166 @@
+#include "i8080/cpu.h"
+
+#include "threaded.h"
+#include "conditions.h"
+#include "memory.h"
+#include "profile.h"
+#include "histogram.h"
+
+/* The threaded engine keeps the whole register file in locals while it runs, and
+ * folds operand fetch in each opcode handler, the following macros help manipulate them */
+#define I8080_THREADED_PAIR(hi, lo) ((uint16_t)(hi) << 8 | (lo))
+#define I8080_THREADED_SPLIT(hi, lo, src) ((hi) = (src) >> 8, (lo) = (src))
+
+/* Immediates are read from the current code page when they do not cross its end */
+#define I8080_THREADED_IMM8() do {\
+	if(code != NULL && pc % I8080_PAGE_SIZE < I8080_PAGE_SIZE - 1) {\
+		imm = code[pc % I8080_PAGE_SIZE + 1];\
+	} else {\
+		I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, pc + 1, &m));\
+		imm = m;\
+	}\
+} while(0)
+
+#define I8080_THREADED_IMM16() do {\
+	if(code != NULL && pc % I8080_PAGE_SIZE < I8080_PAGE_SIZE - 2) {\
+		imm = (uint16_t)code[pc % I8080_PAGE_SIZE + 2] << 8 | code[pc % I8080_PAGE_SIZE + 1];\
+	} else {\
+		I8080_THREADED_ACCESS(i8080_cpu_load16(cpu, pc + 1, &imm));\
+	}\
+} while(0)
+
+/* Mmio handlers may stop the cpu or request the run to end, which then ends after the current instruction
+ * as with the other engines, by moving the deadline. Accesses through host memory are not checked */
+#define I8080_THREADED_ACCESS(mmio) do {\
+	if((mmio) && (cpu->stopped || cpu->yield)) {\
+		deadline = 0;\
+	}\
+} while(0)
+
+/* Registers must be written back before leaving the engine or calling external code, and reloaded after */
+#define I8080_THREADED_SAVE() do {\
+	cpu->registers.a = a, cpu->registers.f = f;\
+	cpu->registers.b = b, cpu->registers.c = c;\
+	cpu->registers.d = d, cpu->registers.e = e;\
+	cpu->registers.h = h, cpu->registers.l = l;\
+	cpu->pc = pc, cpu->sp = sp;\
+	cpu->uptime_cycles = cycles;\
+} while(0)
+
+#define I8080_THREADED_RESTORE() do {\
+	a = cpu->registers.a, f = cpu->registers.f;\
+	b = cpu->registers.b, c = cpu->registers.c;\
+	d = cpu->registers.d, e = cpu->registers.e;\
+	h = cpu->registers.h, l = cpu->registers.l;\
+	pc = cpu->pc, sp = cpu->sp;\
+	cycles = cpu->uptime_cycles;\
+	code_page = I8080_PAGE_COUNT;\
+} while(0)
+
+/* Opcodes are fetched through the host memory of the current code page, looked up only when pc leaves it */
+#define I8080_THREADED_FETCH() do {\
+	if(pc / I8080_PAGE_SIZE != code_page) {\
+		code_page = pc / I8080_PAGE_SIZE;\
+		code = cpu->pages[code_page].load;\
+	}\
+	if(code != NULL) {\
+		opcode = code[pc % I8080_PAGE_SIZE];\
+	} else {\
+		opcode = i8080_cpu_load_mmio(cpu, pc);\
+		I8080_THREADED_ACCESS(true);\
+	}\
+	I8080_HISTOGRAM_COUNT(cpu, opcode);\
+} while(0)
+
+/* The address of the instruction being executed is only tracked when profiling is built in */
+#ifdef I8080_PROFILE
+#define I8080_THREADED_PROFILE(duration) do {\
+	I8080_PROFILE_ACCOUNT(cpu, address, opcode, pc, sp, duration);\
+	address = pc;\
+} while(0)
+#else
+#define I8080_THREADED_PROFILE(duration) do { } while(0)
+#endif
+
+/* Advance past the current instruction, account its cycles and directly jump to the next opcode's handler */
+#define I8080_THREADED_NEXT(length, duration) do {\
+	pc += (length);\
+	cycles += (duration);\
+	I8080_THREADED_PROFILE(duration);\
+	if(cycles >= deadline) {\
+		goto i8080_threaded_exit;\
+	}\
+	I8080_THREADED_FETCH();\
+	goto *dispatch[opcode];\
+} while(0)
+
+/* External code may stop the cpu or request the run to end, so we check for it once the callback returns */
+#define I8080_THREADED_IO(callback, duration) do {\
+	I8080_THREADED_SAVE();\
+	cpu->io->callback(cpu, imm);\
+	I8080_THREADED_RESTORE();\
+	if(cpu->stopped || cpu->yield) {\
+		cycles += (duration);\
+		I8080_THREADED_PROFILE(duration);\
+		goto i8080_threaded_exit;\
+	}\
+	I8080_THREADED_NEXT(0, duration);\
+} while(0)
+
+#define I8080_THREADED_CALL(address, duration) do {\
+	sp -= sizeof(uint16_t);\
+	I8080_THREADED_ACCESS(i8080_cpu_store16(cpu, sp, pc));\
+	pc = (address);\
+	I8080_THREADED_NEXT(0, duration);\
+} while(0)
+
+#define I8080_THREADED_JUMP_IF(condition) do {\
+	I8080_THREADED_IMM16();\
+	pc += 3;\
+	if(condition) {\
+		pc = imm;\
+	}\
+	I8080_THREADED_NEXT(0, 10);\
+} while(0)
+
+#define I8080_THREADED_CALL_IF(condition) do {\
+	I8080_THREADED_IMM16();\
+	pc += 3;\
+	if(condition) {\
+		I8080_THREADED_CALL(imm, 17);\
+	}\
+	I8080_THREADED_NEXT(0, 11);\
+} while(0)
+
+#define I8080_THREADED_RET_IF(condition) do {\
+	pc += 1;\
+	if(condition) {\
+		I8080_THREADED_ACCESS(i8080_cpu_load16(cpu, sp, &pc));\
+		sp += sizeof(uint16_t);\
+		I8080_THREADED_NEXT(0, 11);\
+	}\
+	I8080_THREADED_NEXT(0, 5);\
+} while(0)
+
+/*******
+ * ALU *
+ *******/
+
+static inline void
+i8080_threaded_inr(uint8_t *f, uint8_t *dst) {
+
+	*f = *f & ~I8080_MASK_CONDITIONS_SZ_A_P__
+		| i8080_conditions_inr(*dst);
+	*dst += 1;
+}
+
+static inline void
+i8080_threaded_dcr(uint8_t *f, uint8_t *dst) {
+
+	*f = *f & ~I8080_MASK_CONDITIONS_SZ_A_P__
+		| i8080_conditions_dcr(*dst);
+	*dst -= 1;
+}
+
+static inline void
+i8080_threaded_dad(uint8_t *h, uint8_t *l, uint8_t *f, uint16_t src) {
+	const uint32_t sum = (uint32_t)I8080_THREADED_PAIR(*h, *l) + src;
+
+	*f = *f & ~I8080_MASK_CONDITION_CARRY
+		| sum >> 16 << I8080_BIT_CONDITION_CARRY;
+	I8080_THREADED_SPLIT(*h, *l, sum);
+}
+
+static inline void
+i8080_threaded_daa(uint8_t *a, uint8_t *f) {
+	uint8_t low = *a & 0x0F, src = 0, carry = 0;
+
+	if(low > 9
+		|| (*f & I8080_MASK_CONDITION_AUXILIARY_CARRY) != 0) {
+		src |= 0x06;
+		low += src;
+	}
+
+	if(((*a >> 4) + (low >> 4)) > 9
+		|| (*f & I8080_MASK_CONDITION_CARRY) != 0) {
+		src |= 0x60;
+		carry = I8080_MASK_CONDITION_CARRY;
+	}
+
+	const uint8_t res = *a + src;
+
+	*f = *f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
+		| i8080_conditions_szp(res)
+		| (*a ^ src ^ res) & I8080_MASK_CONDITION_AUXILIARY_CARRY
+		| carry;
+	*a = res;
+}
+
+static inline void
+i8080_threaded_add(uint8_t *a, uint8_t *f, uint8_t src) {
+
+	*f = *f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
+		| i8080_conditions_add(*a, src, 0);
+	*a += src;
+}
+
+static inline void
+i8080_threaded_adc(uint8_t *a, uint8_t *f, uint8_t src) {
+	const uint8_t carry = (*f & I8080_MASK_CONDITION_CARRY) >> I8080_BIT_CONDITION_CARRY;
+
+	*f = *f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
+		| i8080_conditions_add(*a, src, carry);
+	*a += src + carry;
+}
+
+static inline void
+i8080_threaded_sub(uint8_t *a, uint8_t *f, uint8_t src) {
+
+	*f = *f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
+		| i8080_conditions_sub(*a, src, 0);
+	*a -= src;
+}
+
+static inline void
+i8080_threaded_sbb(uint8_t *a, uint8_t *f, uint8_t src) {
+	const uint8_t borrow = (*f & I8080_MASK_CONDITION_CARRY) >> I8080_BIT_CONDITION_CARRY;
+
+	*f = *f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
+		| i8080_conditions_sub(*a, src, borrow);
+	*a -= src + borrow;
+}
+
+static inline void
+i8080_threaded_ana(uint8_t *a, uint8_t *f, uint8_t src) {
+
+	*f = *f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
+		| i8080_conditions_ana(*a, src);
+	*a &= src;
+}
+
+static inline void
+i8080_threaded_xra(uint8_t *a, uint8_t *f, uint8_t src) {
+
+	*a ^= src;
+	*f = *f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
+		| i8080_conditions_szp(*a);
+}
+
+static inline void
+i8080_threaded_ora(uint8_t *a, uint8_t *f, uint8_t src) {
+
+	*a |= src;
+	*f = *f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
+		| i8080_conditions_szp(*a);
+}
+
+static inline void
+i8080_threaded_cmp(uint8_t *a, uint8_t *f, uint8_t src) {
+
+	*f = *f & ~I8080_MASK_CONDITIONS_SZ_A_P_C
+		| i8080_conditions_sub(*a, src, 0);
+}
+
+/**********
+ * Engine *
+ **********/
+
+void
+i8080_threaded_run(struct i8080_cpu *cpu, uint64_t deadline) {
+	static const void * const dispatch[] = {
+		&&opcode_0x00, &&opcode_0x01, &&opcode_0x02, &&opcode_0x03,
+		&&opcode_0x04, &&opcode_0x05, &&opcode_0x06, &&opcode_0x07,
+		&&opcode_0x08, &&opcode_0x09, &&opcode_0x0A, &&opcode_0x0B,
+		&&opcode_0x0C, &&opcode_0x0D, &&opcode_0x0E, &&opcode_0x0F,
+		&&opcode_0x10, &&opcode_0x11, &&opcode_0x12, &&opcode_0x13,
+		&&opcode_0x14, &&opcode_0x15, &&opcode_0x16, &&opcode_0x17,
+		&&opcode_0x18, &&opcode_0x19, &&opcode_0x1A, &&opcode_0x1B,
+		&&opcode_0x1C, &&opcode_0x1D, &&opcode_0x1E, &&opcode_0x1F,
+		&&opcode_0x20, &&opcode_0x21, &&opcode_0x22, &&opcode_0x23,
+		&&opcode_0x24, &&opcode_0x25, &&opcode_0x26, &&opcode_0x27,
+		&&opcode_0x28, &&opcode_0x29, &&opcode_0x2A, &&opcode_0x2B,
+		&&opcode_0x2C, &&opcode_0x2D, &&opcode_0x2E, &&opcode_0x2F,
+		&&opcode_0x30, &&opcode_0x31, &&opcode_0x32, &&opcode_0x33,
+		&&opcode_0x34, &&opcode_0x35, &&opcode_0x36, &&opcode_0x37,
+		&&opcode_0x38, &&opcode_0x39, &&opcode_0x3A, &&opcode_0x3B,
+		&&opcode_0x3C, &&opcode_0x3D, &&opcode_0x3E, &&opcode_0x3F,
+		&&opcode_0x40, &&opcode_0x41, &&opcode_0x42, &&opcode_0x43,
+		&&opcode_0x44, &&opcode_0x45, &&opcode_0x46, &&opcode_0x47,
+		&&opcode_0x48, &&opcode_0x49, &&opcode_0x4A, &&opcode_0x4B,
+		&&opcode_0x4C, &&opcode_0x4D, &&opcode_0x4E, &&opcode_0x4F,
+		&&opcode_0x50, &&opcode_0x51, &&opcode_0x52, &&opcode_0x53,
+		&&opcode_0x54, &&opcode_0x55, &&opcode_0x56, &&opcode_0x57,
+		&&opcode_0x58, &&opcode_0x59, &&opcode_0x5A, &&opcode_0x5B,
+		&&opcode_0x5C, &&opcode_0x5D, &&opcode_0x5E, &&opcode_0x5F,
+		&&opcode_0x60, &&opcode_0x61, &&opcode_0x62, &&opcode_0x63,
+		&&opcode_0x64, &&opcode_0x65, &&opcode_0x66, &&opcode_0x67,
+		&&opcode_0x68, &&opcode_0x69, &&opcode_0x6A, &&opcode_0x6B,
+		&&opcode_0x6C, &&opcode_0x6D, &&opcode_0x6E, &&opcode_0x6F,
+		&&opcode_0x70, &&opcode_0x71, &&opcode_0x72, &&opcode_0x73,
+		&&opcode_0x74, &&opcode_0x75, &&opcode_0x76, &&opcode_0x77,
+		&&opcode_0x78, &&opcode_0x79, &&opcode_0x7A, &&opcode_0x7B,
+		&&opcode_0x7C, &&opcode_0x7D, &&opcode_0x7E, &&opcode_0x7F,
+		&&opcode_0x80, &&opcode_0x81, &&opcode_0x82, &&opcode_0x83,
+		&&opcode_0x84, &&opcode_0x85, &&opcode_0x86, &&opcode_0x87,
+		&&opcode_0x88, &&opcode_0x89, &&opcode_0x8A, &&opcode_0x8B,
+		&&opcode_0x8C, &&opcode_0x8D, &&opcode_0x8E, &&opcode_0x8F,
+		&&opcode_0x90, &&opcode_0x91, &&opcode_0x92, &&opcode_0x93,
+		&&opcode_0x94, &&opcode_0x95, &&opcode_0x96, &&opcode_0x97,
+		&&opcode_0x98, &&opcode_0x99, &&opcode_0x9A, &&opcode_0x9B,
+		&&opcode_0x9C, &&opcode_0x9D, &&opcode_0x9E, &&opcode_0x9F,
+		&&opcode_0xA0, &&opcode_0xA1, &&opcode_0xA2, &&opcode_0xA3,
+		&&opcode_0xA4, &&opcode_0xA5, &&opcode_0xA6, &&opcode_0xA7,
+		&&opcode_0xA8, &&opcode_0xA9, &&opcode_0xAA, &&opcode_0xAB,
+		&&opcode_0xAC, &&opcode_0xAD, &&opcode_0xAE, &&opcode_0xAF,
+		&&opcode_0xB0, &&opcode_0xB1, &&opcode_0xB2, &&opcode_0xB3,
+		&&opcode_0xB4, &&opcode_0xB5, &&opcode_0xB6, &&opcode_0xB7,
+		&&opcode_0xB8, &&opcode_0xB9, &&opcode_0xBA, &&opcode_0xBB,
+		&&opcode_0xBC, &&opcode_0xBD, &&opcode_0xBE, &&opcode_0xBF,
+		&&opcode_0xC0, &&opcode_0xC1, &&opcode_0xC2, &&opcode_0xC3,
+		&&opcode_0xC4, &&opcode_0xC5, &&opcode_0xC6, &&opcode_0xC7,
+		&&opcode_0xC8, &&opcode_0xC9, &&opcode_0xCA, &&opcode_0xCB,
+		&&opcode_0xCC, &&opcode_0xCD, &&opcode_0xCE, &&opcode_0xCF,
+		&&opcode_0xD0, &&opcode_0xD1, &&opcode_0xD2, &&opcode_0xD3,
+		&&opcode_0xD4, &&opcode_0xD5, &&opcode_0xD6, &&opcode_0xD7,
+		&&opcode_0xD8, &&opcode_0xD9, &&opcode_0xDA, &&opcode_0xDB,
+		&&opcode_0xDC, &&opcode_0xDD, &&opcode_0xDE, &&opcode_0xDF,
+		&&opcode_0xE0, &&opcode_0xE1, &&opcode_0xE2, &&opcode_0xE3,
+		&&opcode_0xE4, &&opcode_0xE5, &&opcode_0xE6, &&opcode_0xE7,
+		&&opcode_0xE8, &&opcode_0xE9, &&opcode_0xEA, &&opcode_0xEB,
+		&&opcode_0xEC, &&opcode_0xED, &&opcode_0xEE, &&opcode_0xEF,
+		&&opcode_0xF0, &&opcode_0xF1, &&opcode_0xF2, &&opcode_0xF3,
+		&&opcode_0xF4, &&opcode_0xF5, &&opcode_0xF6, &&opcode_0xF7,
+		&&opcode_0xF8, &&opcode_0xF9, &&opcode_0xFA, &&opcode_0xFB,
+		&&opcode_0xFC, &&opcode_0xFD, &&opcode_0xFE, &&opcode_0xFF,
+	};
+	uint8_t a, f, b, c, d, e, h, l, m, opcode;
+	uint16_t pc, sp, imm;
+	const uint8_t *code = NULL;
+	unsigned code_page;
+	uint64_t cycles;
+#ifdef I8080_PROFILE
+	uint16_t address;
+#endif
+
+	if(cpu->stopped) {
+		return;
+	}
+
+	I8080_THREADED_RESTORE();
+#ifdef I8080_PROFILE
+	address = pc;
+#endif
+
+	if(cycles >= deadline) {
+		return;
+	}
+
+	I8080_THREADED_FETCH();
+	goto *dispatch[opcode];
+
+opcode_0x00: /* NOP */
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x01: /* LXI B D16 */
+	I8080_THREADED_IMM16();
+	I8080_THREADED_SPLIT(b, c, imm);
+	I8080_THREADED_NEXT(3, 10);
+opcode_0x02: /* STAX B */
+	I8080_THREADED_ACCESS(i8080_cpu_store8(cpu, I8080_THREADED_PAIR(b, c), a));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x03: /* INX B */
+	I8080_THREADED_SPLIT(b, c, I8080_THREADED_PAIR(b, c) + 1);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x04: /* INR B */
+	i8080_threaded_inr(&f, &b);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x05: /* DCR B */
+	i8080_threaded_dcr(&f, &b);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x06: /* MVI B D8 */
+	I8080_THREADED_IMM8();
+	b = imm;
+	I8080_THREADED_NEXT(2, 7);
+opcode_0x07: /* RLC */
+	f = f & ~I8080_MASK_CONDITION_CARRY | a >> 7 << I8080_BIT_CONDITION_CARRY;
+	a = a << 1 | a >> 7;
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x08: /* NOP */
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x09: /* DAD B */
+	i8080_threaded_dad(&h, &l, &f, I8080_THREADED_PAIR(b, c));
+	I8080_THREADED_NEXT(1, 10);
+opcode_0x0A: /* LDAX B */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(b, c), &a));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x0B: /* DCX B */
+	I8080_THREADED_SPLIT(b, c, I8080_THREADED_PAIR(b, c) - 1);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x0C: /* INR C */
+	i8080_threaded_inr(&f, &c);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x0D: /* DCR C */
+	i8080_threaded_dcr(&f, &c);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x0E: /* MVI C D8 */
+	I8080_THREADED_IMM8();
+	c = imm;
+	I8080_THREADED_NEXT(2, 7);
+opcode_0x0F: /* RRC */
+	f = f & ~I8080_MASK_CONDITION_CARRY | (a & 1) << I8080_BIT_CONDITION_CARRY;
+	a = a >> 1 | a << 7;
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x10: /* NOP */
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x11: /* LXI D D16 */
+	I8080_THREADED_IMM16();
+	I8080_THREADED_SPLIT(d, e, imm);
+	I8080_THREADED_NEXT(3, 10);
+opcode_0x12: /* STAX D */
+	I8080_THREADED_ACCESS(i8080_cpu_store8(cpu, I8080_THREADED_PAIR(d, e), a));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x13: /* INX D */
+	I8080_THREADED_SPLIT(d, e, I8080_THREADED_PAIR(d, e) + 1);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x14: /* INR D */
+	i8080_threaded_inr(&f, &d);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x15: /* DCR D */
+	i8080_threaded_dcr(&f, &d);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x16: /* MVI D D8 */
+	I8080_THREADED_IMM8();
+	d = imm;
+	I8080_THREADED_NEXT(2, 7);
+opcode_0x17: /* RAL */
+	m = (f & I8080_MASK_CONDITION_CARRY) >> I8080_BIT_CONDITION_CARRY;
+	f = f & ~I8080_MASK_CONDITION_CARRY | a >> 7 << I8080_BIT_CONDITION_CARRY;
+	a = a << 1 | m;
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x18: /* NOP */
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x19: /* DAD D */
+	i8080_threaded_dad(&h, &l, &f, I8080_THREADED_PAIR(d, e));
+	I8080_THREADED_NEXT(1, 10);
+opcode_0x1A: /* LDAX D */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(d, e), &a));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x1B: /* DCX D */
+	I8080_THREADED_SPLIT(d, e, I8080_THREADED_PAIR(d, e) - 1);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x1C: /* INR E */
+	i8080_threaded_inr(&f, &e);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x1D: /* DCR E */
+	i8080_threaded_dcr(&f, &e);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x1E: /* MVI E D8 */
+	I8080_THREADED_IMM8();
+	e = imm;
+	I8080_THREADED_NEXT(2, 7);
+opcode_0x1F: /* RAR */
+	m = (f & I8080_MASK_CONDITION_CARRY) << (7 - I8080_BIT_CONDITION_CARRY);
+	f = f & ~I8080_MASK_CONDITION_CARRY | (a & 1) << I8080_BIT_CONDITION_CARRY;
+	a = a >> 1 | m;
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x20: /* NOP */
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x21: /* LXI H D16 */
+	I8080_THREADED_IMM16();
+	I8080_THREADED_SPLIT(h, l, imm);
+	I8080_THREADED_NEXT(3, 10);
+opcode_0x22: /* SHLD A16 */
+	I8080_THREADED_IMM16();
+	I8080_THREADED_ACCESS(i8080_cpu_store16(cpu, imm, I8080_THREADED_PAIR(h, l)));
+	I8080_THREADED_NEXT(3, 16);
+opcode_0x23: /* INX H */
+	I8080_THREADED_SPLIT(h, l, I8080_THREADED_PAIR(h, l) + 1);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x24: /* INR H */
+	i8080_threaded_inr(&f, &h);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x25: /* DCR H */
+	i8080_threaded_dcr(&f, &h);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x26: /* MVI H D8 */
+	I8080_THREADED_IMM8();
+	h = imm;
+	I8080_THREADED_NEXT(2, 7);
+opcode_0x27: /* DAA */
+	i8080_threaded_daa(&a, &f);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x28: /* NOP */
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x29: /* DAD H */
+	i8080_threaded_dad(&h, &l, &f, I8080_THREADED_PAIR(h, l));
+	I8080_THREADED_NEXT(1, 10);
+opcode_0x2A: /* LHLD A16 */
+	I8080_THREADED_IMM16();
+	I8080_THREADED_ACCESS(i8080_cpu_load16(cpu, imm, &imm));
+	I8080_THREADED_SPLIT(h, l, imm);
+	I8080_THREADED_NEXT(3, 16);
+opcode_0x2B: /* DCX H */
+	I8080_THREADED_SPLIT(h, l, I8080_THREADED_PAIR(h, l) - 1);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x2C: /* INR L */
+	i8080_threaded_inr(&f, &l);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x2D: /* DCR L */
+	i8080_threaded_dcr(&f, &l);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x2E: /* MVI L D8 */
+	I8080_THREADED_IMM8();
+	l = imm;
+	I8080_THREADED_NEXT(2, 7);
+opcode_0x2F: /* CMA */
+	a = ~a;
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x30: /* NOP */
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x31: /* LXI SP D16 */
+	I8080_THREADED_IMM16();
+	sp = imm;
+	I8080_THREADED_NEXT(3, 10);
+opcode_0x32: /* STA A16 */
+	I8080_THREADED_IMM16();
+	I8080_THREADED_ACCESS(i8080_cpu_store8(cpu, imm, a));
+	I8080_THREADED_NEXT(3, 13);
+opcode_0x33: /* INX SP */
+	sp = sp + 1;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x34: /* INR M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &m));
+	i8080_threaded_inr(&f, &m);
+	I8080_THREADED_ACCESS(i8080_cpu_store8(cpu, I8080_THREADED_PAIR(h, l), m));
+	I8080_THREADED_NEXT(1, 10);
+opcode_0x35: /* DCR M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &m));
+	i8080_threaded_dcr(&f, &m);
+	I8080_THREADED_ACCESS(i8080_cpu_store8(cpu, I8080_THREADED_PAIR(h, l), m));
+	I8080_THREADED_NEXT(1, 10);
+opcode_0x36: /* MVI M D8 */
+	I8080_THREADED_IMM8();
+	I8080_THREADED_ACCESS(i8080_cpu_store8(cpu, I8080_THREADED_PAIR(h, l), imm));
+	I8080_THREADED_NEXT(2, 10);
+opcode_0x37: /* STC */
+	f |= I8080_MASK_CONDITION_CARRY;
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x38: /* NOP */
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x39: /* DAD SP */
+	i8080_threaded_dad(&h, &l, &f, sp);
+	I8080_THREADED_NEXT(1, 10);
+opcode_0x3A: /* LDA A16 */
+	I8080_THREADED_IMM16();
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, imm, &a));
+	I8080_THREADED_NEXT(3, 13);
+opcode_0x3B: /* DCX SP */
+	sp = sp - 1;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x3C: /* INR A */
+	i8080_threaded_inr(&f, &a);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x3D: /* DCR A */
+	i8080_threaded_dcr(&f, &a);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x3E: /* MVI A D8 */
+	I8080_THREADED_IMM8();
+	a = imm;
+	I8080_THREADED_NEXT(2, 7);
+opcode_0x3F: /* CMC */
+	f ^= I8080_MASK_CONDITION_CARRY;
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x40: /* MOV B B */
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x41: /* MOV B C */
+	b = c;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x42: /* MOV B D */
+	b = d;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x43: /* MOV B E */
+	b = e;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x44: /* MOV B H */
+	b = h;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x45: /* MOV B L */
+	b = l;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x46: /* MOV B M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &b));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x47: /* MOV B A */
+	b = a;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x48: /* MOV C B */
+	c = b;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x49: /* MOV C C */
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x4A: /* MOV C D */
+	c = d;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x4B: /* MOV C E */
+	c = e;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x4C: /* MOV C H */
+	c = h;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x4D: /* MOV C L */
+	c = l;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x4E: /* MOV C M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &c));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x4F: /* MOV C A */
+	c = a;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x50: /* MOV D B */
+	d = b;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x51: /* MOV D C */
+	d = c;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x52: /* MOV D D */
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x53: /* MOV D E */
+	d = e;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x54: /* MOV D H */
+	d = h;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x55: /* MOV D L */
+	d = l;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x56: /* MOV D M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &d));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x57: /* MOV D A */
+	d = a;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x58: /* MOV E B */
+	e = b;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x59: /* MOV E C */
+	e = c;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x5A: /* MOV E D */
+	e = d;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x5B: /* MOV E E */
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x5C: /* MOV E H */
+	e = h;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x5D: /* MOV E L */
+	e = l;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x5E: /* MOV E M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &e));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x5F: /* MOV E A */
+	e = a;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x60: /* MOV H B */
+	h = b;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x61: /* MOV H C */
+	h = c;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x62: /* MOV H D */
+	h = d;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x63: /* MOV H E */
+	h = e;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x64: /* MOV H H */
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x65: /* MOV H L */
+	h = l;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x66: /* MOV H M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &h));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x67: /* MOV H A */
+	h = a;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x68: /* MOV L B */
+	l = b;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x69: /* MOV L C */
+	l = c;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x6A: /* MOV L D */
+	l = d;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x6B: /* MOV L E */
+	l = e;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x6C: /* MOV L H */
+	l = h;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x6D: /* MOV L L */
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x6E: /* MOV L M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &l));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x6F: /* MOV L A */
+	l = a;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x70: /* MOV M B */
+	I8080_THREADED_ACCESS(i8080_cpu_store8(cpu, I8080_THREADED_PAIR(h, l), b));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x71: /* MOV M C */
+	I8080_THREADED_ACCESS(i8080_cpu_store8(cpu, I8080_THREADED_PAIR(h, l), c));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x72: /* MOV M D */
+	I8080_THREADED_ACCESS(i8080_cpu_store8(cpu, I8080_THREADED_PAIR(h, l), d));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x73: /* MOV M E */
+	I8080_THREADED_ACCESS(i8080_cpu_store8(cpu, I8080_THREADED_PAIR(h, l), e));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x74: /* MOV M H */
+	I8080_THREADED_ACCESS(i8080_cpu_store8(cpu, I8080_THREADED_PAIR(h, l), h));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x75: /* MOV M L */
+	I8080_THREADED_ACCESS(i8080_cpu_store8(cpu, I8080_THREADED_PAIR(h, l), l));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x76: /* HLT */
+	pc++;
+	cycles += 7;
+	I8080_THREADED_PROFILE(7);
+	cpu->stopped = 1;
+	goto i8080_threaded_exit;
+opcode_0x77: /* MOV M A */
+	I8080_THREADED_ACCESS(i8080_cpu_store8(cpu, I8080_THREADED_PAIR(h, l), a));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x78: /* MOV A B */
+	a = b;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x79: /* MOV A C */
+	a = c;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x7A: /* MOV A D */
+	a = d;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x7B: /* MOV A E */
+	a = e;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x7C: /* MOV A H */
+	a = h;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x7D: /* MOV A L */
+	a = l;
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x7E: /* MOV A M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &a));
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x7F: /* MOV A A */
+	I8080_THREADED_NEXT(1, 5);
+opcode_0x80: /* ADD B */
+	i8080_threaded_add(&a, &f, b);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x81: /* ADD C */
+	i8080_threaded_add(&a, &f, c);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x82: /* ADD D */
+	i8080_threaded_add(&a, &f, d);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x83: /* ADD E */
+	i8080_threaded_add(&a, &f, e);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x84: /* ADD H */
+	i8080_threaded_add(&a, &f, h);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x85: /* ADD L */
+	i8080_threaded_add(&a, &f, l);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x86: /* ADD M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &m));
+	i8080_threaded_add(&a, &f, m);
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x87: /* ADD A */
+	i8080_threaded_add(&a, &f, a);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x88: /* ADC B */
+	i8080_threaded_adc(&a, &f, b);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x89: /* ADC C */
+	i8080_threaded_adc(&a, &f, c);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x8A: /* ADC D */
+	i8080_threaded_adc(&a, &f, d);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x8B: /* ADC E */
+	i8080_threaded_adc(&a, &f, e);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x8C: /* ADC H */
+	i8080_threaded_adc(&a, &f, h);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x8D: /* ADC L */
+	i8080_threaded_adc(&a, &f, l);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x8E: /* ADC M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &m));
+	i8080_threaded_adc(&a, &f, m);
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x8F: /* ADC A */
+	i8080_threaded_adc(&a, &f, a);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x90: /* SUB B */
+	i8080_threaded_sub(&a, &f, b);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x91: /* SUB C */
+	i8080_threaded_sub(&a, &f, c);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x92: /* SUB D */
+	i8080_threaded_sub(&a, &f, d);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x93: /* SUB E */
+	i8080_threaded_sub(&a, &f, e);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x94: /* SUB H */
+	i8080_threaded_sub(&a, &f, h);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x95: /* SUB L */
+	i8080_threaded_sub(&a, &f, l);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x96: /* SUB M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &m));
+	i8080_threaded_sub(&a, &f, m);
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x97: /* SUB A */
+	i8080_threaded_sub(&a, &f, a);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x98: /* SBB B */
+	i8080_threaded_sbb(&a, &f, b);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x99: /* SBB C */
+	i8080_threaded_sbb(&a, &f, c);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x9A: /* SBB D */
+	i8080_threaded_sbb(&a, &f, d);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x9B: /* SBB E */
+	i8080_threaded_sbb(&a, &f, e);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x9C: /* SBB H */
+	i8080_threaded_sbb(&a, &f, h);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x9D: /* SBB L */
+	i8080_threaded_sbb(&a, &f, l);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0x9E: /* SBB M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &m));
+	i8080_threaded_sbb(&a, &f, m);
+	I8080_THREADED_NEXT(1, 7);
+opcode_0x9F: /* SBB A */
+	i8080_threaded_sbb(&a, &f, a);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xA0: /* ANA B */
+	i8080_threaded_ana(&a, &f, b);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xA1: /* ANA C */
+	i8080_threaded_ana(&a, &f, c);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xA2: /* ANA D */
+	i8080_threaded_ana(&a, &f, d);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xA3: /* ANA E */
+	i8080_threaded_ana(&a, &f, e);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xA4: /* ANA H */
+	i8080_threaded_ana(&a, &f, h);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xA5: /* ANA L */
+	i8080_threaded_ana(&a, &f, l);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xA6: /* ANA M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &m));
+	i8080_threaded_ana(&a, &f, m);
+	I8080_THREADED_NEXT(1, 7);
+opcode_0xA7: /* ANA A */
+	i8080_threaded_ana(&a, &f, a);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xA8: /* XRA B */
+	i8080_threaded_xra(&a, &f, b);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xA9: /* XRA C */
+	i8080_threaded_xra(&a, &f, c);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xAA: /* XRA D */
+	i8080_threaded_xra(&a, &f, d);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xAB: /* XRA E */
+	i8080_threaded_xra(&a, &f, e);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xAC: /* XRA H */
+	i8080_threaded_xra(&a, &f, h);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xAD: /* XRA L */
+	i8080_threaded_xra(&a, &f, l);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xAE: /* XRA M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &m));
+	i8080_threaded_xra(&a, &f, m);
+	I8080_THREADED_NEXT(1, 7);
+opcode_0xAF: /* XRA A */
+	i8080_threaded_xra(&a, &f, a);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xB0: /* ORA B */
+	i8080_threaded_ora(&a, &f, b);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xB1: /* ORA C */
+	i8080_threaded_ora(&a, &f, c);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xB2: /* ORA D */
+	i8080_threaded_ora(&a, &f, d);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xB3: /* ORA E */
+	i8080_threaded_ora(&a, &f, e);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xB4: /* ORA H */
+	i8080_threaded_ora(&a, &f, h);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xB5: /* ORA L */
+	i8080_threaded_ora(&a, &f, l);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xB6: /* ORA M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &m));
+	i8080_threaded_ora(&a, &f, m);
+	I8080_THREADED_NEXT(1, 7);
+opcode_0xB7: /* ORA A */
+	i8080_threaded_ora(&a, &f, a);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xB8: /* CMP B */
+	i8080_threaded_cmp(&a, &f, b);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xB9: /* CMP C */
+	i8080_threaded_cmp(&a, &f, c);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xBA: /* CMP D */
+	i8080_threaded_cmp(&a, &f, d);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xBB: /* CMP E */
+	i8080_threaded_cmp(&a, &f, e);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xBC: /* CMP H */
+	i8080_threaded_cmp(&a, &f, h);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xBD: /* CMP L */
+	i8080_threaded_cmp(&a, &f, l);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xBE: /* CMP M */
+	I8080_THREADED_ACCESS(i8080_cpu_load8(cpu, I8080_THREADED_PAIR(h, l), &m));
+	i8080_threaded_cmp(&a, &f, m);
+	I8080_THREADED_NEXT(1, 7);
+opcode_0xBF: /* CMP A */
+	i8080_threaded_cmp(&a, &f, a);
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xC0: /* RNZ */
+	I8080_THREADED_RET_IF(!(f & I8080_MASK_CONDITION_ZERO));
+opcode_0xC1: /* POP B */
+	I8080_THREADED_ACCESS(i8080_cpu_load16(cpu, sp, &imm));
+	I8080_THREADED_SPLIT(b, c, imm);
+	sp += sizeof(uint16_t);
+	I8080_THREADED_NEXT(1, 10);
+opcode_0xC2: /* JNZ A16 */
+	I8080_THREADED_JUMP_IF(!(f & I8080_MASK_CONDITION_ZERO));
+opcode_0xC3: /* JMP A16 */
+	I8080_THREADED_IMM16();
+	pc = imm;
+	I8080_THREADED_NEXT(0, 10);
+opcode_0xC4: /* CNZ A16 */
+	I8080_THREADED_CALL_IF(!(f & I8080_MASK_CONDITION_ZERO));
+opcode_0xC5: /* PUSH B */
+	sp -= sizeof(uint16_t);
+	I8080_THREADED_ACCESS(i8080_cpu_store16(cpu, sp, I8080_THREADED_PAIR(b, c)));
+	I8080_THREADED_NEXT(1, 11);
+opcode_0xC6: /* ADI D8 */
+	I8080_THREADED_IMM8();
+	i8080_threaded_add(&a, &f, imm);
+	I8080_THREADED_NEXT(2, 7);
+opcode_0xC7: /* RST 0 */
+	pc++;
+	I8080_THREADED_CALL(0x00, 11);
+opcode_0xC8: /* RZ */
+	I8080_THREADED_RET_IF(f & I8080_MASK_CONDITION_ZERO);
+opcode_0xC9: /* RET */
+	I8080_THREADED_ACCESS(i8080_cpu_load16(cpu, sp, &pc));
+	sp += sizeof(uint16_t);
+	I8080_THREADED_NEXT(0, 10);
+opcode_0xCA: /* JZ A16 */
+	I8080_THREADED_JUMP_IF(f & I8080_MASK_CONDITION_ZERO);
+opcode_0xCB: /* JMP A16 */
+	I8080_THREADED_IMM16();
+	pc = imm;
+	I8080_THREADED_NEXT(0, 10);
+opcode_0xCC: /* CZ A16 */
+	I8080_THREADED_CALL_IF(f & I8080_MASK_CONDITION_ZERO);
+opcode_0xCD: /* CALL A16 */
+	I8080_THREADED_IMM16();
+	pc += 3;
+	I8080_THREADED_CALL(imm, 17);
+opcode_0xCE: /* ACI D8 */
+	I8080_THREADED_IMM8();
+	i8080_threaded_adc(&a, &f, imm);
+	I8080_THREADED_NEXT(2, 7);
+opcode_0xCF: /* RST 1 */
+	pc++;
+	I8080_THREADED_CALL(0x08, 11);
+opcode_0xD0: /* RNC */
+	I8080_THREADED_RET_IF(!(f & I8080_MASK_CONDITION_CARRY));
+opcode_0xD1: /* POP D */
+	I8080_THREADED_ACCESS(i8080_cpu_load16(cpu, sp, &imm));
+	I8080_THREADED_SPLIT(d, e, imm);
+	sp += sizeof(uint16_t);
+	I8080_THREADED_NEXT(1, 10);
+opcode_0xD2: /* JNC A16 */
+	I8080_THREADED_JUMP_IF(!(f & I8080_MASK_CONDITION_CARRY));
+opcode_0xD3: /* OUT D8 */
+	I8080_THREADED_IMM8();
+	pc += 2;
+	I8080_THREADED_IO(output, 10);
+opcode_0xD4: /* CNC A16 */
+	I8080_THREADED_CALL_IF(!(f & I8080_MASK_CONDITION_CARRY));
+opcode_0xD5: /* PUSH D */
+	sp -= sizeof(uint16_t);
+	I8080_THREADED_ACCESS(i8080_cpu_store16(cpu, sp, I8080_THREADED_PAIR(d, e)));
+	I8080_THREADED_NEXT(1, 11);
+opcode_0xD6: /* SUI D8 */
+	I8080_THREADED_IMM8();
+	i8080_threaded_sub(&a, &f, imm);
+	I8080_THREADED_NEXT(2, 7);
+opcode_0xD7: /* RST 2 */
+	pc++;
+	I8080_THREADED_CALL(0x10, 11);
+opcode_0xD8: /* RC */
+	I8080_THREADED_RET_IF(f & I8080_MASK_CONDITION_CARRY);
+opcode_0xD9: /* RET */
+	I8080_THREADED_ACCESS(i8080_cpu_load16(cpu, sp, &pc));
+	sp += sizeof(uint16_t);
+	I8080_THREADED_NEXT(0, 10);
+opcode_0xDA: /* JC A16 */
+	I8080_THREADED_JUMP_IF(f & I8080_MASK_CONDITION_CARRY);
+opcode_0xDB: /* IN D8 */
+	I8080_THREADED_IMM8();
+	pc += 2;
+	I8080_THREADED_IO(input, 10);
+opcode_0xDC: /* CC A16 */
+	I8080_THREADED_CALL_IF(f & I8080_MASK_CONDITION_CARRY);
+opcode_0xDD: /* CALL A16 */
+	I8080_THREADED_IMM16();
+	pc += 3;
+	I8080_THREADED_CALL(imm, 17);
+opcode_0xDE: /* SBI D8 */
+	I8080_THREADED_IMM8();
+	i8080_threaded_sbb(&a, &f, imm);
+	I8080_THREADED_NEXT(2, 7);
+opcode_0xDF: /* RST 3 */
+	pc++;
+	I8080_THREADED_CALL(0x18, 11);
+opcode_0xE0: /* RPO */
+	I8080_THREADED_RET_IF(!(f & I8080_MASK_CONDITION_PARITY));
+opcode_0xE1: /* POP H */
+	I8080_THREADED_ACCESS(i8080_cpu_load16(cpu, sp, &imm));
+	I8080_THREADED_SPLIT(h, l, imm);
+	sp += sizeof(uint16_t);
+	I8080_THREADED_NEXT(1, 10);
+opcode_0xE2: /* JPO A16 */
+	I8080_THREADED_JUMP_IF(!(f & I8080_MASK_CONDITION_PARITY));
+opcode_0xE3: /* XTHL */
+	I8080_THREADED_ACCESS(i8080_cpu_load16(cpu, sp, &imm));
+	I8080_THREADED_ACCESS(i8080_cpu_store16(cpu, sp, I8080_THREADED_PAIR(h, l)));
+	I8080_THREADED_SPLIT(h, l, imm);
+	I8080_THREADED_NEXT(1, 18);
+opcode_0xE4: /* CPO A16 */
+	I8080_THREADED_CALL_IF(!(f & I8080_MASK_CONDITION_PARITY));
+opcode_0xE5: /* PUSH H */
+	sp -= sizeof(uint16_t);
+	I8080_THREADED_ACCESS(i8080_cpu_store16(cpu, sp, I8080_THREADED_PAIR(h, l)));
+	I8080_THREADED_NEXT(1, 11);
+opcode_0xE6: /* ANI D8 */
+	I8080_THREADED_IMM8();
+	i8080_threaded_ana(&a, &f, imm);
+	I8080_THREADED_NEXT(2, 7);
+opcode_0xE7: /* RST 4 */
+	pc++;
+	I8080_THREADED_CALL(0x20, 11);
+opcode_0xE8: /* RPE */
+	I8080_THREADED_RET_IF(f & I8080_MASK_CONDITION_PARITY);
+opcode_0xE9: /* PCHL */
+	pc = I8080_THREADED_PAIR(h, l);
+	I8080_THREADED_NEXT(0, 5);
+opcode_0xEA: /* JPE A16 */
+	I8080_THREADED_JUMP_IF(f & I8080_MASK_CONDITION_PARITY);
+opcode_0xEB: /* XCHG */
+	imm = I8080_THREADED_PAIR(d, e);
+	d = h, e = l;
+	I8080_THREADED_SPLIT(h, l, imm);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0xEC: /* CPE A16 */
+	I8080_THREADED_CALL_IF(f & I8080_MASK_CONDITION_PARITY);
+opcode_0xED: /* CALL A16 */
+	I8080_THREADED_IMM16();
+	pc += 3;
+	I8080_THREADED_CALL(imm, 17);
+opcode_0xEE: /* XRI D8 */
+	I8080_THREADED_IMM8();
+	i8080_threaded_xra(&a, &f, imm);
+	I8080_THREADED_NEXT(2, 7);
+opcode_0xEF: /* RST 5 */
+	pc++;
+	I8080_THREADED_CALL(0x28, 11);
+opcode_0xF0: /* RP */
+	I8080_THREADED_RET_IF(!(f & I8080_MASK_CONDITION_SIGN));
+opcode_0xF1: /* POP PSW */
+	I8080_THREADED_ACCESS(i8080_cpu_load16(cpu, sp, &imm));
+	a = imm >> 8;
+	f = imm & I8080_MASK_CONDITIONS_SZ_A_P_C | I8080_MASK_CONDITION_UNUSED1;
+	sp += sizeof(uint16_t);
+	I8080_THREADED_NEXT(1, 10);
+opcode_0xF2: /* JP A16 */
+	I8080_THREADED_JUMP_IF(!(f & I8080_MASK_CONDITION_SIGN));
+opcode_0xF3: /* DI */
+	cpu->inte = 0;
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xF4: /* CP A16 */
+	I8080_THREADED_CALL_IF(!(f & I8080_MASK_CONDITION_SIGN));
+opcode_0xF5: /* PUSH PSW */
+	sp -= sizeof(uint16_t);
+	I8080_THREADED_ACCESS(i8080_cpu_store16(cpu, sp, I8080_THREADED_PAIR(a, f)));
+	I8080_THREADED_NEXT(1, 11);
+opcode_0xF6: /* ORI D8 */
+	I8080_THREADED_IMM8();
+	i8080_threaded_ora(&a, &f, imm);
+	I8080_THREADED_NEXT(2, 7);
+opcode_0xF7: /* RST 6 */
+	pc++;
+	I8080_THREADED_CALL(0x30, 11);
+opcode_0xF8: /* RM */
+	I8080_THREADED_RET_IF(f & I8080_MASK_CONDITION_SIGN);
+opcode_0xF9: /* SPHL */
+	sp = I8080_THREADED_PAIR(h, l);
+	I8080_THREADED_NEXT(1, 5);
+opcode_0xFA: /* JM A16 */
+	I8080_THREADED_JUMP_IF(f & I8080_MASK_CONDITION_SIGN);
+opcode_0xFB: /* EI */
+	cpu->inte = 1;
+	I8080_THREADED_NEXT(1, 4);
+opcode_0xFC: /* CM A16 */
+	I8080_THREADED_CALL_IF(f & I8080_MASK_CONDITION_SIGN);
+opcode_0xFD: /* CALL A16 */
+	I8080_THREADED_IMM16();
+	pc += 3;
+	I8080_THREADED_CALL(imm, 17);
+opcode_0xFE: /* CPI D8 */
+	I8080_THREADED_IMM8();
+	i8080_threaded_cmp(&a, &f, imm);
+	I8080_THREADED_NEXT(2, 7);
+opcode_0xFF: /* RST 7 */
+	pc++;
+	I8080_THREADED_CALL(0x38, 11);
+
+i8080_threaded_exit:
+	I8080_THREADED_SAVE();
+}
@@ -0,0 +1,11 @@
+#ifndef I8080_THREADED_H
+#define I8080_THREADED_H
+
+#include "i8080/cpu.h"
+
+/* Executes instructions until the cpu stops, yields or its uptime reaches deadline */
+void
+i8080_threaded_run(struct i8080_cpu *cpu, uint64_t deadline);
+
+/* I8080_THREADED_H */
+#endif
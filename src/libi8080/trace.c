@@ -0,0 +1,306 @@
+#ifdef I8080_TRACE
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+/* Records are appended to chunks, handed over to the writer thread once full.
+ * The cpu only waits for the writer when all the chunks are in flight */
+#define I8080_TRACE_CHUNK_SIZE (256 << 10)
+#define I8080_TRACE_CHUNKS     16
+
+struct i8080_trace_chunk {
+	size_t size;
+	uint8_t data[I8080_TRACE_CHUNK_SIZE];
+};
+
+struct i8080_trace {
+	/* State of the cpu as last recorded, owned by the cpu's thread */
+	uint8_t *current, *end;
+	uint16_t address; /* Address following the last instruction */
+	uint16_t sp, bc, de, hl;
+	uint8_t a, f;
+	uint64_t uptime_cycles; /* Uptime following the last instruction, block engines account cycles ahead of instructions */
+	bool skipped; /* Cycles were skipped since the last instruction, uptime_cycles was resynchronized */
+	unsigned store_count;
+	struct {
+		uint16_t address;
+		uint8_t value;
+	} stores[I8080_TRACE_STORES_MAX];
+
+	/* Chunks in [tail, head) are being written, the cpu fills chunk head */
+	pthread_mutex_t lock;
+	pthread_cond_t filled, drained;
+	unsigned head, tail;
+	bool stopping, failed;
+	FILE *output;
+	pthread_t writer;
+	struct i8080_trace_chunk chunks[I8080_TRACE_CHUNKS];
+};
+
+static inline uint8_t *
+i8080_trace_put16(uint8_t *out, uint16_t value) {
+	*out++ = value;
+	*out++ = value >> 8;
+	return out;
+}
+
+static inline uint8_t *
+i8080_trace_put64(uint8_t *out, uint64_t value) {
+	for(unsigned i = 0; i < 8; i++) {
+		*out++ = value >> i * 8;
+	}
+	return out;
+}
+
+static void *
+i8080_trace_writer(void *data) {
+	struct i8080_trace * const trace = data;
+
+	pthread_mutex_lock(&trace->lock);
+	while(trace->tail != trace->head || !trace->stopping) {
+		const struct i8080_trace_chunk *chunk;
+
+		if(trace->tail == trace->head) {
+			pthread_cond_wait(&trace->filled, &trace->lock);
+			continue;
+		}
+
+		chunk = trace->chunks + trace->tail % I8080_TRACE_CHUNKS;
+		pthread_mutex_unlock(&trace->lock);
+
+		if(fwrite(chunk->data, 1, chunk->size, trace->output) != chunk->size) {
+			trace->failed = true;
+		}
+
+		pthread_mutex_lock(&trace->lock);
+		trace->tail++;
+		pthread_cond_signal(&trace->drained);
+	}
+	pthread_mutex_unlock(&trace->lock);
+
+	return NULL;
+}
+
+/* Hands the current chunk over to the writer, and moves on to the next one once it was written */
+static void
+i8080_trace_flush(struct i8080_trace *trace) {
+	struct i8080_trace_chunk *chunk;
+
+	pthread_mutex_lock(&trace->lock);
+	chunk = trace->chunks + trace->head % I8080_TRACE_CHUNKS;
+	chunk->size = trace->current - chunk->data;
+	trace->head++;
+	pthread_cond_signal(&trace->filled);
+
+	while(trace->head - trace->tail == I8080_TRACE_CHUNKS) {
+		pthread_cond_wait(&trace->drained, &trace->lock);
+	}
+
+	chunk = trace->chunks + trace->head % I8080_TRACE_CHUNKS;
+	pthread_mutex_unlock(&trace->lock);
+
+	trace->current = chunk->data;
+	trace->end = chunk->data + I8080_TRACE_CHUNK_SIZE;
+}
+
+struct i8080_trace *
+i8080_trace_create(const struct i8080_cpu *cpu, FILE *output) {
+	struct i8080_trace * const trace = malloc(sizeof(*trace));
+	uint8_t *out;
+
+	if(trace == NULL) {
+		return NULL;
+	}
+
+	trace->current = trace->chunks[0].data;
+	trace->end = trace->current + I8080_TRACE_CHUNK_SIZE;
+	trace->address = cpu->pc;
+	trace->sp = cpu->sp;
+	trace->bc = cpu->registers.pair.b;
+	trace->de = cpu->registers.pair.d;
+	trace->hl = cpu->registers.pair.h;
+	trace->a = cpu->registers.a;
+	trace->f = cpu->registers.f;
+	trace->uptime_cycles = cpu->uptime_cycles;
+	trace->skipped = false;
+	trace->store_count = 0;
+
+	pthread_mutex_init(&trace->lock, NULL);
+	pthread_cond_init(&trace->filled, NULL);
+	pthread_cond_init(&trace->drained, NULL);
+	trace->head = 0;
+	trace->tail = 0;
+	trace->stopping = false;
+	trace->failed = false;
+	trace->output = output;
+
+	out = trace->current;
+	memcpy(out, I8080_TRACE_MAGIC, sizeof(I8080_TRACE_MAGIC) - 1);
+	out += sizeof(I8080_TRACE_MAGIC) - 1;
+	*out++ = I8080_TRACE_VERSION;
+	out = i8080_trace_put16(out, cpu->pc);
+	out = i8080_trace_put16(out, cpu->sp);
+	*out++ = cpu->registers.a;
+	*out++ = cpu->registers.f;
+	*out++ = cpu->registers.b;
+	*out++ = cpu->registers.c;
+	*out++ = cpu->registers.d;
+	*out++ = cpu->registers.e;
+	*out++ = cpu->registers.h;
+	*out++ = cpu->registers.l;
+	out = i8080_trace_put64(out, cpu->uptime_cycles);
+	trace->current = out;
+
+	if(pthread_create(&trace->writer, NULL, i8080_trace_writer, trace) != 0) {
+		pthread_cond_destroy(&trace->drained);
+		pthread_cond_destroy(&trace->filled);
+		pthread_mutex_destroy(&trace->lock);
+		free(trace);
+		return NULL;
+	}
+
+	return trace;
+}
+
+int
+i8080_trace_destroy(struct i8080_trace *trace) {
+	bool failed;
+
+	i8080_trace_flush(trace);
+
+	pthread_mutex_lock(&trace->lock);
+	trace->stopping = true;
+	pthread_cond_signal(&trace->filled);
+	pthread_mutex_unlock(&trace->lock);
+
+	pthread_join(trace->writer, NULL);
+
+	failed = trace->failed || fflush(trace->output) != 0;
+
+	pthread_cond_destroy(&trace->drained);
+	pthread_cond_destroy(&trace->filled);
+	pthread_mutex_destroy(&trace->lock);
+	free(trace);
+
+	return failed ? -1 : 0;
+}
+
+void
+i8080_trace_step(struct i8080_trace *trace, const struct i8080_cpu *cpu,
+	uint16_t address, uint8_t opcode, unsigned length, union i8080_imm imm, unsigned cycles) {
+	const struct i8080_instruction * const instruction = i8080_instruction_info(opcode);
+	uint8_t *out = trace->current, *flags, *extension;
+
+	*out++ = opcode;
+	flags = out++;
+	*flags = 0;
+
+	if(address != trace->address) {
+		*flags |= I8080_TRACE_ADDRESS;
+		out = i8080_trace_put16(out, address);
+	}
+
+	switch(instruction->length) {
+	case 2:
+		*out++ = imm.d8;
+		break;
+	case 3:
+		out = i8080_trace_put16(out, imm.d16);
+		break;
+	default:
+		break;
+	}
+
+	if(cpu->sp != trace->sp) {
+		*flags |= I8080_TRACE_SP;
+		out = i8080_trace_put16(out, trace->sp = cpu->sp);
+	}
+
+	if(cpu->registers.a != trace->a) {
+		*flags |= I8080_TRACE_A;
+		*out++ = trace->a = cpu->registers.a;
+	}
+
+	if(cpu->registers.f != trace->f) {
+		*flags |= I8080_TRACE_F;
+		*out++ = trace->f = cpu->registers.f;
+	}
+
+	if(cpu->registers.pair.b != trace->bc) {
+		*flags |= I8080_TRACE_BC;
+		out = i8080_trace_put16(out, trace->bc = cpu->registers.pair.b);
+	}
+
+	if(cpu->registers.pair.d != trace->de) {
+		*flags |= I8080_TRACE_DE;
+		out = i8080_trace_put16(out, trace->de = cpu->registers.pair.d);
+	}
+
+	if(cpu->registers.pair.h != trace->hl) {
+		*flags |= I8080_TRACE_HL;
+		out = i8080_trace_put16(out, trace->hl = cpu->registers.pair.h);
+	}
+
+	if(trace->skipped || trace->store_count != 0 || length == 0 || (cycles != instruction->nojump && instruction->nojump != 0)) {
+		*flags |= I8080_TRACE_EXTENDED;
+		extension = out++;
+		*extension = 0;
+
+		if(length == 0) {
+			*extension |= I8080_TRACE_INTERRUPT;
+		}
+
+		if(cycles != instruction->nojump && instruction->nojump != 0) {
+			*extension |= I8080_TRACE_TAKEN;
+		}
+
+		if(trace->skipped) {
+			*extension |= I8080_TRACE_UPTIME;
+			out = i8080_trace_put64(out, trace->uptime_cycles);
+			trace->skipped = false;
+		}
+
+		if(trace->store_count != 0) {
+			*extension |= I8080_TRACE_STORES;
+			*out++ = trace->store_count;
+			for(unsigned i = 0; i < trace->store_count; i++) {
+				out = i8080_trace_put16(out, trace->stores[i].address);
+				*out++ = trace->stores[i].value;
+			}
+			trace->store_count = 0;
+		}
+	}
+
+	trace->address = address + length;
+	trace->uptime_cycles += cycles;
+	trace->current = out;
+
+	if(trace->end - out < I8080_TRACE_RECORD_MAX) {
+		i8080_trace_flush(trace);
+	}
+}
+
+void
+i8080_trace_skip(struct i8080_trace *trace, uint64_t uptime_cycles) {
+
+	if(trace->uptime_cycles != uptime_cycles) {
+		trace->uptime_cycles = uptime_cycles;
+		trace->skipped = true;
+	}
+}
+
+void
+i8080_trace_store(struct i8080_trace *trace, uint16_t address, uint8_t src) {
+
+	if(trace->store_count != I8080_TRACE_STORES_MAX) {
+		trace->stores[trace->store_count].address = address;
+		trace->stores[trace->store_count].value = src;
+		trace->store_count++;
+	}
+}
+
+/* I8080_TRACE */
+#endif
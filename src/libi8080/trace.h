@@ -0,0 +1,85 @@
+#ifndef I8080_TRACE_H
+#define I8080_TRACE_H
+
+#include <stdio.h>
+
+#include "i8080/cpu.h"
+
+/* Trace format, all values little endian:
+ * - Header: the magic, the version, then pc, sp (16 bits), a, f, b, c, d, e, h, l (8 bits) and uptime_cycles (64 bits).
+ * - One record per instruction executed: its opcode, a flags byte, then the fields the flags select in this order:
+ *   address (16 bits, when it does not follow the previous instruction), the immediate (as long as the instruction,
+ *   interrupts included), the registers which changed (sp, a, f, bc, de, hl after the instruction), and with
+ *   I8080_TRACE_EXTENDED, an extension byte followed by the fields it selects: uptime_cycles before the instruction
+ *   (64 bits, when cycles were skipped since the previous one) and memory writes (a count, then an address and a value each).
+ * - Cycles are the instruction's onjump if I8080_TRACE_TAKEN is set or its nojump is 0, its nojump otherwise */
+#define I8080_TRACE_MAGIC   "I8080TRC"
+#define I8080_TRACE_VERSION 1
+
+#define I8080_TRACE_ADDRESS  0x01
+#define I8080_TRACE_SP       0x02
+#define I8080_TRACE_A        0x04
+#define I8080_TRACE_F        0x08
+#define I8080_TRACE_BC       0x10
+#define I8080_TRACE_DE       0x20
+#define I8080_TRACE_HL       0x40
+#define I8080_TRACE_EXTENDED 0x80
+
+#define I8080_TRACE_UPTIME    0x01
+#define I8080_TRACE_STORES    0x02
+#define I8080_TRACE_TAKEN     0x04
+#define I8080_TRACE_INTERRUPT 0x08 /* The opcode was executed by an interrupt, it was not fetched at the address */
+
+/* Memory writes recorded per instruction, anything above is dropped */
+#define I8080_TRACE_STORES_MAX 8
+
+/* Largest record: opcode, flags, address, immediate, registers, extension, uptime and stores */
+#define I8080_TRACE_RECORD_MAX (1 + 1 + 2 + 2 + 10 + 1 + 8 + 1 + I8080_TRACE_STORES_MAX * 3)
+
+struct i8080_trace;
+
+/* Engines record each instruction once executed, with its length (0 for interrupts), and each memory write.
+ * Cycles skipped without executing instructions (halts, idle loops, restores) resynchronize the recorded uptime.
+ * Compiled out entirely without I8080_TRACE, and a single test while the cpu is not traced */
+#ifdef I8080_TRACE
+#define I8080_TRACE_STEP(cpu, address, opcode, length, imm, cycles) do {\
+	if((cpu)->trace != NULL) {\
+		i8080_trace_step((cpu)->trace, (cpu), (address), (opcode), (length), (imm), (cycles));\
+	}\
+} while(0)
+#define I8080_TRACE_STORE(cpu, address, src) do {\
+	if((cpu)->trace != NULL) {\
+		i8080_trace_store((cpu)->trace, (address), (src));\
+	}\
+} while(0)
+#define I8080_TRACE_SKIP(cpu) do {\
+	if((cpu)->trace != NULL) {\
+		i8080_trace_skip((cpu)->trace, (cpu)->uptime_cycles);\
+	}\
+} while(0)
+#else
+#define I8080_TRACE_STEP(cpu, address, opcode, length, imm, cycles) do { (void)sizeof(address); } while(0)
+#define I8080_TRACE_STORE(cpu, address, src) do { } while(0)
+#define I8080_TRACE_SKIP(cpu) do { } while(0)
+#endif
+
+/* Starts a background writer of the records to output */
+struct i8080_trace *
+i8080_trace_create(const struct i8080_cpu *cpu, FILE *output);
+
+/* Flushes the records left, returns -1 if any of them could not be written */
+int
+i8080_trace_destroy(struct i8080_trace *trace);
+
+void
+i8080_trace_step(struct i8080_trace *trace, const struct i8080_cpu *cpu,
+	uint16_t address, uint8_t opcode, unsigned length, union i8080_imm imm, unsigned cycles);
+
+void
+i8080_trace_skip(struct i8080_trace *trace, uint64_t uptime_cycles);
+
+void
+i8080_trace_store(struct i8080_trace *trace, uint16_t address, uint8_t src);
+
+/* I8080_TRACE_H */
+#endif
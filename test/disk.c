@@ -0,0 +1,50 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+/* Writes an 8" SSSD CP/M disk image with an empty directory, the given system on its system tracks.
+ * The system follows the boot sector, which is left empty as the CP/M-2.2 board does not run it */
+
+#define DISK_SECTOR_SIZE 128
+#define DISK_SECTORS     26
+#define DISK_TRACKS      77
+#define DISK_RESERVED    2
+
+static uint8_t image[DISK_TRACKS * DISK_SECTORS * DISK_SECTOR_SIZE];
+
+int
+main(int argc, char **argv) {
+	const size_t system = DISK_RESERVED * DISK_SECTORS * DISK_SECTOR_SIZE;
+	size_t size;
+	FILE *file;
+
+	if(argc != 3) {
+		fprintf(stderr, "usage: %s <system> <image>\n", *argv);
+		return EXIT_FAILURE;
+	}
+
+	memset(image, 0x00, system);
+	memset(image + system, 0xE5, sizeof(image) - system);
+
+	if((file = fopen(argv[1], "rb")) == NULL) {
+		err(EXIT_FAILURE, "fopen %s", argv[1]);
+	}
+
+	size = fread(image + DISK_SECTOR_SIZE, 1, system - DISK_SECTOR_SIZE + 1, file);
+	if(ferror(file) != 0 || size > system - DISK_SECTOR_SIZE) {
+		errx(EXIT_FAILURE, "Unable to read a system of at most %zu bytes from %s", system - DISK_SECTOR_SIZE, argv[1]);
+	}
+	fclose(file);
+
+	if((file = fopen(argv[2], "wb")) == NULL) {
+		err(EXIT_FAILURE, "fopen %s", argv[2]);
+	}
+
+	if(fwrite(image, sizeof(image), 1, file) != 1 || fclose(file) != 0) {
+		err(EXIT_FAILURE, "Unable to write %s", argv[2]);
+	}
+
+	return EXIT_SUCCESS;
+}